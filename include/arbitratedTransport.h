@@ -0,0 +1,37 @@
+/*
+	Wraps whichever transport the VS1053 driver uses so that every SCI command
+	and every SDI burst first gets the SPI bus from the arbiter as its most
+	important client. Nothing in the driver changes: it is handed this instead
+	of its own transport with VS1053::setTransport().
+*/
+#pragma once
+
+#include <VS1053Transport.h>
+
+#include "spiBusArbiter.h"
+
+class ArbitratedTransport : public VS1053Transport
+{
+public:
+	ArbitratedTransport(SpiBusArbiter &arbiter);
+
+	// The transport that actually talks to the chip
+	void wrap(VS1053Transport *inner);
+
+	void begin(uint8_t cs_pin, uint8_t dcs_pin, uint8_t dreq_pin) override;
+	void setSpeed(uint32_t hz) override;
+	void setReset(bool asserted) override;
+	bool dreq() override;
+	void dreqPullUp() override;
+	uint16_t sciRead(uint8_t reg) override;
+	void sciWrite(uint8_t reg, uint16_t value) override;
+	void sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count) override;
+	void sciWriteBatch(const VS1053RegisterWrite *writes, size_t count) override;
+	void sdiBegin() override;
+	void sdiWrite(const uint8_t *data, size_t len) override;
+	void sdiEnd() override;
+
+private:
+	SpiBusArbiter &arbiter;
+	VS1053Transport *inner;
+};
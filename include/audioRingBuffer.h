@@ -0,0 +1,91 @@
+/*
+	Single producer / single consumer ring buffer for the audio stream.
+
+	The internet stream is written into this buffer by one task and read out
+	to the VS1053 by another task running on the other core. The read and write
+	positions are atomics so the two sides never need a lock: the producer only
+	ever moves the write position (with release ordering, after the bytes are in
+	place) and the consumer only ever moves the read position.
+
+	Rather than copying through an intermediate buffer, both sides can work
+	directly on the storage:
+
+		Producer:	Span s = ring.reserve();  ... fill s.data ...  ring.commit(n);
+		Consumer:	Span s = ring.peek();     ... use  s.data ...  ring.consume(n);
+
+	A span is always contiguous so it may be shorter than room()/available()
+	when the free/used region wraps around the end of the storage.
+*/
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class AudioRingBuffer
+{
+public:
+	// A contiguous region of the ring storage
+	struct Span
+	{
+		uint8_t *data;
+		size_t len;
+	};
+
+	AudioRingBuffer();
+	~AudioRingBuffer();
+
+	// Allocate the storage (PSRAM if we have it). Not thread safe, call once in setup()
+	bool begin(size_t capacity);
+
+	// Usable size of the buffer in bytes
+	size_t capacity() const { return size ? size - 1 : 0; }
+
+	// Bytes waiting to be read
+	size_t available() const;
+
+	// Bytes that can still be written
+	size_t room() const;
+
+	// Throw away everything not yet read (eg on station change). Producer side.
+	void flush();
+
+	// Running totals of bytes committed and consumed (they wrap), for working out rates
+	uint32_t totalWritten() const { return writtenTotal.load(std::memory_order_relaxed); }
+	uint32_t totalRead() const { return readTotal.load(std::memory_order_relaxed); }
+
+	// Producer: largest contiguous free region (capped at maxLen), then commit what was written
+	Span reserve(size_t maxLen = SIZE_MAX);
+	void commit(size_t len);
+
+	// Producer: copying convenience wrapper around reserve()/commit()
+	size_t write(const uint8_t *data, size_t len);
+
+	// Consumer: largest contiguous readable region (capped at maxLen), then consume what was used
+	Span peek(size_t maxLen = SIZE_MAX);
+	void consume(size_t len);
+
+	// Consumer: copying convenience wrapper around peek()/consume()
+	size_t read(uint8_t *data, size_t len);
+
+private:
+	// One byte is always kept free so that head == tail means empty
+	uint8_t *buffer;
+	size_t size;
+
+	// Next byte to write (owned by the producer)
+	std::atomic<size_t> head;
+
+	// Next byte to read (owned by the consumer, except for flush())
+	std::atomic<size_t> tail;
+
+	// Read position seen by the last peek(), lets consume() detect a flush() in between
+	size_t peekedTail;
+
+	// Byte counters, one for each side
+	std::atomic<uint32_t> writtenTotal;
+	std::atomic<uint32_t> readTotal;
+
+	AudioRingBuffer(const AudioRingBuffer &) = delete;
+	AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+};
@@ -0,0 +1,109 @@
+/*
+	Somewhere to send the audio. The playback path (ring buffer -> feeder)
+	only ever talks to an AudioSink, so it runs the same whether the other
+	end is the VS1053 or something on the host:
+
+	- Vs1053Sink (vs1053Sink.h) the real decoder
+	- RateLimitedSink           throws the audio away, but only as fast as a
+	                            decoder playing at the given byte rate would
+	                            take it, with the same 2KB FIFO backpressure
+	- FileSink                  the same, but also writes the stream to a file
+
+	A sink takes data in chunks of at most chunkSize() bytes and only while
+	ready() says it has room; a run of writes can be bracketed by
+	beginBurst()/endBurst() so a bus transaction is opened only once.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+class AudioRingBuffer;
+
+class AudioSink
+{
+public:
+	virtual ~AudioSink() {}
+
+	// Room for another chunk?
+	virtual bool ready() = 0;
+
+	// Take up to chunkSize() bytes, returns how many it did take
+	virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+	// 0..100, 100 is loudest
+	virtual void setVolume(uint8_t volume) = 0;
+
+	// Throw away (or play out) whatever has been written but not yet played
+	virtual void flush() = 0;
+
+	virtual size_t chunkSize() const
+	{
+		return 32;
+	}
+
+	virtual void beginBurst() {}
+	virtual void endBurst() {}
+};
+
+// Send audio from the ring buffer for as long as the sink has room and there is audio to send.
+// Needs at least minBytes waiting before it starts. Returns the number of bytes sent.
+size_t feedFromRing(AudioRingBuffer &ring, AudioSink &sink, size_t minBytes = 32);
+
+class RateLimitedSink : public AudioSink
+{
+public:
+	// 0 bytes/second never applies backpressure
+	RateLimitedSink(uint32_t bytesPerSecond = 16000, size_t fifoBytes = 2048);
+
+	void setRate(uint32_t bytesPerSecond);
+
+	bool ready() override;
+	size_t write(const uint8_t *data, size_t len) override;
+	void setVolume(uint8_t volume) override;
+	void flush() override;
+
+	uint8_t volume() const
+	{
+		return currentVolume;
+	}
+	uint64_t bytesWritten() const
+	{
+		return totalWritten;
+	}
+
+protected:
+	// Where the audio goes, nowhere by default
+	virtual void consume(const uint8_t *data, size_t len);
+
+private:
+	uint32_t bytesPerSecond;
+	size_t fifoBytes;
+	size_t fifoLevel;
+	uint64_t lastDrainMicros;
+	uint64_t drainRemainder; // byte-microseconds not yet a whole byte
+	uint64_t totalWritten;
+	uint8_t currentVolume;
+
+	void drain();
+};
+
+class FileSink : public RateLimitedSink
+{
+public:
+	FileSink(uint32_t bytesPerSecond = 0);
+	~FileSink();
+
+	// The stream as the decoder would have received it (MP3/AAC, not PCM)
+	bool open(const char *path);
+	void close();
+
+	void flush() override;
+
+protected:
+	void consume(const uint8_t *data, size_t len) override;
+
+private:
+	FILE *file;
+};
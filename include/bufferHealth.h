@@ -0,0 +1,76 @@
+/*
+	Ring buffer health: how full it runs, how often it runs dry and for how
+	long, how fast it is filled and emptied, and how much time we spend
+	buffering rather than playing. Enough to tune the buffer size per station
+	without guessing.
+
+	The player task calls sample() every time round its loop (it only does
+	any work every sampleIntervalMs); any other task can call snapshot() to get
+	a consistent copy of the figures without stopping the player.
+*/
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prebufferController.h"
+
+class BufferHealth
+{
+public:
+	// Fill level is sampled (and time accounted) this often
+	static const uint32_t sampleIntervalMs = 50;
+
+	// Fill histogram buckets, each 10% of the buffer
+	static const int histogramBuckets = 10;
+
+	struct Stats
+	{
+		uint32_t underruns;			  // times we ran dry while playing
+		uint32_t starvedMs;			  // total time spent rebuffering after running dry
+		uint32_t longestStarvationMs; // longest single rebuffer
+		uint32_t minFill;			  // bytes
+		uint32_t maxFill;			  // bytes
+		uint32_t avgFill;			  // bytes
+		uint32_t fillHistogram[histogramBuckets]; // samples per 10% of capacity
+		uint32_t producerBytesPerSec; // into the ring buffer (audio only)
+		uint32_t consumerBytesPerSec; // out to the decoder
+		uint32_t prebufferingMs;	  // time waiting to start after a station change
+		uint32_t playingMs;
+		uint32_t rebufferingMs;
+	};
+
+	BufferHealth();
+
+	// Capacity of the ring buffer, for the histogram
+	void begin(size_t bufferCapacity);
+
+	// Start again (eg new station). Player task only.
+	void reset(uint32_t nowMs);
+
+	// Record the current state. Player task only.
+	void sample(uint32_t nowMs, size_t fillBytes, uint32_t totalWritten, uint32_t totalRead,
+				PrebufferController::bufferState state);
+
+	// Consistent copy of the figures since the last reset(), safe from any task
+	void snapshot(Stats &out) const;
+
+private:
+	size_t capacity;
+	Stats stats;
+
+	// Odd while sample() is part way through updating stats
+	mutable std::atomic<uint32_t> sequence;
+
+	// Player task only
+	bool started;
+	uint32_t lastSampleMs;
+	PrebufferController::bufferState lastState;
+	uint32_t currentStarvationMs;
+	uint64_t fillTotal;
+	uint32_t fillSamples;
+	uint32_t rateStartMs;
+	uint32_t rateStartWritten;
+	uint32_t rateStartRead;
+};
@@ -0,0 +1,62 @@
+/*
+	What the VS1053 says it is actually playing. The player task reads HDAT1,
+	AUDATA, DECODE_TIME and the byteRate WRAM parameter every so often
+	(between bursts, while the decoder's FIFO is full) and hands them to
+	update(); loop() takes a snapshot() to show.
+
+	Besides the codec, bit rate and sample rate, comparing the decoder's own
+	clock (DECODE_TIME) with the bytes we have fed it gives the real rate at
+	which audio drains from the ring buffer - so the buffer level can be shown
+	in seconds of audio, whatever icy-br says (or doesn't).
+*/
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class DecoderMonitor
+{
+public:
+	static const uint32_t pollIntervalMs = 1000;
+
+	// DECODE_TIME only counts whole seconds, so measure the drain rate over a few
+	static const uint32_t rateWindowSeconds = 5;
+
+	struct Status
+	{
+		const char *codec;		   // "MP3", "AAC", ... or "none"
+		uint32_t kbps;			   // From the decoder's byteRate
+		uint32_t sampleRate;	   // Hz
+		uint8_t channels;
+		uint32_t decodeSeconds;	   // Since the stream started
+		uint32_t drainBytesPerSec; // Measured, 0 until we have a window's worth
+	};
+
+	DecoderMonitor();
+
+	// New stream (player task)
+	void reset();
+
+	// Latest register values and the bytes fed to the decoder so far (player task)
+	void update(uint16_t hdat1, uint16_t audata, uint16_t decodeTime, uint16_t byteRate,
+				uint32_t bytesDelivered);
+
+	// Consistent copy for another task
+	void snapshot(Status &out) const;
+
+	// Best known bytes/sec the decoder takes: measured, else its own byteRate, else 0
+	uint32_t drainRate() const { return bestRate.load(std::memory_order_relaxed); }
+
+	static const char *codecName(uint16_t hdat1);
+
+private:
+	Status status;
+	mutable std::atomic<uint32_t> sequence;
+	std::atomic<uint32_t> bestRate;
+
+	// Player task only
+	bool windowStarted;
+	uint16_t windowStartSeconds;
+	uint32_t windowStartBytes;
+};
@@ -0,0 +1,101 @@
+/*
+	Remembers what station host names resolved to, so a reconnect or a flick
+	back to a station we have just left doesn't wait for DNS again. Several
+	stations share a host (*.hostingradio.ru, stream.antenne1.de, ...) so a
+	hit is often for a station we have never played this session.
+
+	An entry is fresh for ttlMs after it was resolved. After that, for up to
+	staleMs, it is still handed out - connecting straight away - but the
+	caller should look the name up again in the background and store() the
+	answer (stale-while-revalidate). Anything older is a miss. lwip doesn't
+	tell us the record's TTL, so ttlMs is our own choice.
+
+	The most recently used entries can be copied out (to NVS) and loaded back
+	after a reboot, as stale entries, so the station that was playing
+	connects without a lookup and then gets refreshed.
+
+	Plain C++ with no locking: the ingest task is the only user. Times are
+	millis().
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class DnsCache
+{
+public:
+	static const size_t maxEntries = 8;
+	static const size_t maxHostLength = 63;
+
+	static const uint32_t ttlMs = 10 * 60 * 1000UL;
+	static const uint32_t staleMs = 24 * 60 * 60 * 1000UL;
+
+	enum lookupResult
+	{
+		kMiss,	// not known (or too old), look it up
+		kFresh, // use it
+		kStale, // use it, but look it up again in the background
+	};
+
+	// As saved to NVS
+	struct WarmEntry
+	{
+		char host[maxHostLength + 1];
+		uint32_t address; // IPv4, network order
+		uint32_t lookupMs;
+	};
+
+	struct Stats
+	{
+		uint32_t hits;		// fresh and stale
+		uint32_t staleHits; // of which stale
+		uint32_t misses;
+		uint32_t stores;	// lookups that completed
+		uint32_t forgotten; // entries dropped after a failed connect
+		uint32_t savedMs;	// lookup time we didn't have to wait for
+	};
+
+	DnsCache();
+
+	lookupResult find(const char *host, uint32_t nowMs, uint32_t &address);
+
+	// A lookup has completed, lookupMs is how long it took
+	void store(const char *host, uint32_t address, uint32_t lookupMs, uint32_t nowMs);
+
+	// Connecting to what we gave out didn't work, don't give it out again
+	void forget(const char *host);
+
+	// The most recently used entries, newest first. Returns how many were copied.
+	size_t saveWarm(WarmEntry *out, size_t max) const;
+
+	// Entries from a previous boot, taken as stale
+	void loadWarm(const WarmEntry *in, size_t count, uint32_t nowMs);
+
+	// Has anything that saveWarm() would return changed since the last call?
+	bool warmChanged() const { return changed; }
+
+	const Stats &stats() const { return counters; }
+
+private:
+	struct Entry
+	{
+		char host[maxHostLength + 1];
+		uint32_t address;
+		uint32_t resolvedAt;
+		uint32_t lookupMs;
+		uint32_t lastUsed; // use counter, for choosing what to evict
+		bool valid;
+		bool warm; // loaded from NVS, no resolve time
+	};
+
+	Entry entries[maxEntries];
+	uint32_t useCounter;
+	mutable bool changed;
+	mutable size_t savedCount; // how many the last save (or load) kept
+	Stats counters;
+
+	void touch(Entry *entry);
+	Entry *lookup(const char *host);
+	Entry *slotFor(const char *host);
+};
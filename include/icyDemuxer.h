@@ -0,0 +1,81 @@
+/*
+	Splits an ICY (Shoutcast/Icecast) stream into audio and metadata.
+
+	With "Icy-MetaData:1" the server sends icy-metaint bytes of audio, then a
+	length byte (x16), then that many bytes of metadata, then audio again:
+
+		[ audio x metaint ][ L ][ metadata x L*16 ][ audio x metaint ][ L ]...
+
+	Chunks of any size, split anywhere, can be pushed through process(). The
+	audio is compacted in place to the front of the chunk (so it can be read
+	straight into the ring buffer and committed from there) and each complete
+	metadata block is handed to a callback as a null terminated string. Nothing
+	here blocks or talks to the hardware.
+
+	A metadata block can arrive over many reads. It is collected a piece at
+	a time into a fixed buffer. A block that doesn't finish by the deadline
+	means we have lost our place in the stream (or the server has), and the
+	caller should resync by reconnecting.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class IcyDemuxer
+{
+public:
+	// Largest possible metadata block (length byte 255 x 16)
+	static const size_t maxMetadataLength = 255 * 16;
+
+	// A metadata block taking longer than this to arrive is overdue
+	static const uint32_t metadataDeadlineMs = 3000;
+
+	// Called for each complete metadata block, text is null terminated. It is ours until the next
+	// process(), so the handler may change it in place (see IcyMetadata).
+	typedef void (*metadataHandler)(char *text, size_t len, void *context);
+
+	IcyDemuxer();
+
+	// Start of a new stream. An interval of 0 means there is no metadata to remove.
+	void reset(uint32_t metaInterval);
+
+	// Remove the metadata from this chunk (which arrived at nowMs). Returns how many audio bytes are
+	// now at the front of data.
+	size_t process(uint8_t *data, size_t len, uint32_t nowMs, metadataHandler handler, void *context);
+
+	// Audio bytes still to come before the next metadata length byte
+	uint32_t bytesUntilMetadata() const { return state == kAudio ? audioRemaining : 0; }
+
+	// Are we part way through a metadata block (length byte or text)?
+	bool inMetadata() const { return state != kAudio; }
+
+	// Has the metadata block we are part way through missed its deadline?
+	bool metadataOverdue(uint32_t nowMs) const { return state == kMetadata && nowMs - metaStartMs > metadataDeadlineMs; }
+
+	// Metadata blocks seen since reset(), including empty ones
+	uint32_t metadataBlocks() const { return blocks; }
+
+	// Blocks that came in more than one piece, and the longest any took to arrive
+	uint32_t splitBlocks() const { return split; }
+	uint32_t longestMetadataMs() const { return longestMs; }
+
+private:
+	enum parseState
+	{
+		kAudio,	   // passing audio through
+		kLength,   // next byte is the metadata length
+		kMetadata, // collecting metadata text
+	};
+
+	parseState state;
+	uint32_t interval;
+	uint32_t audioRemaining;
+	size_t metaRemaining;
+	size_t metaLength;
+	uint32_t blocks;
+	uint32_t metaStartMs;
+	uint32_t split;
+	uint32_t longestMs;
+	char metadata[maxMetadataLength + 1];
+};
@@ -0,0 +1,71 @@
+/*
+	Splits an ICY metadata block into its key='value'; pairs, in place.
+
+	A block looks like:
+
+		StreamTitle='Guns N' Roses - Sweet Child O' Mine';StreamUrl='';
+
+	Values are single quoted but the quotes inside them are not escaped, so
+	a value ends at the first "';" that is followed by the end of the block
+	or by the next key (letters, digits or underscores then '='). That lets
+	titles contain both quotes and semicolons. A backslash escaped quote
+	(\') is taken as a quote, and unquoted values run to the next ';'.
+
+	Nothing is copied: the key and value spans point into the block, which
+	is changed in place (each key and value is null terminated, escapes are
+	collapsed), so spans can also be used as C strings. The spans are only
+	good while the block is.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class IcyMetadata
+{
+public:
+	// Pairs kept per block, any more are counted but dropped
+	static const size_t maxFields = 8;
+
+	// A piece of the block, null terminated
+	struct Span
+	{
+		const char *text;
+		size_t len;
+
+		bool empty() const { return len == 0; }
+		bool equals(const char *other) const; // ignoring case
+	};
+
+	struct Field
+	{
+		Span key;
+		Span value;
+	};
+
+	IcyMetadata();
+
+	// Split up this block (len bytes at most, it may end sooner with a null, and there must be room
+	// for one after it). Returns the number of pairs found.
+	size_t parse(char *block, size_t len);
+
+	size_t count() const { return fieldCount; }
+	const Field &field(size_t i) const { return fields[i]; }
+
+	// The value for this key (ignoring case), nullptr if it wasn't sent
+	const Span *find(const char *key) const;
+
+	// The two everyone sends
+	const Span *streamTitle() const { return find("StreamTitle"); }
+	const Span *streamUrl() const { return find("StreamUrl"); }
+
+	// Pairs there was no room for, and text we couldn't make sense of
+	size_t dropped() const { return droppedFields; }
+	bool malformed() const { return badText; }
+
+private:
+	Field fields[maxFields];
+	size_t fieldCount;
+	size_t droppedFields;
+	bool badText;
+};
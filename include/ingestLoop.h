@@ -0,0 +1,123 @@
+/*
+	The streaming half of the ingest task: whatever the station has sent is
+	read straight into the free space of the ring buffer (each audio byte is
+	only copied once, in as large a batch as the stream and the ring buffer
+	allow), the ICY demuxer takes the metadata out, and then we check the
+	stream is still healthy - still connected, metadata in step and on time,
+	and audio arriving fast enough (see stallWatchdog.h).
+
+	It only sees the station through a StreamSource and the time through an
+	IngestClock, so the same loop runs in the firmware (WiFiClient and
+	millis(), see taskHelper.h) and on the host (test/ingestHarness.h).
+
+	Connecting, reconnecting and station changes stay with the ingest task.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audioRingBuffer.h"
+#include "icyDemuxer.h"
+#include "prebufferController.h"
+#include "stallWatchdog.h"
+
+// Where the stream comes from
+class StreamSource
+{
+public:
+	virtual ~StreamSource() {}
+
+	// Bytes that can be read straight away (0 or less if none)
+	virtual int available() = 0;
+
+	// Up to len bytes, returns how many (0 or less if none)
+	virtual int read(uint8_t *data, size_t len) = 0;
+
+	// Is the station still there?
+	virtual bool connected() = 0;
+};
+
+// What the time is, both never go backwards (but wrap)
+class IngestClock
+{
+public:
+	virtual ~IngestClock() {}
+	virtual uint32_t nowMs() = 0;
+	virtual uint32_t nowMicros() = 0;
+};
+
+class IngestLoop
+{
+public:
+	// Most bytes we read from the stream straight into the ring buffer in one go
+	static const size_t maxRead = 8192;
+
+	enum stepResult
+	{
+		kWaiting,	 // nothing to read yet
+		kRead,		 // read some of the stream
+		kBufferFull, // the ring buffer is full, let the player catch up
+		kLost,		 // the stream has gone, lostReason() says why
+	};
+
+	enum lostCause
+	{
+		kLostNone,
+		kLostClosed,		   // the station hung up
+		kLostOutOfSync,		   // the metadata we found was rubbish
+		kLostMetadataOverdue,  // half a metadata block and the rest never came
+		kLostStalled,		   // connected, but too little is arriving
+	};
+
+	// How hard we are working to get the stream into the ring buffer
+	struct Stats
+	{
+		uint32_t readCalls;			// read() calls made
+		uint32_t bytesRead;			// bytes those calls returned
+		uint32_t emptyReads;		// calls that returned nothing
+		uint32_t slowestReadMicros; // longest one read took (metadata included), see takeSlowestReadMicros()
+	};
+
+	IngestLoop(StreamSource &source, IngestClock &clock, AudioRingBuffer &ring, IcyDemuxer &demuxer,
+			   PrebufferController &prebuffer, StallWatchdog &stallWatchdog);
+
+	// Where complete metadata blocks go. The handler calls outOfSync() if it finds rubbish.
+	void setMetadataHandler(IcyDemuxer::metadataHandler handler, void *context);
+
+	// Once round while streaming: read what has arrived, then check on the stream. drainRate is
+	// the bytes/sec the decoder takes, for the stall check.
+	stepResult step(uint32_t drainRate);
+
+	// Called from the metadata handler: we have lost our place in the stream
+	void outOfSync() { corrupt = true; }
+
+	// Audio bytes the last step put into the ring buffer
+	size_t lastAudioBytes() const { return audioBytes; }
+
+	// Why the last step gave up on the stream
+	lostCause lostReason() const { return lost; }
+	static const char *lostName(lostCause cause);
+
+	const Stats &stats() const { return counters; }
+
+	// The slowest read since the last time we asked
+	uint32_t takeSlowestReadMicros();
+
+private:
+	StreamSource &source;
+	IngestClock &clock;
+	AudioRingBuffer &ring;
+	IcyDemuxer &demuxer;
+	PrebufferController &prebuffer;
+	StallWatchdog &stallWatchdog;
+	IcyDemuxer::metadataHandler handler;
+	void *handlerContext;
+	bool corrupt;
+	size_t audioBytes;
+	lostCause lost;
+	Stats counters;
+
+	bool readStream(size_t waiting);
+	stepResult lose(lostCause cause);
+};
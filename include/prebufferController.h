@@ -0,0 +1,98 @@
+/*
+	Decides when the ring buffer holds enough audio to start (or restart)
+	playing.
+
+	Thresholds are in milliseconds of audio, not bytes, so a 32kbps station
+	starts as quickly as a 320kbps one. The byte rate is what the decoder
+	says it is draining once it is playing, before that the icy-br header if
+	the station sent one, otherwise the measured arrival rate.
+	The start level grows with the measured arrival jitter, and after an
+	underrun we wait for a higher recovery level (hysteresis) so we don't
+	stutter on and off around the same point. Each underrun on the same
+	station raises both levels a little.
+
+	The ingest task calls reset()/setBitRate()/onArrival(), the player task
+	calls update(). Shared values are atomics, all times are millis().
+*/
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class PrebufferController
+{
+public:
+	enum bufferState
+	{
+		kPrebuffering, // new station, waiting for the start level
+		kPlaying,	   // audio is going to the decoder
+		kRebuffering,  // ran dry, waiting for the recovery level
+	};
+
+	PrebufferController();
+
+	// Size of the ring buffer, we never wait for more than most of it
+	void begin(size_t bufferCapacity);
+
+	// New station (producer side). The bit rate is usually not known yet.
+	void reset(uint32_t nowMs);
+
+	// Bit rate from the icy-br header in kbps (0 if the station didn't say)
+	void setBitRate(int kbps);
+
+	// The rate the decoder is actually taking audio at, 0 if not known (player task)
+	void setDecoderByteRate(uint32_t bytesPerSec);
+
+	// Audio bytes have just gone into the ring buffer (producer side)
+	void onArrival(uint32_t nowMs, size_t bytes);
+
+	// Should the player be sending audio to the decoder? (consumer side)
+	bool update(uint32_t nowMs, size_t bufferedBytes);
+
+	bufferState state() const { return currentState; }
+
+	// Best guess at how much audio this many bytes is
+	uint32_t bytesToMs(size_t bytes) const;
+	size_t msToBytes(uint32_t ms) const;
+
+	// Current levels, in milliseconds of audio
+	uint32_t startLevelMs() const;
+	uint32_t recoveryLevelMs() const;
+
+	// Bytes/sec we are using for the conversions, and the arrival jitter
+	uint32_t byteRate() const;
+	uint32_t jitterMs() const { return jitter.load(std::memory_order_relaxed); }
+
+	// Station change to first audio for the current/last station, 0 until it starts
+	uint32_t timeToAudioMs() const { return lastTimeToAudio; }
+	uint32_t underruns() const { return totalUnderruns; }
+	uint32_t stationUnderruns() const { return underrunsThisStation; }
+
+	// Goes up by one each time update() sees a reset() (consumer side)
+	uint32_t stationChanges() const { return resets; }
+
+private:
+	size_t capacity;
+
+	// Producer writes, consumer reads
+	std::atomic<uint32_t> decoderByteRate;
+	std::atomic<uint32_t> headerByteRate;
+	std::atomic<uint32_t> arrivalByteRate;
+	std::atomic<uint32_t> jitter;
+	std::atomic<uint32_t> stationStartMs;
+	std::atomic<bool> resetPending;
+
+	// Producer only
+	uint32_t lastArrivalMs;
+	uint32_t meanGapMs;
+	uint32_t rateWindowStartMs;
+	uint32_t rateWindowBytes;
+
+	// Consumer only
+	bufferState currentState;
+	uint32_t lastTimeToAudio;
+	uint32_t totalUnderruns;
+	uint32_t underrunsThisStation;
+	uint32_t resets;
+};
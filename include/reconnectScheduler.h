@@ -0,0 +1,117 @@
+/*
+	Decides when to have another go after losing (or failing to get) a
+	station, rather than trying again as fast as the loop goes round.
+
+	Each cause of failure has its own policy: WiFi being down gets a steady
+	retry while the access point comes back, a server that refused us (or
+	sent rubbish) backs off hard so we don't hammer it, and a stream that
+	was playing and stopped is retried quickly. Delays double with each
+	failure in a row (whatever the cause, so a server that alternately
+	refuses us and drops us still backs off) up to the policy's maximum,
+	and are then jittered (somewhere between half and all of it) so a room
+	full of radios doesn't come back in step. Nothing is retried sooner
+	than minDelayMs.
+
+	For the first few retries, while the ring buffer still holds audio, the
+	delay is also kept well inside what is left (the runway), so the new
+	connection is up before the old audio runs out and playback carries on.
+
+	A connection only counts as good once it has been streaming for
+	stableMs; one that drops before then (a server that accepts us, sends
+	the headers and hangs up) carries on backing off. The time from losing
+	the stream to it streaming again for good is recorded as an outage.
+	Plain C++, times are millis().
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class ReconnectScheduler
+{
+public:
+	enum reconnectCause
+	{
+		kCauseWifiDown,		 // no WiFi, nothing else can work
+		kCauseServerRefused, // DNS, connect or the response failed
+		kCauseStreamLost,	 // was streaming: closed, stalled or lost sync
+		kCauses,
+	};
+
+	// Streaming this long and the connection is good
+	static const uint32_t stableMs = 10000;
+
+	// Never retry sooner than this
+	static const uint32_t minDelayMs = 250;
+
+	struct Policy
+	{
+		uint32_t firstDelayMs; // before the first retry
+		uint32_t baseDelayMs;  // before the second, doubling from there
+		uint32_t maxDelayMs;
+	};
+
+	struct Stats
+	{
+		uint32_t attempts[kCauses]; // retries scheduled for each cause
+		uint32_t outages;			// lost the stream and got it back
+		uint32_t abandoned;			// gave up on one (station changed)
+		uint32_t downtimeMs;		// total of the outages
+		uint32_t longestOutageMs;
+		uint32_t lastOutageMs;
+		uint32_t lastAttempts; // attempts the last outage took
+	};
+
+	ReconnectScheduler();
+
+	// For the jitter, so radios booted together don't stay together
+	void seed(uint32_t seed);
+
+	static const Policy &policy(reconnectCause cause);
+
+	// Something failed. Returns the delay before the next try. runwayMs is the audio still
+	// buffered (0 if none or not known).
+	uint32_t failed(reconnectCause cause, uint32_t nowMs, uint32_t runwayMs);
+
+	// Is it time for the next try?
+	bool due(uint32_t nowMs) const { return pending && (int32_t)(nowMs - retryAt) >= 0; }
+	bool waiting() const { return pending; }
+
+	// The retry is under way
+	void started()
+	{
+		pending = false;
+		up = false;
+	}
+
+	// Call while streaming. Once it has stayed up for stableMs the failures are forgotten and
+	// any outage is over, returns true the once that happens to an outage.
+	bool streaming(uint32_t nowMs);
+
+	// New station: forget the old one's troubles
+	void abandon();
+
+	bool inOutage() const { return outage; }
+	uint32_t outageMs(uint32_t nowMs) const { return outage ? nowMs - outageStart : 0; }
+	uint32_t consecutiveFailures() const { return failures; }
+	reconnectCause lastCause() const { return cause; }
+
+	const Stats &stats() const { return counters; }
+
+	static const char *causeName(reconnectCause cause);
+
+private:
+	bool pending;
+	uint32_t retryAt;
+	bool outage;
+	uint32_t outageStart;
+	uint32_t failures;
+	uint32_t outageAttempts;
+	bool up;
+	uint32_t upSince;
+	reconnectCause cause;
+	uint32_t random;
+	Stats counters;
+
+	uint32_t nextRandom();
+};
@@ -0,0 +1,97 @@
+/*
+	Where stations that redirect us actually stream from, so we go straight
+	there next time instead of paying for an extra connect (and request) on
+	every visit.
+
+	Entries are keyed by a hash of the station's own URL, not its number, so
+	an edited station list can't send a station to someone else's stream. A
+	chain of redirects is stored as where it ended up. If every hop was
+	permanent (301 or 308) the entry is kept across reboots (the caller saves
+	it to NVS when permanentChanged()), if any was temporary (302, 307, ...)
+	it only lasts until we restart. An entry that fails to connect
+	maxFailures times in a row is dropped and the station's own URL is used
+	again.
+
+	Plain C++ with no locking: the ingest task is the only user.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class RedirectCache
+{
+public:
+	static const size_t maxEntries = 8;
+
+	// Longest redirect chain we follow before giving up on the station
+	static const int maxHops = 5;
+
+	// Connect failures in a row before a cached target is forgotten
+	static const uint8_t maxFailures = 2;
+
+	struct Target
+	{
+		char host[64];
+		char path[128];
+		uint16_t port;
+	};
+
+	// As saved to NVS
+	struct SavedEntry
+	{
+		uint32_t key;
+		Target target;
+	};
+
+	struct Stats
+	{
+		uint32_t hits;		  // connects that went straight to a cached target
+		uint32_t learned;	  // chains stored (new or changed)
+		uint32_t invalidated; // entries dropped after failures
+	};
+
+	RedirectCache();
+
+	// Identifies a station by its own URL
+	static uint32_t keyFor(const char *host, uint16_t port, const char *path);
+
+	// Split "http://host[:port][/path]". False if it isn't http:// or doesn't fit.
+	static bool parseLocation(const char *url, Target &target);
+
+	// Is there a better place to connect to for this station? permanent tells whether it survives a reboot.
+	bool find(uint32_t key, Target &target, bool &permanent);
+
+	// A redirect chain worked, it ended at target
+	void learned(uint32_t key, const Target &target, bool permanent);
+
+	// Connecting to the cached target for this key worked, or didn't
+	void succeeded(uint32_t key);
+	bool failed(uint32_t key); // returns true if the entry has now been dropped
+
+	// The most recently used permanent entries, newest first, for saving
+	size_t savePermanent(SavedEntry *out, size_t max) const;
+	void loadPermanent(const SavedEntry *in, size_t count);
+	bool permanentChanged() const { return changed; }
+
+	const Stats &stats() const { return counters; }
+
+private:
+	struct Entry
+	{
+		uint32_t key;
+		Target target;
+		uint32_t lastUsed;
+		uint8_t failures;
+		bool permanent;
+		bool valid;
+	};
+
+	Entry entries[maxEntries];
+	uint32_t useCounter;
+	mutable bool changed;
+	Stats counters;
+
+	Entry *lookup(uint32_t key);
+	Entry *slotFor(uint32_t key);
+};
@@ -0,0 +1,101 @@
+/*
+	Reads the response headers from a station, a byte at a time, into fixed
+	buffers - no Arduino Strings, no heap.
+
+	The first line must be a status line, either HTTP ("HTTP/1.1 200 OK") or
+	Shoutcast's own ("ICY 200 OK"); anything else fails straight away (at
+	the first byte that can't be one, or at the end of the line) rather than
+	after a header timeout. Header names are matched whatever their case
+	(servers send "Location", "location" and "LOCATION"), lines may end in
+	CRLF, LF or a bare CR (some old Shoutcast servers) and a line starting
+	with a space or tab continues the one before (folding). Lines longer than
+	maxLineLength are cut short.
+
+	Only the headers the radio uses are kept: icy-metaint, icy-br, Location,
+	Content-Type, icy-name and icy-genre. The body (the audio) starts with
+	the byte after the one feed() returned kComplete for, so the caller
+	must not read ahead of the parser.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class ResponseHeaderParser
+{
+public:
+	static const size_t maxLineLength = 256;
+
+	enum parseResult
+	{
+		kNeedMore,	// keep feeding
+		kComplete,	// blank line seen, the headers are all in
+		kBadStatus, // the first line wasn't an HTTP or ICY status line
+	};
+
+	struct Headers
+	{
+		uint16_t status;	  // eg 200, 302
+		bool icy;			  // "ICY 200 OK" rather than HTTP
+		uint32_t metaInt;	  // icy-metaint, 0 if not sent
+		int bitRate;		  // icy-br in kbps, 0 if not sent
+		char location[192];	  // Location, empty if not sent
+		char contentType[48]; // eg audio/mpeg, audio/aac
+		char name[64];		  // icy-name
+		char genre[48];		  // icy-genre
+	};
+
+	ResponseHeaderParser();
+
+	// Ready for a new response
+	void reset();
+
+	// Next byte of the response. Once it has returned kComplete or kBadStatus it keeps doing so.
+	parseResult feed(char c);
+
+	const Headers &headers() const { return found; }
+
+	// Header lines (including folded ones) seen so far, and how many were too long
+	uint16_t lineCount() const { return lines; }
+	uint16_t truncatedLines() const { return truncated; }
+
+	// Copy of the raw status line (or as much as fitted), for the log
+	const char *statusLine() const { return status; }
+
+private:
+	enum parseState
+	{
+		kStatusLine,
+		kHeaderLines,
+		kDone,
+		kFailed,
+	};
+
+	parseState state;
+	Headers found;
+
+	// The line being collected: a header with any folded lines joined on
+	char line[maxLineLength + 1];
+	size_t lineLen;
+	bool lineTooLong;
+	bool atLineStart;  // the last byte ended a line
+	bool lastWasCR;	   // so the LF of a CRLF isn't a second line end
+	bool bareCR;	   // this server ends lines with just a CR
+	bool blankLineCR;  // had the CR of the blank line, its LF is the last header byte
+	bool folding;	   // skipping the leading white space of a folded line
+
+	uint16_t lines;
+	uint16_t truncated;
+	char status[40];
+
+	parseResult endOfLine(char c);
+	void lineComplete();
+	bool couldBeStatusLine() const;
+	bool parseStatusLine();
+	void parseHeaderLine();
+	void append(char c);
+
+	static bool nameIs(const char *name, size_t nameLen, const char *wanted);
+	static uint32_t parseNumber(const char *text);
+	static void copyValue(char *dest, size_t destSize, const char *value, size_t valueLen);
+};
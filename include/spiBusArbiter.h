@@ -0,0 +1,105 @@
+/*
+	The screen (ILI9341), its touch controller (XPT2046) and the VS1053 all hang
+	off the same SPI bus. Whoever gets there first keeps it for as long as they
+	like, so one large LVGL redraw can hold the VS1053 off for long enough to
+	empty its 2KB FIFO - and we hear it.
+
+	The arbiter hands out the bus by priority: audio, then touch, then the
+	display. Anyone about to hold the bus for a while (the LVGL flush) should
+	call yieldIfWaiting() between pieces of work so that a waiting, more
+	important client gets in at that point rather than when the whole job is
+	done. Each client's hold and wait times are recorded so we can see who is
+	hogging the bus.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <mutex>
+#endif
+
+#include <atomic>
+
+// Lower number, higher priority
+enum spiBusClient
+{
+	kBusAudio,
+	kBusTouch,
+	kBusDisplay,
+	kBusClients
+};
+
+class SpiBusArbiter
+{
+public:
+	struct Stats
+	{
+		uint32_t grants;	  // Times the bus was handed to this client
+		uint32_t yields;	  // Times it gave the bus up early for someone more important
+		uint64_t holdMicros;  // Total time held
+		uint32_t maxHoldMicros;
+		uint64_t waitMicros;  // Total time spent waiting to get it
+		uint32_t maxWaitMicros;
+	};
+
+	SpiBusArbiter();
+
+	// Create the lock, call once before any task uses the bus
+	bool begin();
+
+	// Wait for, then take, the bus. Clients of higher priority that are waiting go first.
+	void acquire(spiBusClient client);
+	void release(spiBusClient client);
+
+	// Is a more important client waiting for the bus we hold?
+	bool contended(spiBusClient client) const;
+
+	// Hand the bus over (and wait to get it back) if contended. Returns true if we did.
+	bool yieldIfWaiting(spiBusClient client);
+
+	// Consistent copy of one client's figures
+	void snapshot(spiBusClient client, Stats &stats);
+
+	static const char *clientName(spiBusClient client);
+
+private:
+	std::atomic<uint32_t> waiting[kBusClients];
+	Stats stats[kBusClients];
+	uint32_t grantedAt;
+
+#ifdef ESP_PLATFORM
+	SemaphoreHandle_t lock;
+#else
+	std::mutex lock;
+#endif
+
+	void lockTake();
+	void lockGive();
+};
+
+// Holds the bus for the life of the object (the early return friendly way to use it)
+class SpiBusClaim
+{
+public:
+	SpiBusClaim(SpiBusArbiter &arbiter, spiBusClient client)
+		: arbiter(arbiter), client(client)
+	{
+		arbiter.acquire(client);
+	}
+	~SpiBusClaim()
+	{
+		arbiter.release(client);
+	}
+
+private:
+	SpiBusArbiter &arbiter;
+	spiBusClient client;
+
+	SpiBusClaim(const SpiBusClaim &);
+	SpiBusClaim &operator=(const SpiBusClaim &);
+};
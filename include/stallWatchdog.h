@@ -0,0 +1,92 @@
+/*
+	Notices a station that is still connected but has stopped sending (or
+	is sending too slowly to keep up) while there is still audio in the
+	ring buffer to cover a reconnect.
+
+	Arrivals are counted in a sliding window of short slots, giving the
+	rate audio is coming in. Against the rate the decoder takes it out, the
+	buffered audio gives a predicted runway: how long until the buffer is
+	empty if things carry on as they are. When that runway gets down to
+	what a reconnect usually takes (plus a margin) we give up on the
+	connection, so the new one is streaming before the old audio runs out.
+	If nothing arrives at all for a long time we give up regardless.
+
+	Each stall is followed up: it ends when we are streaming again (the
+	runway turned out to be the time taken plus what was left) or when the
+	buffer ran dry first, so predictions can be checked against reality.
+
+	Ingest task only, times are millis().
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class StallWatchdog
+{
+public:
+	// Slots in the arrival window
+	static const size_t kSlots = 8;
+
+	struct Stats
+	{
+		uint32_t stalls;	  // connections given up on
+		uint32_t recovered;	  // streaming again before the buffer emptied
+		uint32_t ranDry;	  // the buffer emptied first
+		uint32_t silent;	  // nothing at all arrived (rather than too little)
+		uint32_t lastPredictedMs;
+		uint32_t lastActualMs;
+	};
+
+	StallWatchdog();
+
+	// Streaming (again): start measuring afresh after a short grace period
+	void reset(uint32_t nowMs);
+
+	// How long the last connect took, start to first audio (0 keeps the last value)
+	void setReconnectCostMs(uint32_t ms);
+
+	// Audio bytes have just gone into the ring buffer
+	void onArrival(uint32_t nowMs, size_t bytes);
+
+	// Bytes/sec arriving over the window
+	uint32_t arrivalRate(uint32_t nowMs);
+
+	// How long the buffered audio lasts at these rates, UINT32_MAX if it isn't going down
+	static uint32_t predictRunwayMs(size_t bufferedBytes, uint32_t drainRate, uint32_t arrivalRate);
+
+	// Should we give up on this connection now? Cheap enough to call every time round.
+	bool check(uint32_t nowMs, size_t bufferedBytes, uint32_t drainRate);
+
+	// Follow up on the last stall
+	bool stallOpen() const { return open; }
+	uint32_t stallAgeMs(uint32_t nowMs) const { return nowMs - stalledAt; }
+	uint32_t predictedMs() const { return counters.lastPredictedMs; }
+
+	// Streaming again with this much audio still buffered, returns the actual runway
+	uint32_t recovered(uint32_t nowMs, uint32_t leftMs);
+
+	// The buffer is empty, returns the actual runway
+	uint32_t ranDry(uint32_t nowMs);
+
+	// Station changed, nothing to follow up
+	void abandon() { open = false; }
+
+	// Give up threshold, in ms of runway
+	uint32_t leadMs() const;
+
+	const Stats &stats() const { return counters; }
+
+private:
+	uint32_t slotBytes[kSlots];
+	uint32_t slotStart; // start of the newest slot, in slot units
+	uint32_t windowStart;
+	uint32_t lastArrival;
+	uint32_t lastCheck;
+	uint32_t reconnectCost;
+	bool open;
+	uint32_t stalledAt;
+	Stats counters;
+
+	void advance(uint32_t nowMs);
+};
@@ -0,0 +1,177 @@
+/*
+	Connects to a station one small step at a time.
+
+	stationConnect() used to do the lot in one go: resolve the host, connect
+	(five times if need be), send the request, then sit in delay(100) for up
+	to three seconds waiting for the headers. The ingest task could do
+	nothing else meanwhile - not even notice that the user had already moved
+	on to the next station.
+
+	Here each phase - DNS, TCP connect, request, first header byte, the rest
+	of the headers and the first audio byte - is a state with its own
+	deadline. step() does whatever can be done right now without waiting and
+	returns, so the ingest task calls it each time round its loop and can
+	cancel() (or start() another station) at any point. The DNS lookup is
+	lwip's asynchronous one and the socket is connected non-blocking, then
+	handed to the WiFiClient for the stream itself.
+
+	Host names are looked up in a DnsCache first. A stale entry is used
+	straight away while a lookup runs in the background to refresh it; an
+	entry whose address wouldn't connect is dropped.
+
+	The time each phase took is kept, and logged when the audio arrives, so
+	we can see where a slow station change goes.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <lwip/ip_addr.h>
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dnsCache.h"
+#include "responseHeaderParser.h"
+
+class StationConnector
+{
+public:
+	enum connectState
+	{
+		kIdle,			  // nothing started (or cancelled)
+		kResolving,		  // waiting for the DNS lookup
+		kConnecting,	  // waiting for the TCP connect
+		kAwaitingHeaders, // request sent, nothing back yet
+		kReadingHeaders,  // part way through the response headers
+		kAwaitingAudio,	  // headers done, waiting for the stream to start
+		kStreaming,		  // audio is arriving, the client is all the ingest task's
+		kFailed,		  // see failure()
+	};
+
+	enum failReason
+	{
+		kFailNone,
+		kFailDns,		  // lookup failed or timed out
+		kFailConnect,	  // refused, unreachable or timed out
+		kFailSend,		  // couldn't send the request
+		kFailTimeout,	  // no (or not all the) headers or audio in time
+		kFailBadResponse, // not HTTP/ICY, or a status we can't play
+		kFailClosed,	  // server hung up before the audio started
+		kFailRedirect,	  // server sent a Location, see location()
+		kFailNoMetaInt,	  // wanted metadata but got no icy-metaint
+	};
+
+	// How long each phase may take, in milliseconds
+	static const uint32_t dnsTimeoutMs = 5000;
+	static const uint32_t connectTimeoutMs = 5000;
+	static const uint32_t firstHeaderTimeoutMs = 3000;
+	static const uint32_t headersTimeoutMs = 3000;
+	static const uint32_t firstAudioTimeoutMs = 5000;
+
+	// Milliseconds after start() each phase finished, 0 if it hasn't (yet)
+	struct Timings
+	{
+		uint32_t resolvedMs;
+		uint32_t connectedMs;
+		uint32_t firstHeaderByteMs;
+		uint32_t headersMs;
+		uint32_t firstAudioMs;
+	};
+
+	explicit StationConnector(WiFiClient &client);
+
+	// Drop whatever we were doing and start connecting to this stream
+	void start(const char *host, uint16_t port, const char *path, bool wantMetadata);
+
+	// Drop any connection in progress, or the stream
+	void cancel();
+
+	// Move things on as far as possible without waiting, returns the new state
+	connectState step();
+
+	connectState state() const { return currentState; }
+	bool busy() const { return currentState != kIdle && currentState != kStreaming && currentState != kFailed; }
+	bool streaming() const { return currentState == kStreaming; }
+	failReason failure() const { return failedWith; }
+
+	// From the response headers
+	const ResponseHeaderParser::Headers &headers() const { return parser.headers(); }
+	uint32_t metaInterval() const { return parser.headers().metaInt; }
+	int bitRate() const { return parser.headers().bitRate; }
+	const char *location() const { return parser.headers().location; }
+
+	const Timings &timings() const { return phaseTimes; }
+	uint32_t elapsedMs() const { return millis() - startedAt; }
+
+	// Where we are trying to get to
+	const char *host() const { return hostName; }
+	uint16_t port() const { return hostPort; }
+
+	// Host name to address cache (ingest task only)
+	DnsCache &dnsCache() { return cache; }
+
+	static const char *stateName(connectState state);
+	static const char *failureName(failReason reason);
+
+	// Log the phase timings on one line
+	void printTimings() const;
+
+private:
+	WiFiClient &client;
+
+	connectState currentState;
+	failReason failedWith;
+	uint32_t startedAt;
+	uint32_t phaseStartedAt;
+	Timings phaseTimes;
+
+	char hostName[64];
+	char requestPath[128];
+	uint16_t hostPort;
+	bool metadata;
+
+	// The lookup. Each one gets a new generation, which goes to lwip as the callback argument,
+	// and the DNS callback (tcpip task) only fills in the answer if it is for the generation
+	// still waiting: generation in the top half, address (or one of the markers) in the bottom.
+	static const uint32_t kLookupPending = 0xFFFFFFFF;
+	std::atomic<uint64_t> dnsResult;
+	uint32_t dnsGeneration;
+	uint32_t dnsStartedAt;
+	bool dnsCollected; // its answer has been stored in the cache
+
+	// Where we are connecting to, and whether that came from the cache
+	uint32_t serverAddress;
+	bool haveAddress;
+	bool addressFromCache;
+	DnsCache cache;
+
+	// The socket while it is connecting, before the WiFiClient takes it over
+	int socketFd;
+
+	// Response headers
+	ResponseHeaderParser parser;
+
+	void enter(connectState next);
+	connectState fail(failReason reason);
+	bool phaseExpired(uint32_t timeoutMs) const { return millis() - phaseStartedAt > timeoutMs; }
+	void closeSocket();
+
+	connectState stepResolving();
+	connectState stepConnecting();
+	connectState stepHeaders();
+	connectState stepAwaitingAudio();
+
+	bool startLookup();
+	void abandonLookup() { dnsGeneration++; }
+	bool lookupFinished(uint32_t &address) const;
+	void collectLookup();
+	bool beginConnect();
+	bool sendRequest();
+	connectState headersComplete();
+
+	// Who gets the DNS answers (there is only the one connector)
+	static std::atomic<StationConnector *> lookupOwner;
+	static void dnsFound(const char *name, const ip_addr_t *address, void *context);
+};
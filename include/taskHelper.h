@@ -7,44 +7,130 @@
 	regardless (well, as long as there is data in the circular buffer - 
 	which could be a candidate for another task, but we do have 10 seconds
 	to play with).
+
+	The stream itself is read by a second task, pinned to the network core
+	(core 0) at a higher priority than loop(), so a slow screen update or
+	bitmap draw can no longer starve the ring buffer. That task owns the
+	WiFiClient, the ICY metadata and all writes to the ring buffer; loop()
+	asks it to change station through the ingestCommands queue and it sends
+	back what to display through the uiEvents queue. Connecting to a station
+	is stepped along by the same loop (see stationConnector.h), so a station
+	change request is acted on even half way through a connect. Once we are
+	streaming, the reading itself (and noticing the stream has gone) is done
+	by ingestLoop (see ingestLoop.h), which also runs on the host.
 */
 
+#include <atomic>
+
 #include "Arduino.h"
 #include "main.h"
 
-// This determines whether the buffer contains sufficient data to allow playing
-// It is shared between the main loop() and the task below, hence volatile.
-volatile bool canPlayMusicFromBuffer = false;
-
 // Forward declarations for this helper
-void checkBufferForPlaying();
+bool checkBufferForPlaying();
 bool playMusicFromRingBuffer();
+void pollDecoder();
 
 // Create the task handle (a reference to the task being created later)
 TaskHandle_t playMusicTaskHandle;
+TaskHandle_t ingestTaskHandle;
+
+// The station the ingest task is streaming (or trying to)
+int ingestStnNo = 0;
+
+// Time the player task spent asleep waiting for DREQ/data, for the CPU load report
+unsigned long playMusicWaitMicros = 0;
+
+// Set by the ingest task on a station change, the player task then cancels the old bitstream
+std::atomic<bool> decoderFlushRequested(false);
+
+// Volume (0-100) the UI wants, -1 if none waiting. Only the player task talks to the VS1053.
+std::atomic<int> volumeRequested(-1);
+
+// DREQ has gone high: the VS1053 has room for (at least) another 32 bytes
+void IRAM_ATTR dreqInterrupt()
+{
+	BaseType_t higherPriorityTaskWoken = pdFALSE;
+	vTaskNotifyGiveFromISR(playMusicTaskHandle, &higherPriorityTaskWoken);
+	if (higherPriorityTaskWoken)
+	{
+		portYIELD_FROM_ISR();
+	}
+}
+
+// Ask the player task (the only one that sends audio) to flush the decoder
+void requestDecoderFlush()
+{
+	decoderFlushRequested = true;
+	wakePlayMusicTask();
+}
+
+// Ask the player task to set the volume, between bursts (the last request wins)
+void requestVolume(uint8_t volume)
+{
+	volumeRequested = volume;
+	wakePlayMusicTask();
+}
+
+// The ingest task has just put more audio into the ring buffer
+void wakePlayMusicTask()
+{
+	if (playMusicTaskHandle)
+	{
+		xTaskNotifyGive(playMusicTaskHandle);
+	}
+}
 
 // This is the task that we will start running (on Core 1, don't use Core 0)
 void playMusicTask(void *parameter)
 {
 	static unsigned long prevMillis = 0;
+	static unsigned long prevMicros = micros();
+	static unsigned long prevDecoderPoll = 0;
 
 	// Do this forever
 	while (1)
 	{
-		// If we (no longer) need to buffer the streaming data (after a station change)
-		// allow the buffer to be played, but if we get an error stop playing for a while
-		if (canPlayMusicFromBuffer)
+		bool sentChunk = false;
+
+		// Station change: drop whatever the decoder has of the old stream so the new one
+		// starts cleanly. This is the decoder's share of the station change time.
+		if (decoderFlushRequested.exchange(false))
 		{
-			// If we failed to play 32b from the buffer (insufficient data) set the flag again
-			if (!playMusicFromRingBuffer())
-			{
-				canPlayMusicFromBuffer = false;
-			};
+			unsigned long flushStart = micros();
+			audioSink->flush();
+			decoderMonitor.reset();
+			Serial.printf("Station change: decoder flushed in %lu us\n", micros() - flushStart);
 		}
-		else
+
+		// Mute/unmute from the UI
+		int volume = volumeRequested.exchange(-1);
+		if (volume >= 0)
+		{
+			audioSink->setVolume(volume);
+		}
+
+		// If we (no longer) need to buffer the streaming data (after a station change or
+		// running dry) allow the buffer to be played
+		if (checkBufferForPlaying())
+		{
+			sentChunk = playMusicFromRingBuffer();
+		}
+
+		// Now and again ask the decoder what it is playing. Right after a burst is best: its FIFO
+		// is full so the few SCI reads can't starve it.
+		if (millis() - prevDecoderPoll >= DecoderMonitor::pollIntervalMs)
 		{
-			// Otherwise, check whether we now have enough data to start playing
-			checkBufferForPlaying();
+			prevDecoderPoll = millis();
+			pollDecoder();
+		}
+
+		// Either the VS1053 is full or we have no data: sleep until the DREQ interrupt or the
+		// ingest task wakes us. The timeout keeps the buffer state/health figures ticking over.
+		if (!sentChunk)
+		{
+			unsigned long waitStart = micros();
+			ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BufferHealth::sampleIntervalMs));
+			playMusicWaitMicros += micros() - waitStart;
 		}
 
 		// We should check that the stack size allocated was correct. This shows the FREE
@@ -54,59 +140,392 @@ void playMusicTask(void *parameter)
 		{
 			unsigned long remainingStack = uxTaskGetStackHighWaterMark(NULL);
 			Serial.printf("Free stack:%lu\n", remainingStack);
+
+			// How much of its core this task used (it was 100% when it polled DREQ in a loop)
+			unsigned long elapsed = micros() - prevMicros;
+			unsigned long busy = elapsed > playMusicWaitMicros ? elapsed - playMusicWaitMicros : 0;
+			Serial.printf("Player task CPU: %lu.%lu%%\n", busy / (elapsed / 100), (busy * 10 / (elapsed / 100)) % 10);
+			playMusicWaitMicros = 0;
+			prevMicros = micros();
+
 			prevMillis = millis();
 		}
-
-		// Tight loops can cause the task watchdog (WDT) to fire and reboot the chip
-		// yield() will only give way to higher priority tasks, delay() allows all tasks to run
-		// delay(1);
-		// As it happens this task runs quite happily even if I put a while(1); here!!!
 	}
 }
 
-// Read the ringBuffer and give to VS1053 to play
+// Read the ringBuffer and give it to the audio sink (VS1053) to play. Returns true if we sent
+// it anything. For the VS1053 the SDI transaction is opened once and then 32 byte chunks are
+// sent straight out of the ring buffer for as long as it keeps DREQ high and we have data.
 bool playMusicFromRingBuffer()
 {
-	// Did we run out of data to send the VS1053 decoder?
-	bool dataPanic = false;
+	unsigned long burstStart = micros();
 
-	// Now read (up to) 32 bytes of audio data and play it
-	if (circBuffer.available() >= 32)
+	size_t bytesSent = feedFromRing(circBuffer, *audioSink);
+	if (!bytesSent)
 	{
-		// Does the VS1053 actually want any more data (yet)?
-		if (player.data_request())
+		return false;
+	}
+
+	feederStats.transactions++;
+	feederStats.bytesSent += bytesSent;
+	feederStats.spiMicros += micros() - burstStart;
+
+	return true;
+}
+
+// Read codec, sample rate, decode time and byte rate back from the VS1053 in one go
+void pollDecoder()
+{
+	VS1053::DecoderStatus status;
+	player.readDecoderStatus(status);
+	decoderMonitor.update(status.hdat1, status.audata, status.decodeTime, status.byteRate, circBuffer.totalRead());
+
+	// The real drain rate beats icy-br (or a guess) for the buffering levels
+	prebuffer.setDecoderByteRate(decoderMonitor.drainRate());
+}
+
+// Take any station change requests from the UI, the last one wins
+bool takeStationChangeRequest()
+{
+	bool changed = false;
+	ingestCommand command;
+
+	while (ingestCommands.receive(&command))
+	{
+		if (command.type == kCmdChangeStation && command.stationNo != ingestStnNo)
 		{
+			ingestStnNo = command.stationNo;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+// When to have another go at the station, if we lost it or couldn't get it
+ReconnectScheduler reconnects;
+
+// Reconnecting to the station we lost, so keep playing what's in the ring buffer meanwhile
+bool resumeStream = false;
+
+// The station last stored in EEPROM (only stored once we have connected to it)
+int storedStnNo = -1;
+
+// How many DNS cache entries survive a reboot (the last few stations' hosts)
+#define DNS_WARM_ENTRIES 4
+
+// Put the hosts we resolved last time into the DNS cache, so the station connects without a lookup
+void loadDnsCache()
+{
+	DnsCache::WarmEntry warm[DNS_WARM_ENTRIES];
+	size_t bytes = preferences.getBytes("dnsWarm", warm, sizeof(warm));
+	size_t count = bytes / sizeof(DnsCache::WarmEntry);
+	stationConnector.dnsCache().loadWarm(warm, count, millis());
+	Serial.printf("DNS cache: %u hosts from last time\n", (unsigned)count);
+}
+
+// Save the most recent DNS cache entries, only when they have changed (flash wear)
+void saveDnsCache()
+{
+	DnsCache &cache = stationConnector.dnsCache();
+	if (!cache.warmChanged())
+	{
+		return;
+	}
+
+	DnsCache::WarmEntry warm[DNS_WARM_ENTRIES];
+	memset(warm, 0, sizeof(warm));
+	size_t count = cache.saveWarm(warm, DNS_WARM_ENTRIES);
+	preferences.putBytes("dnsWarm", warm, count * sizeof(DnsCache::WarmEntry));
+}
+
+// Most permanent redirects we keep across reboots
+#define REDIRECTS_SAVED 4
+
+// Permanent (301/308) redirects learned before the last reboot
+void loadRedirectCache()
+{
+	RedirectCache::SavedEntry saved[REDIRECTS_SAVED];
+	size_t bytes = preferences.getBytes("redirects", saved, sizeof(saved));
+	size_t count = bytes / sizeof(RedirectCache::SavedEntry);
+	redirectCache.loadPermanent(saved, count);
+	Serial.printf("Redirect cache: %u stations from last time\n", (unsigned)count);
+}
+
+// Save the permanent redirects, only when they have changed
+void saveRedirectCache()
+{
+	if (!redirectCache.permanentChanged())
+	{
+		return;
+	}
+
+	RedirectCache::SavedEntry saved[REDIRECTS_SAVED];
+	memset(saved, 0, sizeof(saved));
+	size_t count = redirectCache.savePermanent(saved, REDIRECTS_SAVED);
+	if (count)
+	{
+		preferences.putBytes("redirects", saved, count * sizeof(RedirectCache::SavedEntry));
+	}
+	else
+	{
+		preferences.remove("redirects");
+	}
+}
+
+// (Re)start connecting to the ingest station, ingestConnectStep() takes it from there
+void connectToIngestStation()
+{
+	reconnects.started();
+	stationConnectBegin(ingestStnNo, resumeStream);
+}
+
+// Have another go later, how much later depends on what went wrong and how often
+void scheduleReconnect(ReconnectScheduler::reconnectCause cause)
+{
+	// Sometimes we get randomly disconnected from WiFi BUG Why?
+	bool wifiDown = WiFi.status() != WL_CONNECTED;
+	if (wifiDown)
+	{
+		cause = ReconnectScheduler::kCauseWifiDown;
+	}
+
+	uint32_t runwayMs = resumeStream ? bufferedMs(circBuffer.available()) : 0;
+	uint32_t delayMs = reconnects.failed(cause, millis(), runwayMs);
+	Serial.printf("Reconnect (%s) in %lums, attempt %lu, %lums of audio left\n",
+				  ReconnectScheduler::causeName(cause), (unsigned long)delayMs,
+				  (unsigned long)reconnects.consecutiveFailures(), (unsigned long)runwayMs);
+
+	// The access point can come back while we wait
+	if (wifiDown)
+	{
+		startWifiReconnect();
+	}
+}
+
+// The stream we were playing has gone. Go back for it, playing out the buffer meanwhile.
+void streamLost(const char *why)
+{
+	Serial.printf("Stream lost: %s\n", why);
+	stationConnector.cancel();
+	resumeStream = true;
+	scheduleReconnect(ReconnectScheduler::kCauseStreamLost);
+}
+
+// The ingest loop has given up on the stream (see ingestLoop.h). A stall (the station stopped
+// sending, or slowed to a trickle) is caught while the buffer still covers the reconnect.
+void ingestStreamLost(IngestLoop::lostCause cause)
+{
+	if (cause == IngestLoop::kLostStalled)
+	{
+		Serial.printf("Stall: %lu bytes/sec arriving, %lu needed, predicted runway %lums (reconnect needs %lums)\n",
+					  (unsigned long)stallWatchdog.arrivalRate(millis()), (unsigned long)drainByteRate(),
+					  (unsigned long)stallWatchdog.predictedMs(), (unsigned long)stallWatchdog.leadMs());
+	}
+	streamLost(IngestLoop::lostName(cause));
+}
+
+// Did the reconnect after a stall beat the buffer running dry? Log the runway we actually had.
+void followUpStall()
+{
+	if (!stallWatchdog.stallOpen())
+	{
+		return;
+	}
+
+	uint32_t predicted = stallWatchdog.predictedMs();
+	if (stationConnector.streaming())
+	{
+		uint32_t leftMs = bufferedMs(circBuffer.available());
+		uint32_t actual = stallWatchdog.recovered(millis(), leftMs);
+		Serial.printf("Stall over: streaming again with %lums to spare, runway predicted %lums, actual %lums\n",
+					  (unsigned long)leftMs, (unsigned long)predicted, (unsigned long)actual);
+	}
+	else if (circBuffer.available() == 0)
+	{
+		uint32_t actual = stallWatchdog.ranDry(millis());
+		Serial.printf("Stall: buffer ran dry before we reconnected, runway predicted %lums, actual %lums\n",
+					  (unsigned long)predicted, (unsigned long)actual);
+	}
+}
+
+// Move the connection along while the rest of the task carries on (station changes are
+// still seen straight away). On failure the reconnect scheduler says when to go again.
+void ingestConnectStep()
+{
+	if (reconnects.waiting())
+	{
+		if (reconnects.due(millis()))
+		{
+			// No point trying the station until the WiFi is back
+			if (WiFi.status() != WL_CONNECTED)
 			{
-				// Read (up to) 32 bytes of data from the circular (ring) buffer
-				int bytesRead = circBuffer.read((char *)mp3buff, 32);
-
-				// If we didn't read the full 32 bytes, that's a worry!
-				if (bytesRead != 32)
-				{
-					Serial.printf("Only read %db from ring buff\n", bytesRead);
-					dataPanic = true;
-				}
-
-				// Actually send the data to the VS1053
-				player.playChunk(mp3buff, bytesRead);
+				scheduleReconnect(ReconnectScheduler::kCauseWifiDown);
 			}
+			else
+			{
+				connectToIngestStation();
+			}
+		}
+		return;
+	}
+
+	switch (stationConnectStep(ingestStnNo))
+	{
+	case StationConnector::kAwaitingAudio:
+		// Store (new) current station in EEPROM
+		if (ingestStnNo != storedStnNo)
+		{
+			storedStnNo = ingestStnNo;
+			preferences.putUInt("currStnNo", ingestStnNo);
+			Serial.printf("Current station now stored: %u\n", ingestStnNo);
 		}
+		saveDnsCache();
+		saveRedirectCache();
+		break;
+
+	case StationConnector::kStreaming:
+		// Only once it has stayed up a while does it count as back (a server that takes us and
+		// hangs up straight away keeps backing off)
+		if (reconnects.streaming(millis()))
+		{
+			const ReconnectScheduler::Stats &stats = reconnects.stats();
+			Serial.printf("Back after %lums and %lu attempts (outages %lu, down %lums in all, longest %lums; "
+						  "attempts WiFi %lu, server %lu, stream %lu)\n",
+						  (unsigned long)stats.lastOutageMs, (unsigned long)stats.lastAttempts,
+						  (unsigned long)stats.outages, (unsigned long)stats.downtimeMs,
+						  (unsigned long)stats.longestOutageMs,
+						  (unsigned long)stats.attempts[ReconnectScheduler::kCauseWifiDown],
+						  (unsigned long)stats.attempts[ReconnectScheduler::kCauseServerRefused],
+						  (unsigned long)stats.attempts[ReconnectScheduler::kCauseStreamLost]);
+		}
+		resumeStream = false;
+		break;
+
+	case StationConnector::kFailed:
+		scheduleReconnect(ReconnectScheduler::kCauseServerRefused);
+		break;
+
+	default:
+		break;
 	}
+}
+
+// Now actually connect to the new station
+void switchIngestStation()
+{
+	// Nothing more of the old station for the player, and have the decoder cancel what it
+	// has while we connect (SM_CANCEL, no soft reset) so it is ready when the new one arrives
+	circBuffer.flush();
+	requestDecoderFlush();
+
+	// Anything still in progress (or waiting to retry) for the old station is abandoned
+	reconnects.abandon();
+	stallWatchdog.abandon();
+	resumeStream = false;
+	connectToIngestStation();
+}
+
+// This task reads the internet stream into the ring buffer (on Core 0, with the WiFi stack)
+void ingestTask(void *parameter)
+{
+	static unsigned long prevMillis = 0;
+
+	// Connect to the station that was playing before
+	ingestStnNo = currStnNo;
+	storedStnNo = currStnNo;
+	Serial.printf("Current station number: %u\n", ingestStnNo);
+	loadDnsCache();
+	loadRedirectCache();
+	reconnects.seed(esp_random());
+	ingestLoop.setMetadataHandler(handleMetaData, nullptr);
+	connectToIngestStation();
+
+	// Do this forever
+	while (1)
+	{
+		// Has the user pressed NEXT/PREV? (even part way through connecting)
+		if (takeStationChangeRequest())
+		{
+			switchIngestStation();
+			continue;
+		}
+
+		// Move any connect along (and pick up background DNS refreshes while streaming)
+		ingestConnectStep();
+		followUpStall();
+
+		// Still connecting: come straight back round
+		if (!stationConnector.streaming())
+		{
+			taskSleepMs(1);
+		}
+		else
+		{
+			// Read whatever has arrived, and check the stream is still in step and arriving
+			IngestLoop::stepResult result = ingestLoop.step(drainByteRate());
+
+			// The player task may be asleep waiting for data
+			if (ingestLoop.lastAudioBytes())
+			{
+				wakePlayMusicTask();
+			}
+			printIngestStats();
+
+			if (result == IngestLoop::kLost)
+			{
+				ingestStreamLost(ingestLoop.lostReason());
+			}
+
+			// Ring buffer full (let the player catch up) or nothing arrived yet (don't starve the
+			// idle task's watchdog on this core)
+			else if (result != IngestLoop::kRead)
+			{
+				taskSleepMs(1);
+			}
+		}
 
-	return !dataPanic;
+		// Same stack check as the music task
+		if (millis() - prevMillis > 60000)
+		{
+			unsigned long remainingStack = uxTaskGetStackHighWaterMark(NULL);
+			Serial.printf("Ingest free stack:%lu\n", remainingStack);
+			Serial.printf("Ingest slowest read %luus, metadata blocks in pieces %lu (slowest %lums)\n",
+						  (unsigned long)ingestLoop.takeSlowestReadMicros(), (unsigned long)icyDemuxer.splitBlocks(),
+						  (unsigned long)icyDemuxer.longestMetadataMs());
+			prevMillis = millis();
+		}
+	}
 }
 
-// Called from the main setup() routine, it sets up the above task and runs it as soon as it
-// is declared (so choose your moment wisely)
+// Called from the main setup() routine, it sets up the above tasks and runs them as soon as they
+// are declared (so choose your moment wisely)
 void taskSetup()
 {
+	// Queues between loop() (the UI) and the ingest task
+	ingestCommands.begin(sizeof(ingestCommand), 4);
+	uiEvents.begin(sizeof(uiEvent), 8);
+
 	// Independent Task to play music
 	xTaskCreatePinnedToCore(
 		playMusicTask,		  /* Function to implement the task */
 		"WebRadio",			  /* Name of the task */
-		1700,				  /* Stack size in words */
+		3072,				  /* Stack size in words (buffer reporting uses printf) */
 		NULL,				  /* Task input parameter */
 		1,					  /* Priority of the task - must be higher than 0 (idle)*/
 		&playMusicTaskHandle, /* Task handle. */
 		1);					  /* Core where the task should run */
-}
\ No newline at end of file
+
+	// The player task sleeps until the VS1053 asks for more data
+	attachInterrupt(digitalPinToInterrupt(VS1053_DREQ), dreqInterrupt, RISING);
+
+	// Independent Task to read the stream, above loop() priority so the UI can't starve it
+	startTask(
+		ingestTask,		   /* Function to implement the task */
+		"Ingest",		   /* Name of the task */
+		8192,			   /* Stack size in bytes */
+		NULL,			   /* Task input parameter */
+		2,				   /* Priority of the task - above loop() (1) */
+		0,				   /* Core where the task should run (network core) */
+		&ingestTaskHandle); /* Task handle. */
+}
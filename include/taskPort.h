@@ -0,0 +1,63 @@
+/*
+	The few RTOS facilities the radio needs - start a task pinned to a core,
+	pass fixed size messages between tasks and sleep - wrapped up so that the
+	code using them also builds on the host (Linux/macOS), where a task is a
+	std::thread and a queue is a mutex protected deque.
+
+	On the ESP32 these are thin shims over xTaskCreatePinnedToCore(),
+	xQueueSend()/xQueueReceive(), vTaskDelay() and esp_timer_get_time().
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+typedef TaskHandle_t taskHandle;
+#else
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+typedef void *taskHandle;
+#endif
+
+typedef void (*taskFunction)(void *parameter);
+
+// Start a task running immediately. On the host priority and core are ignored.
+bool startTask(taskFunction function, const char *name, uint32_t stackBytes, void *parameter,
+			   unsigned priority, int core, taskHandle *handle = nullptr);
+
+// Give up the CPU for (at least) this long
+void taskSleepMs(uint32_t ms);
+
+// Microseconds since some fixed point (boot), never goes backwards
+uint64_t monotonicMicros();
+
+// Fixed size, fixed length queue of messages, copied in and out
+class MessageQueue
+{
+public:
+	MessageQueue();
+
+	// Create the queue, call once before any task uses it
+	bool begin(size_t itemSize, size_t length);
+
+	// Returns false if the queue stayed full (send) or empty (receive) for waitMs
+	bool send(const void *item, uint32_t waitMs = 0);
+	bool receive(void *item, uint32_t waitMs = 0);
+
+private:
+	size_t itemSize;
+#ifdef ESP_PLATFORM
+	QueueHandle_t queue;
+#else
+	size_t length;
+	std::deque<std::vector<uint8_t>> items;
+	std::mutex lock;
+	std::condition_variable changed;
+#endif
+};
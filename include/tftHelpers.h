@@ -139,29 +139,10 @@ void setupDisplayModule()
 	return;
 }
 
-// Some track titles are ALL IN UPPER CASE, so ugly, so let's convert them
-// Stackoverflow: https://stackoverflow.com/a/64128715
-std::string toTitle(std::string s, const std::locale &loc)
-{
-	// Is the current character a word delimiter (a space)?
-	bool last = true;
-
-	// Process each character in the supplied string
-	for (char &c : s)
-	{
-		// If the previous character was a word delimiter (space)
-		// then upper case current word start, else make lower case
-		c = last ? std::toupper(c, loc) : std::tolower(c, loc);
-
-		// Is this character a space?
-		last = std::isspace(c, loc);
-	}
-	return s;
-}
-
 // Draw proof-of-concept NEXT button TODO: expose coordinates
 void drawNextButton()
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	// tft.fillRoundRect(NEXT_BUTTON_X, REDBUTTON_Y, REDBUTTON_W, REDBUTTON_H, 5, TFT_RED);
 	// tft.drawRoundRect(FRAME_X, FRAME_Y, FRAME_W, FRAME_H, 5, TFT_YELLOW);
 	// tft.setTextColor(TFT_WHITE);
@@ -175,6 +156,7 @@ void drawNextButton()
 // Draw proof-of-concept PREV button TODO: expose coordinates
 void drawPrevButton()
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	// tft.fillRoundRect(NEXT_BUTTON_X - 100, REDBUTTON_Y, REDBUTTON_W, REDBUTTON_H, 5, TFT_BLUE);
 	// tft.drawRoundRect(FRAME_X - 100, FRAME_Y, FRAME_W, FRAME_H, 5, TFT_YELLOW);
 	// tft.setTextColor(TFT_WHITE);
@@ -188,6 +170,7 @@ void drawPrevButton()
 // Mute button uses object
 void drawMuteButton(bool invert)
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	//tft.setFreeFont(&FreeSansBold9pt7b);
 	//tft.setTextSize(1);
 	muteBtn.drawButton(invert);
@@ -195,76 +178,87 @@ void drawMuteButton(bool invert)
 
 void drawMuteBitmap(bool isMuted)
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	drawBmp(isMuted ? "/MuteIconOn.bmp" : "/MuteIconOff.bmp", 190, FRAME_Y - 5);
 }
 
 void drawBrightButton(bool invert)
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	tft.setFreeFont(&FreeSansBold12pt7b);
 	brightBtn.drawButton(invert);
 }
 
 void drawDimButton(bool invert)
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	tft.setFreeFont(&FreeSansBold12pt7b);
 	dimBtn.drawButton(invert);
 }
 
-// Draw percentage of buffering (eg 10000 buffer that uses 8000 bytes = 80%)
+// The touch controller shares the SPI bus with the screen and the VS1053
+bool readTouch(uint16_t *x, uint16_t *y, uint16_t threshold)
+{
+	SpiBusClaim claim(spiBus, kBusTouch);
+	return tft.getTouch(x, y, threshold);
+}
+
+// Draw how much audio is buffered, in seconds at the rate the decoder is taking it
+// (eg 80000 bytes of a 128kbps stream = 5.0s)
 void drawBufferLevel(size_t bufferLevel, bool override)
 {
 	static unsigned long prevMillis = millis();
-	static int prevBufferPerCent = 0;
+	static uint32_t prevBufferTenths = 0;
 
-	// Only do this infrequently and if the buffer % changes
+	// Only do this infrequently and if the buffered time changes
 	if (millis() - prevMillis > 500 || override)
 	{
 		// Capture current values for next time
 		prevMillis = millis();
 
-		// Calculate the percentage (ESP32 has FP processor so shoud be efficient)
-		float bufLevel = (float)bufferLevel;
-		float arraySize = (float)(CIRCULARBUFFERSIZE);
-		int bufferPerCent = (bufLevel / arraySize) * 100.0;
+		// Tenths of a second of audio
+		uint32_t bufferTenths = bufferedMs(bufferLevel) / 100;
 
 		// Only update the screen on real change (avoids flicker & saves time)
-		if (bufferPerCent != prevBufferPerCent || override)
+		if (bufferTenths != prevBufferTenths || override)
 		{
-			// Track the buffer percentage
-			prevBufferPerCent = bufferPerCent;
+			// Track the buffered time
+			prevBufferTenths = bufferTenths;
 
 			// Print at specific rectangular place
 			// TODO: These should not be magic numbers
 			uint16_t bgColour, fgColour;
-			switch (bufferPerCent)
+			if (bufferTenths < 20)
 			{
-			case 0 ... 30:
 				bgColour = TFT_RED;
 				fgColour = TFT_WHITE;
-				break;
-
-			case 31 ... 74:
+			}
+			else if (bufferTenths < 50)
+			{
 				bgColour = TFT_ORANGE;
 				fgColour = TFT_BLACK;
-				break;
-
-			case 75 ... 100:
+			}
+			else
+			{
 				bgColour = TFT_DARKGREEN;
 				fgColour = TFT_WHITE;
-				break;
-
-			default:
-				bgColour = TFT_WHITE;
-				fgColour = TFT_BLACK;
-			};
+			}
 
+			SpiBusClaim claim(spiBus, kBusDisplay);
 			tft.fillRoundRect(250, FRAME_Y, 60, 30, 5, bgColour);
 			tft.drawRoundRect(250, FRAME_Y, 60, 30, 5, TFT_RED);
 			tft.setTextColor(fgColour, bgColour);
 			tft.setFreeFont(&FreeSans9pt7b);
 			tft.setTextSize(1);
 			tft.setCursor(261, FRAME_Y + 20);
-			tft.printf("%d%%\n", bufferPerCent);
+			if (bufferTenths < 1000)
+			{
+				tft.printf("%lu.%lus\n", (unsigned long)bufferTenths / 10, (unsigned long)bufferTenths % 10);
+			}
+			else
+			{
+				tft.printf("%lus\n", (unsigned long)bufferTenths / 10);
+			}
 		}
 	}
 }
@@ -276,6 +270,7 @@ bool getNextButtonPress(uint16_t t_x, uint16_t t_y)
 	if (nextBtn.contains(t_x, t_y))
 	{
 		//Serial.printf("Next: x=%d, y=%d\n", t_x, t_y);
+		SpiBusClaim claim(spiBus, kBusDisplay);
 		nextBtn.drawButton(true);
 		return true;
 	}
@@ -289,6 +284,7 @@ bool getPrevButtonPress(uint16_t t_x, uint16_t t_y)
 	if (prevBtn.contains(t_x, t_y))
 	{
 		//Serial.printf("Prev: x=%d, y=%d\n", t_x, t_y);
+		SpiBusClaim claim(spiBus, kBusDisplay);
 		prevBtn.drawButton(true);
 		return true;
 	}
@@ -310,7 +306,7 @@ void getBrightButtonPress()
 		prevMillis = millis();
 
 		// Pressed will be set true is there is a valid touch on the screen
-		boolean pressed = tft.getTouch(&t_x, &t_y);
+		boolean pressed = readTouch(&t_x, &t_y);
 
 		// Check if any key coordinate boxes contain the touch coordinates
 		if (pressed && brightBtn.contains(t_x, t_y))
@@ -357,7 +353,7 @@ void getDimButtonPress()
 		prevMillis = millis();
 
 		// Pressed will be set true is there is a valid touch on the screen
-		boolean pressed = tft.getTouch(&t_x, &t_y);
+		boolean pressed = readTouch(&t_x, &t_y);
 
 		// Check if any key coordinate boxes contain the touch coordinates
 		if (pressed && dimBtn.contains(t_x, t_y))
@@ -405,7 +401,7 @@ void getMuteButtonPress()
 		prevMillis = millis();
 
 		// Pressed will be set true is there is a valid touch on the screen
-		boolean pressed = tft.getTouch(&t_x, &t_y);
+		boolean pressed = readTouch(&t_x, &t_y);
 
 		// Check if any key coordinate boxes contain the touch coordinates
 		if (pressed && muteBtn.contains(t_x, t_y))
@@ -422,7 +418,7 @@ void getMuteButtonPress()
 			isMutedState = !isMutedState;
 
 			Serial.printf("Mute: %s", isMutedState ? "muted" : "UNmuted");
-			player.setVolume(isMutedState ? 0 : 100);
+			requestVolume(isMutedState ? 0 : 100);
 			drawMuteBitmap(isMutedState);
 		}
 	}
@@ -430,6 +426,7 @@ void getMuteButtonPress()
 
 void displayStationName(const char *stationName)
 {
+	SpiBusClaim claim(spiBus, kBusDisplay);
 	// Set text colour and background
 	tft.setTextColor(TFT_YELLOW, TFT_BLACK);
 
@@ -443,34 +440,27 @@ void displayStationName(const char *stationName)
 	tft.println(stationName);
 }
 
-void displayTrackArtist(std::string trackArtist)
+// "Artist - Track" or "Artist - Track - Album", split in place (the " - "s become nulls)
+void displayTrackArtist(char *trackArtist)
 {
-	std::string track = "";
-	std::string artist = "";
-	std::string album = "";
+	const char *track = trackArtist;
+	const char *artist = "";
+	const char *album = "";
 
-	if (!trackArtist.empty())
+	char *first = strstr(trackArtist, " - ");
+	if (first)
 	{
-		size_t first = trackArtist.find(" - ");
-		if (first == std::string::npos)
-		{
-			track = trackArtist;
-		}
-		else
+		*first = '\0';
+		artist = trackArtist;
+		track = first + 3;
+
+		char *second = strstr(first + 3, " - ");
+		if (second)
 		{
-			artist = trackArtist.substr(0, first);
-			size_t second = trackArtist.find(" - ", first + 3);
-			if (second == std::string::npos)
-			{
-				track = trackArtist.substr(first + 3);
-			}
-			else
-			{
-				track = trackArtist.substr(first + 3, second - (first + 3));
-				album = trackArtist.substr(second + 3);
-			}
+			*second = '\0';
+			album = second + 3;
 		}
 	}
 
-	lvglUpdateTrackInfo(track.c_str(), artist.c_str(), album.c_str());
+	lvglUpdateTrackInfo(track, artist, album);
 }
@@ -0,0 +1,51 @@
+/*
+	Tidies up track titles for the screen: some stations send them ALL IN
+	CAPITALS, some in UTF-8 and some (older Shoutcast servers mostly) in
+	ISO-8859-1, or really Windows-1252.
+
+	normalise() decides which it is. Anything that isn't valid UTF-8 is
+	taken as Windows-1252 and converted to UTF-8. Then every word is put
+	into title case: first letter upper case, the rest lower case.
+
+	Case is changed with a table of Unicode ranges covering ASCII, Latin-1,
+	Latin Extended-A (Slovak, Czech, Polish...) and Cyrillic (Russian,
+	Ukrainian...). Every pair in the table encodes to the same number of
+	UTF-8 bytes, so it is all done in place without allocating. Characters
+	outside the table are left as they are.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class TitleCase
+{
+public:
+	enum textEncoding
+	{
+		kAscii,
+		kUtf8,
+		kLatin1, // ISO-8859-1, with Windows-1252 in 0x80-0x9F
+	};
+
+	// What is this text in? For UTF-8 cut off part way through a character, validLen is where the
+	// last whole one ends.
+	static textEncoding detect(const char *text, size_t len, size_t &validLen);
+
+	// Convert to UTF-8 (if need be) and title case, in place. The buffer holds capacity bytes, so
+	// Latin-1 text has room to grow (whole characters that don't fit are dropped). Returns the new
+	// length, the text is null terminated.
+	static size_t normalise(char *text, size_t len, size_t capacity);
+
+	// The same, from len bytes of text into a buffer of capacity bytes (it may be the same one). The
+	// encoding is decided on all of the text, and UTF-8 is only cut between characters.
+	static size_t normaliseInto(char *out, size_t capacity, const char *text, size_t len);
+
+	// The case of a single character, characters not in the table come back as they are
+	static uint32_t toUpper(uint32_t cp);
+	static uint32_t toLower(uint32_t cp);
+
+private:
+	static size_t latin1ToUtf8(char *text, size_t len, size_t capacity);
+	static void titleCaseUtf8(char *text, size_t len);
+};
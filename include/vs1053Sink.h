@@ -0,0 +1,25 @@
+/*
+	The VS1053 as an AudioSink. ready() is DREQ and a burst is one SDI
+	transaction, so feedFromRing() sends exactly what the old feeder did.
+*/
+#pragma once
+
+#include <VS1053.h>
+
+#include "audioSink.h"
+
+class Vs1053Sink : public AudioSink
+{
+public:
+	Vs1053Sink(VS1053 &player);
+
+	bool ready() override;
+	size_t write(const uint8_t *data, size_t len) override;
+	void setVolume(uint8_t volume) override;
+	void flush() override;
+	void beginBurst() override;
+	void endBurst() override;
+
+private:
+	VS1053 &player;
+};
@@ -60,6 +60,14 @@ void connectToWifi()
 	wiFiDisconnected = false;
 }
 
+// Have another go at the access point without waiting for it (the ingest task polls WiFi.status())
+void startWifiReconnect()
+{
+	Serial.printf("Reconnecting to SSID: %s\n", ssid.c_str());
+	WiFi.disconnect(false, true);
+	WiFi.begin(ssid.c_str(), wifiPassword.c_str());
+}
+
 // Get the WiFi SSID
 std::string getSSID()
 {
@@ -31,41 +31,90 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef ARDUINO
 #include <ArduinoLog.h>
+#endif
 #include <VS1053.h>
 #include <string>
 
 VS1053::VS1053(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin)
-        : cs_pin(_cs_pin), dcs_pin(_dcs_pin), dreq_pin(_dreq_pin) {
+        : cs_pin(_cs_pin), dcs_pin(_dcs_pin), dreq_pin(_dreq_pin), shadow_valid(0) {
+#ifdef ARDUINO
+    transport = &spi_transport;
+#else
+    transport = nullptr;
+#endif
+}
+
+void VS1053::setTransport(VS1053Transport *_transport) {
+#ifdef ARDUINO
+    transport = _transport ? _transport : &spi_transport;
+#else
+    transport = _transport;
+#endif
+}
+
+void VS1053::shadow_update(uint8_t _reg, uint16_t _value) const {
+    if (_reg == SCI_MODE && (_value & _BV(SM_RESET))) {
+        shadow_valid = 0; // Soft reset, the chip may have changed anything
+    } else if (cacheable(_reg, _value)) {
+        shadow[_reg] = _value;
+        shadow_valid |= _BV(_reg);
+    } else {
+        shadow_valid &= ~_BV(_reg);
+    }
 }
 
 uint16_t VS1053::read_register(uint8_t _reg) const {
-    uint16_t result;
-
-    control_mode_on();
-    SPI.write(3);    // Read operation
-    SPI.write(_reg); // Register to write (0..0xF)
-    // Note: transfer16 does not seem to work
-    result = (SPI.transfer(0xFF) << 8) | // Read 16 bits data
-             (SPI.transfer(0xFF));
-    await_data_request(); // Wait for DREQ to be HIGH again
-    control_mode_off();
-    return result;
+    if (shadow_valid & _BV(_reg)) {
+        return shadow[_reg];
+    }
+    return read_register_uncached(_reg);
+}
+
+uint16_t VS1053::read_register_uncached(uint8_t _reg) const {
+    uint16_t value = transport->sciRead(_reg);
+    if (cacheable(_reg, value)) {
+        shadow[_reg] = value;
+        shadow_valid |= _BV(_reg);
+    }
+    return value;
 }
 
 void VS1053::write_register(uint8_t _reg, uint16_t _value) const {
-    control_mode_on();
-    SPI.write(2);        // Write operation
-    SPI.write(_reg);     // Register to write (0..0xF)
-    SPI.write16(_value); // Send 16 bits data
-    await_data_request();
-    control_mode_off();
+    transport->sciWrite(_reg, _value);
+    shadow_update(_reg, _value);
+}
+
+void VS1053::writeRegisters(const VS1053RegisterWrite *writes, size_t count) {
+    VS1053RegisterWrite pending[8];
+    size_t pending_count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t reg = writes[i].reg;
+        uint16_t value = writes[i].value;
+
+        // Already there? Then there is nothing to send
+        if ((shadow_valid & _BV(reg)) && shadow[reg] == value && cacheable(reg, value)) {
+            continue;
+        }
+
+        pending[pending_count++] = writes[i];
+        if (pending_count == sizeof(pending) / sizeof(pending[0])) {
+            transport->sciWriteBatch(pending, pending_count);
+            pending_count = 0;
+        }
+        shadow_update(reg, value);
+    }
+    if (pending_count) {
+        transport->sciWriteBatch(pending, pending_count);
+    }
 }
 
 void VS1053::sdi_send_buffer(uint8_t *data, size_t len) {
     size_t chunk_length; // Length of chunk 32 byte or shorter
 
-    data_mode_on();
+    transport->sdiBegin();
     while (len) // More to do?
     {
         await_data_request(); // Wait for space available
@@ -74,16 +123,18 @@ void VS1053::sdi_send_buffer(uint8_t *data, size_t len) {
             chunk_length = vs1053_chunk_size;
         }
         len -= chunk_length;
-        SPI.writeBytes(data, chunk_length);
+        transport->sdiWrite(data, chunk_length);
         data += chunk_length;
     }
-    data_mode_off();
+    transport->sdiEnd();
 }
 
 void VS1053::sdi_send_fillers(size_t len) {
     size_t chunk_length; // Length of chunk 32 byte or shorter
+    uint8_t fillers[32];
 
-    data_mode_on();
+    memset(fillers, endFillByte, sizeof(fillers));
+    transport->sdiBegin();
     while (len) // More to do?
     {
         await_data_request(); // Wait for space available
@@ -92,11 +143,9 @@ void VS1053::sdi_send_fillers(size_t len) {
             chunk_length = vs1053_chunk_size;
         }
         len -= chunk_length;
-        while (chunk_length--) {
-            SPI.write(endFillByte);
-        }
+        transport->sdiWrite(fillers, chunk_length);
     }
-    data_mode_off();
+    transport->sdiEnd();
 }
 
 void VS1053::wram_write(uint16_t address, uint16_t data) {
@@ -110,35 +159,39 @@ uint16_t VS1053::wram_read(uint16_t address) {
 }
 
 bool VS1053::testComm(const char *header) {
+    uint16_t delta = 300; // 3 for fast SPI
+
+    if (strstr(header, "Fast")) {
+        delta = 3; // Fast SPI, more loops
+    }
+    return testComm(header, delta);
+}
+
+bool VS1053::testComm(const char *header, uint16_t delta) {
     // Test the communication with the VS1053 module.  The result wille be returned.
     // If DREQ is low, there is problably no VS1053 connected.  Pull the line HIGH
     // in order to prevent an endless loop waiting for this signal.  The rest of the
     // software will still work, but readbacks from VS1053 will fail.
     int i; // Loop control
     uint16_t r1, r2, cnt = 0;
-    uint16_t delta = 300; // 3 for fast SPI
 
-    if (!digitalRead(dreq_pin)) {
+    if (!transport->dreq()) {
         Log.error("VS1053 not properly installed!" CR);
         // Allow testing without the VS1053 module
-        pinMode(dreq_pin, INPUT_PULLUP); // DREQ is now input with pull-up
+        transport->dreqPullUp(); // DREQ is now input with pull-up
         return false;                    // Return bad result
     }
     // Further TESTING.  Check if SCI bus can write and read without errors.
     // We will use the volume setting for this.
     // Will give warnings on serial output if DEBUG is active.
     // A maximum of 20 errors will be reported.
-    if (strstr(header, "Fast")) {
-        delta = 3; // Fast SPI, more loops
-    }
-
     std::string headerCr = std::string(header) + CR;
     Log.notice(headerCr.c_str());  // Show a header
 
     for (i = 0; (i < 0xFFFF) && (cnt < 20); i += delta) {
         write_register(SCI_VOL, i);         // Write data to SCI_VOL
-        r1 = read_register(SCI_VOL);        // Read back for the first time
-        r2 = read_register(SCI_VOL);        // Read back a second time
+        r1 = read_register_uncached(SCI_VOL); // Read back for the first time
+        r2 = read_register_uncached(SCI_VOL); // Read back a second time
         if (r1 != r2 || i != r1 || i != r2) // Check for 2 equal reads
         {
             Log.error("VS1053 error retry SB:%04X R1:%04X R2:%04X" CR, i, r1, r2);
@@ -150,24 +203,19 @@ bool VS1053::testComm(const char *header) {
     return (cnt == 0); // Return the result
 }
 
-bool VS1053::begin() {
+bool VS1053::begin(bool fullSelfTest) {
     bool result = false;
-    pinMode(dreq_pin, INPUT); // DREQ is an input
-    pinMode(cs_pin, OUTPUT);  // The SCI and SDI signals
-    pinMode(dcs_pin, OUTPUT);
-    digitalWrite(dcs_pin, HIGH); // Start HIGH for SCI en SDI
-    digitalWrite(cs_pin, HIGH);
+    shadow_valid = 0; // Whatever we knew is about to be reset
+    transport->begin(cs_pin, dcs_pin, dreq_pin); // Pins set up, XCS and XDCS high
     delay(100);
     Log.notice("Reset VS1053..." CR);
-    digitalWrite(dcs_pin, LOW); // Low & Low will bring reset pin low
-    digitalWrite(cs_pin, LOW);
+    transport->setReset(true); // Low & Low will bring reset pin low
     delay(500);
     Log.notice("End reset VS1053..." CR);
-    digitalWrite(dcs_pin, HIGH); // Back to normal again
-    digitalWrite(cs_pin, HIGH);
+    transport->setReset(false); // Back to normal again
     delay(500);
     // Init SPI in slow mode ( 0.2 MHz )
-    VS1053_SPI = SPISettings(200000, MSBFIRST, SPI_MODE0);
+    transport->setSpeed(200000);
     // printDetails ( "Right after reset/startup" ) ;
     delay(20);
     // printDetails ( "20 msec after reset" ) ;
@@ -175,14 +223,22 @@ bool VS1053::begin() {
 
     //softReset();
 
-    // Switch on the analog parts
-    write_register(SCI_AUDATA, 44101); // 44.1kHz stereo
-    // The next clocksetting allows SPI clocking at 5 MHz, 4 MHz is safe then.
-    write_register(SCI_CLOCKF, 6 << 12); // Normal clock settings multiplyer 3.0 = 12.2 MHz
+    // Switch on the analog parts, and
+    // the next clocksetting allows SPI clocking at 5 MHz, 4 MHz is safe then.
+    const VS1053RegisterWrite analog_and_clock[] = {
+        {SCI_AUDATA, 44101},  // 44.1kHz stereo
+        {SCI_CLOCKF, 6 << 12} // Normal clock settings multiplyer 3.0 = 12.2 MHz
+    };
+    writeRegisters(analog_and_clock, 2);
     // SPI Clock to 4 MHz. Now you can set high speed SPI clock.
-    VS1053_SPI = SPISettings(4000000, MSBFIRST, SPI_MODE0);
+    transport->setSpeed(4000000);
     write_register(SCI_MODE, _BV(SM_SDINEW) | _BV(SM_LINE1));
-    result = testComm("Fast SPI, Testing VS1053 read/write registers again...");
+    if (fullSelfTest) {
+        result = testComm("Fast SPI, Testing VS1053 read/write registers again...");
+    } else {
+        // The full fast test has passed on this hardware before, 16 steps will do
+        result = testComm("Fast SPI, quick test of VS1053 read/write registers...", 0x1000);
+    }
     delay(10);
     await_data_request();
     endFillByte = wram_read(0x1E06) & 0xFF;
@@ -205,6 +261,10 @@ void VS1053::setVolume(uint8_t vol) {
     }
 }
 
+uint16_t VS1053::getTone() {
+    return read_register(SCI_BASS);
+}
+
 void VS1053::setTone(uint16_t rtone) // Set bass/treble (4 nibbles)
 {
     // Set tone characteristics.  See documentation for the 4 nibbles.
@@ -230,24 +290,66 @@ void VS1053::playChunk(uint8_t *data, size_t len) {
     sdi_send_buffer(data, len);
 }
 
-void VS1053::stopSong() {
-    uint16_t modereg; // Read from mode register
-    int i;            // Loop control
+void VS1053::startDataBurst() {
+    transport->sdiBegin();
+}
+
+void VS1053::sendDataChunk(const uint8_t *data, size_t len) {
+    if (len > vs1053_chunk_size) {
+        len = vs1053_chunk_size;
+    }
+    transport->sdiWrite(data, len);
+}
+
+void VS1053::endDataBurst() {
+    transport->sdiEnd();
+}
 
+void VS1053::stopSong() {
     sdi_send_fillers(2052);
-    delay(10);
-    write_register(SCI_MODE, _BV(SM_SDINEW) | _BV(SM_CANCEL));
-    for (i = 0; i < 200; i++) {
-        sdi_send_fillers(32);
-        modereg = read_register(SCI_MODE); // Read status
-        if ((modereg & _BV(SM_CANCEL)) == 0) {
+    if (cancelSong()) {
+        Log.notice("Song stopped correctly" CR);
+    } else {
+        printDetails("Song stopped incorrectly!");
+    }
+}
+
+// The datasheet way to abandon a bitstream (VS1053b 10.5.2): set SM_CANCEL, keep feeding
+// (fillers, here) 32 bytes at a time until the decoder clears it, then send 2052 bytes of
+// endFillByte. Paced by DREQ only, no sleeping. If SM_CANCEL is still set after 2048 bytes
+// the decoder is stuck and only a soft reset will do.
+bool VS1053::cancelSong() {
+    uint16_t mode = read_register(SCI_MODE) & ~(_BV(SM_CANCEL) | _BV(SM_RESET));
+    size_t sent;
+
+    write_register(SCI_MODE, mode | _BV(SM_CANCEL));
+    for (sent = 0; sent < 2048; sent += vs1053_chunk_size) {
+        sdi_send_fillers(vs1053_chunk_size);
+        // The chip clears SM_CANCEL, so only the chip can say when
+        if ((read_register_uncached(SCI_MODE) & _BV(SM_CANCEL)) == 0) {
+            endFillByte = wram_read(0x1E06) & 0xFF; // Depends on the format just cancelled
             sdi_send_fillers(2052);
-            Log.notice("Song stopped correctly after %d msec" CR, i * 10);
-            return;
+            write_register(SCI_DECODE_TIME, 0); // Next stream's decode time starts at zero,
+            write_register(SCI_DECODE_TIME, 0); // written twice as the datasheet says
+            return true;
         }
-        delay(10);
     }
-    printDetails("Song stopped incorrectly!");
+
+    Log.notice("SM_CANCEL not cleared after %d bytes, soft reset" CR, (int)sent);
+    softReset();
+    return false;
+}
+
+void VS1053::readDecoderStatus(DecoderStatus &status) {
+    const uint8_t regs[] = {SCI_HDAT0, SCI_HDAT1, SCI_AUDATA, SCI_DECODE_TIME};
+    uint16_t values[4];
+
+    transport->sciReadBatch(regs, values, 4);
+    status.hdat0 = values[0];
+    status.hdat1 = values[1];
+    status.audata = values[2];
+    status.decodeTime = values[3];
+    status.byteRate = wram_read(0x1E05);
 }
 
 void VS1053::softReset() {
@@ -266,7 +368,7 @@ void VS1053::printDetails(const char *header) {
     Log.notice("REG   Contents" CR);
     Log.notice("---   -----" CR);
     for (i = 0; i <= SCI_num_registers; i++) {
-        regbuf[i] = read_register(i);
+        regbuf[i] = read_register_uncached(i);
     }
     for (i = 0; i <= SCI_num_registers; i++) {
         delay(5);
@@ -34,8 +34,14 @@
 #ifndef VS1053_H
 #define VS1053_H
 
+#ifdef ARDUINO
 #include <Arduino.h>
 #include <SPI.h>
+#include "VS1053SpiTransport.h"
+#else
+#include "VS1053HostShims.h"                // Host build, see VS1053Emulator
+#endif
+#include "VS1053Transport.h"
 
 class VS1053 {
 private:
@@ -48,9 +54,12 @@ private:
     const uint8_t SCI_MODE = 0x0;
     const uint8_t SCI_BASS = 0x2;
     const uint8_t SCI_CLOCKF = 0x3;
+    const uint8_t SCI_DECODE_TIME = 0x4;
     const uint8_t SCI_AUDATA = 0x5;
     const uint8_t SCI_WRAM = 0x6;
     const uint8_t SCI_WRAMADDR = 0x7;
+    const uint8_t SCI_HDAT0 = 0x8;
+    const uint8_t SCI_HDAT1 = 0x9;
     const uint8_t SCI_AIADDR = 0xA;
     const uint8_t SCI_VOL = 0xB;
     const uint8_t SCI_AICTRL0 = 0xC;
@@ -62,38 +71,36 @@ private:
     const uint8_t SM_CANCEL = 3;            // Bitnumber in SCI_MODE cancel song
     const uint8_t SM_TESTS = 5;             // Bitnumber in SCI_MODE for tests
     const uint8_t SM_LINE1 = 14;            // Bitnumber in SCI_MODE for Line input
-    SPISettings VS1053_SPI;                 // SPI settings for this slave
     uint8_t endFillByte;                    // Byte to send when stopping song
+    // Last known value of each SCI register, and a bit per register set if shadow[] is right.
+    // Not locked: every call on a VS1053 object must come from the same task.
+    mutable uint16_t shadow[16];
+    mutable uint16_t shadow_valid;
+#ifdef ARDUINO
+    VS1053SpiTransport spi_transport;       // Default transport, Arduino SPI
+#endif
+    VS1053Transport *transport;             // How we talk to the chip
 protected:
     inline void await_data_request() const {
-        while (!digitalRead(dreq_pin)) {
+        while (!transport->dreq()) {
             yield();                        // Very short delay
         }
     }
 
-    inline void control_mode_on() const {
-        SPI.beginTransaction(VS1053_SPI);   // Prevent other SPI users
-        digitalWrite(dcs_pin, HIGH);        // Bring slave in control mode
-        digitalWrite(cs_pin, LOW);
-    }
-
-    inline void control_mode_off() const {
-        digitalWrite(cs_pin, HIGH);         // End control mode
-        SPI.endTransaction();               // Allow other SPI users
+    // Registers only we change, so a read can come from the shadow copy. SCI_MODE is
+    // one of them except while SM_RESET or SM_CANCEL (which the chip clears) are set.
+    inline bool cacheable(uint8_t _reg, uint16_t _value) const {
+        if (_reg == SCI_MODE) {
+            return !(_value & (_BV(SM_RESET) | _BV(SM_CANCEL)));
+        }
+        return _reg == SCI_BASS || _reg == SCI_CLOCKF || _reg == SCI_VOL;
     }
 
-    inline void data_mode_on() const {
-        SPI.beginTransaction(VS1053_SPI);   // Prevent other SPI users
-        digitalWrite(cs_pin, HIGH);         // Bring slave in data mode
-        digitalWrite(dcs_pin, LOW);
-    }
+    void shadow_update(uint8_t _reg, uint16_t _value) const;
 
-    inline void data_mode_off() const {
-        digitalWrite(dcs_pin, HIGH);        // End data mode
-        SPI.endTransaction();               // Allow other SPI users
-    }
+    uint16_t read_register(uint8_t _reg) const;         // From the shadow copy if we can
 
-    uint16_t read_register(uint8_t _reg) const;
+    uint16_t read_register_uncached(uint8_t _reg) const; // Always from the chip
 
     void write_register(uint8_t _reg, uint16_t _value) const;
 
@@ -106,28 +113,58 @@ protected:
     uint16_t wram_read(uint16_t address);
 
 public:
+    // What the decoder says about the stream it is playing, see readDecoderStatus()
+    struct DecoderStatus {
+        uint16_t hdat0;                         // Format specific, for MP3 the frame header
+        uint16_t hdat1;                         // Format: 0xFFEx MP3, "AT" AAC ADTS, "Og" Ogg ...
+        uint16_t audata;                        // Sample rate (bits 15:1) and stereo (bit 0)
+        uint16_t decodeTime;                    // Seconds decoded since the stream started
+        uint16_t byteRate;                      // Average byte rate of the stream (WRAM 0x1E05)
+    };
+
     // Constructor.  Only sets pin values.  Doesn't touch the chip.  Be sure to call begin()!
     VS1053(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin);
 
-    bool begin();                               // Begin operation.  Sets pins correctly,
-                                                // and prepares SPI bus.
+    void setTransport(VS1053Transport *_transport); // Use another transport, call before begin().
+                                                    // Required on a host, there is no default.
+    VS1053Transport *getTransport() const {         // The transport in use
+        return transport;
+    }
+
+    bool begin(bool fullSelfTest = true);       // Begin operation.  Sets pins correctly,
+                                                // and prepares SPI bus. Without fullSelfTest the
+                                                // fast SPI register test is only a quick one.
     void startSong();                           // Prepare to start playing. Call this each
                                                 // time a new song starts.
     void playChunk(uint8_t *data, size_t len);  // Play a chunk of data.  Copies the data to
                                                 // the chip.  Blocks until complete.
     void stopSong();                            // Finish playing a song. Call this after
                                                 // the last playChunk call.
+    void readDecoderStatus(DecoderStatus &status); // HDAT0/1, AUDATA, DECODE_TIME and byteRate
+                                                // in one bus transaction (plus the WRAM read).
+    bool cancelSong();                          // Abandon the current bitstream (SM_CANCEL) so
+                                                // the next one starts cleanly, no reset needed.
+                                                // False if it had to fall back to softReset().
+    void startDataBurst();                      // Open one SDI transaction for several chunks.
+    void sendDataChunk(const uint8_t *data,     // Send up to 32 bytes inside a burst. Does NOT
+                       size_t len);             // wait for DREQ, check data_request() first.
+    void endDataBurst();                        // Close the SDI transaction, free the SPI bus.
     void setVolume(uint8_t vol);                // Set the player volume.Level from 0-100,
     // RSB changed to two-byte int              // higher is louder.
     void setTone(uint16_t rtone);               // Set the player baas/treble, 4 nibbles for
                                                 // treble gain/freq and bass gain/freq
+    uint16_t getTone();                         // Current SCI_BASS, from the shadow copy
+    void writeRegisters(const VS1053RegisterWrite *writes, // Write several SCI registers in one
+                        size_t count);                     // bus transaction, unchanged ones skipped
     uint8_t getVolume();                        // Get the currenet volume setting.
                                                 // higher is louder.
     void printDetails(const char *header);      // Print configuration details to serial output.
     void softReset();                           // Do a soft reset
     bool testComm(const char *header);          // Test communication with module
+    bool testComm(const char *header,           // Same, stepping SCI_VOL through 0..0xFFFF
+                  uint16_t delta);              // delta at a time
     inline bool data_request() const {
-        return (digitalRead(dreq_pin) == HIGH);
+        return transport->dreq();
     }
 
     void switchToMp3Mode(void);
@@ -0,0 +1,277 @@
+/**
+ * VS1053 transport using ESP-IDF spi_master queued (DMA) transactions.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifdef ESP32
+
+#include <string.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "VS1053DmaTransport.h"
+
+static const char *TAG = "VS1053DMA";
+
+VS1053DmaTransport::VS1053DmaTransport(spi_host_device_t _host, int _sck_pin, int _miso_pin, int _mosi_pin,
+                                       int _dma_channel)
+        : host(_host), sck_pin(_sck_pin), miso_pin(_miso_pin), mosi_pin(_mosi_pin), dma_channel(_dma_channel),
+          cs_pin(GPIO_NUM_NC), dcs_pin(GPIO_NUM_NC), dreq_pin(GPIO_NUM_NC), clock_hz(200000), device(nullptr),
+          next_slot(0), in_flight(0), bus_initialized(false), fallback(nullptr), use_fallback(false) {
+    for (int i = 0; i < queue_depth; i++) {
+        bounce[i] = nullptr;
+    }
+}
+
+bool VS1053DmaTransport::add_device() {
+    spi_device_interface_config_t devcfg;
+    memset(&devcfg, 0, sizeof(devcfg));
+    devcfg.clock_speed_hz = clock_hz;
+    devcfg.mode = 0;
+    devcfg.spics_io_num = -1; // XCS/XDCS are ours, there are two of them
+    devcfg.queue_size = queue_depth;
+    esp_err_t err = spi_bus_add_device(host, &devcfg, &device);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "spi_bus_add_device: %s", esp_err_to_name(err));
+        device = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void VS1053DmaTransport::release() {
+    if (device) {
+        spi_bus_remove_device(device);
+        device = nullptr;
+    }
+    if (bus_initialized) {
+        spi_bus_free(host);
+        bus_initialized = false;
+    }
+    for (int i = 0; i < queue_depth; i++) {
+        heap_caps_free(bounce[i]);
+        bounce[i] = nullptr;
+    }
+}
+
+void VS1053DmaTransport::begin(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin) {
+    cs_pin = (gpio_num_t)_cs_pin;
+    dcs_pin = (gpio_num_t)_dcs_pin;
+    dreq_pin = (gpio_num_t)_dreq_pin;
+
+    gpio_set_direction(dreq_pin, GPIO_MODE_INPUT); // DREQ is an input
+    gpio_set_direction(cs_pin, GPIO_MODE_OUTPUT);  // The SCI and SDI signals
+    gpio_set_direction(dcs_pin, GPIO_MODE_OUTPUT);
+    gpio_set_level(dcs_pin, 1); // Start HIGH for SCI en SDI
+    gpio_set_level(cs_pin, 1);
+
+    spi_bus_config_t buscfg;
+    memset(&buscfg, 0, sizeof(buscfg));
+    buscfg.mosi_io_num = mosi_pin;
+    buscfg.miso_io_num = miso_pin;
+    buscfg.sclk_io_num = sck_pin;
+    buscfg.quadwp_io_num = -1;
+    buscfg.quadhd_io_num = -1;
+    buscfg.max_transfer_sz = chunk_size;
+    esp_err_t err = spi_bus_initialize(host, &buscfg, dma_channel);
+    bool ok = err == ESP_OK;
+    if (ok) {
+        bus_initialized = true;
+    } else {
+        ESP_LOGE(TAG, "spi_bus_initialize: %s", esp_err_to_name(err));
+    }
+
+    // DMA can't read PSRAM, so queued chunks are copied into internal RAM first
+    for (int i = 0; ok && i < queue_depth; i++) {
+        bounce[i] = (uint8_t *)heap_caps_malloc(chunk_size, MALLOC_CAP_DMA);
+        if (!bounce[i]) {
+            ESP_LOGE(TAG, "No DMA capable memory for the bounce buffers");
+            ok = false;
+        }
+    }
+
+    ok = ok && add_device();
+    if (ok) {
+        return;
+    }
+
+    release();
+    if (fallback) {
+        ESP_LOGW(TAG, "Falling back to the SPI transport");
+        use_fallback = true;
+        fallback->begin(_cs_pin, _dcs_pin, _dreq_pin);
+    }
+}
+
+void VS1053DmaTransport::setSpeed(uint32_t hz) {
+    if (use_fallback) {
+        fallback->setSpeed(hz);
+        return;
+    }
+    clock_hz = hz;
+    if (device) {
+        // The clock is fixed when the device is added, so add it again
+        wait_queued();
+        spi_bus_remove_device(device);
+        device = nullptr;
+        add_device();
+    }
+}
+
+void VS1053DmaTransport::setReset(bool asserted) {
+    if (use_fallback) {
+        fallback->setReset(asserted);
+        return;
+    }
+    // Low & Low will bring reset pin low
+    gpio_set_level(dcs_pin, asserted ? 0 : 1);
+    gpio_set_level(cs_pin, asserted ? 0 : 1);
+}
+
+bool VS1053DmaTransport::dreq() {
+    if (use_fallback) {
+        return fallback->dreq();
+    }
+    // No waiting here, so the next chunk can be got ready while the last one is on the wire
+    collect_finished();
+    return gpio_get_level(dreq_pin) == 1;
+}
+
+void VS1053DmaTransport::dreqPullUp() {
+    if (use_fallback) {
+        fallback->dreqPullUp();
+        return;
+    }
+    gpio_set_pull_mode(dreq_pin, GPIO_PULLUP_ONLY);
+}
+
+void VS1053DmaTransport::await_data_request() {
+    while (!gpio_get_level(dreq_pin)) {
+        taskYIELD();
+    }
+}
+
+uint16_t VS1053DmaTransport::sciRead(uint8_t reg) {
+    if (use_fallback) {
+        return fallback->sciRead(reg);
+    }
+    spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
+    t.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+    t.length = 32;
+    t.tx_data[0] = 3;   // Read operation
+    t.tx_data[1] = reg; // Register to read (0..0xF)
+    t.tx_data[2] = 0xFF;
+    t.tx_data[3] = 0xFF;
+
+    wait_queued(); // spi_device_transmit() mustn't run with queued SDI chunks outstanding
+    gpio_set_level(cs_pin, 0);
+    spi_device_transmit(device, &t);
+    await_data_request(); // Wait for DREQ to be HIGH again
+    gpio_set_level(cs_pin, 1);
+
+    return (t.rx_data[2] << 8) | t.rx_data[3];
+}
+
+void VS1053DmaTransport::sciWrite(uint8_t reg, uint16_t value) {
+    if (use_fallback) {
+        fallback->sciWrite(reg, value);
+        return;
+    }
+    spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
+    t.flags = SPI_TRANS_USE_TXDATA;
+    t.length = 32;
+    t.tx_data[0] = 2;   // Write operation
+    t.tx_data[1] = reg; // Register to write (0..0xF)
+    t.tx_data[2] = value >> 8;
+    t.tx_data[3] = value & 0xFF;
+
+    wait_queued();
+    gpio_set_level(cs_pin, 0);
+    spi_device_transmit(device, &t);
+    await_data_request();
+    gpio_set_level(cs_pin, 1);
+}
+
+void VS1053DmaTransport::sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count) {
+    if (use_fallback) {
+        fallback->sciReadBatch(regs, values, count);
+        return;
+    }
+    VS1053Transport::sciReadBatch(regs, values, count);
+}
+
+void VS1053DmaTransport::sciWriteBatch(const VS1053RegisterWrite *writes, size_t count) {
+    if (use_fallback) {
+        fallback->sciWriteBatch(writes, count);
+        return;
+    }
+    VS1053Transport::sciWriteBatch(writes, count);
+}
+
+void VS1053DmaTransport::sdiBegin() {
+    if (use_fallback) {
+        fallback->sdiBegin();
+        return;
+    }
+    gpio_set_level(cs_pin, 1); // Bring slave in data mode
+    gpio_set_level(dcs_pin, 0);
+}
+
+void VS1053DmaTransport::sdiWrite(const uint8_t *data, size_t len) {
+    if (use_fallback) {
+        fallback->sdiWrite(data, len);
+        return;
+    }
+    while (len) {
+        size_t chunk_length = len > chunk_size ? chunk_size : len;
+
+        // All slots busy? Wait for the oldest to finish
+        if (in_flight == queue_depth) {
+            spi_transaction_t *done;
+            spi_device_get_trans_result(device, &done, portMAX_DELAY);
+            in_flight--;
+        }
+
+        spi_transaction_t *t = &trans[next_slot];
+        memcpy(bounce[next_slot], data, chunk_length);
+        memset(t, 0, sizeof(*t));
+        t->length = chunk_length * 8;
+        t->tx_buffer = bounce[next_slot];
+        spi_device_queue_trans(device, t, portMAX_DELAY);
+        in_flight++;
+        next_slot = (next_slot + 1) % queue_depth;
+
+        data += chunk_length;
+        len -= chunk_length;
+    }
+}
+
+void VS1053DmaTransport::sdiEnd() {
+    if (use_fallback) {
+        fallback->sdiEnd();
+        return;
+    }
+    wait_queued();
+    gpio_set_level(dcs_pin, 1); // End data mode
+}
+
+void VS1053DmaTransport::collect_finished() {
+    spi_transaction_t *done;
+    while (in_flight && spi_device_get_trans_result(device, &done, 0) == ESP_OK) {
+        in_flight--;
+    }
+}
+
+void VS1053DmaTransport::wait_queued() {
+    while (in_flight) {
+        spi_transaction_t *done;
+        spi_device_get_trans_result(device, &done, portMAX_DELAY);
+        in_flight--;
+    }
+}
+
+#endif
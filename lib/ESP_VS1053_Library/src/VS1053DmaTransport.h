@@ -0,0 +1,93 @@
+/**
+ * VS1053 transport using ESP-IDF spi_master queued (DMA) transactions.
+ *
+ * SDI data is copied into small DMA capable bounce buffers (so the source
+ * can be anywhere, including PSRAM) and queued; sdiWrite() returns as soon
+ * as the chunk is queued so the caller can get the next one ready while the
+ * previous is clocked out, and the CPU is free while the transfer runs.
+ * dreq() just reads the pin (collecting whatever has finished on the way),
+ * it never waits: only a full queue or sdiEnd() waits for the transfers.
+ * The queue is two deep, so DREQ is never more than one chunk behind.
+ * SCI reads and writes wait for the queue to empty first, as the driver
+ * requires, but the transport isn't locked: one task must make all the
+ * calls, and not in the middle of an sdiBegin()/sdiEnd() pair.
+ *
+ * The spi_master driver takes over the whole SPI host, so the VS1053 needs
+ * its own bus (eg HSPI) - the Arduino SPI class and TFT_eSPI drive VSPI
+ * directly and must not share it. XCS/XDCS are driven as plain GPIOs.
+ *
+ * If the bus, the device or the bounce buffers can't be had, begin() gives
+ * back what it did get and hands everything to the fallback transport (if
+ * one was set) from then on.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef VS1053_DMA_TRANSPORT_H
+#define VS1053_DMA_TRANSPORT_H
+
+#ifdef ESP32
+
+#include <driver/gpio.h>
+#include <driver/spi_master.h>
+#include "VS1053Transport.h"
+
+class VS1053DmaTransport : public VS1053Transport {
+private:
+    static const int queue_depth = 2;       // Chunks queued at once
+    static const size_t chunk_size = 32;    // Most the VS1053 takes per DREQ
+
+    spi_host_device_t host;
+    int sck_pin;
+    int miso_pin;
+    int mosi_pin;
+    int dma_channel;
+    gpio_num_t cs_pin;
+    gpio_num_t dcs_pin;
+    gpio_num_t dreq_pin;
+    uint32_t clock_hz;
+    spi_device_handle_t device;
+    uint8_t *bounce[queue_depth];           // DMA capable copies of queued chunks
+    spi_transaction_t trans[queue_depth];
+    int next_slot;
+    int in_flight;
+    bool bus_initialized;
+    VS1053Transport *fallback;              // Used instead if DMA can't be set up
+    bool use_fallback;
+
+    bool add_device();
+    void release();                         // Give back the bus, device and buffers
+    void collect_finished();                // Collect queued transactions that are done, no waiting
+    void wait_queued();                     // Collect every queued transaction
+    void await_data_request();
+
+public:
+    VS1053DmaTransport(spi_host_device_t _host, int _sck_pin, int _miso_pin, int _mosi_pin, int _dma_channel = 1);
+
+    // Where to go if DMA can't be set up, call before begin(). It must drive the same pins.
+    void setFallback(VS1053Transport *_fallback) {
+        fallback = _fallback;
+    }
+
+    // Did begin() have to hand over to the fallback?
+    bool usingFallback() const {
+        return use_fallback;
+    }
+
+    void begin(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin) override;
+    void setSpeed(uint32_t hz) override;
+    void setReset(bool asserted) override;
+    bool dreq() override;
+    void dreqPullUp() override;
+    uint16_t sciRead(uint8_t reg) override;
+    void sciWrite(uint8_t reg, uint16_t value) override;
+    void sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count) override;
+    void sciWriteBatch(const VS1053RegisterWrite *writes, size_t count) override;
+    void sdiBegin() override;
+    void sdiWrite(const uint8_t *data, size_t len) override;
+    void sdiEnd() override;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * A register-level model of the VS1053, as a transport.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#include "VS1053Emulator.h"
+
+// The bits of the chip we need to know about (see the VS1053b datasheet)
+namespace {
+const uint8_t SCI_MODE = 0x0;
+const uint8_t SCI_STATUS = 0x1;
+const uint8_t SCI_CLOCKF = 0x3;
+const uint8_t SCI_DECODE_TIME = 0x4;
+const uint8_t SCI_AUDATA = 0x5;
+const uint8_t SCI_WRAM = 0x6;
+const uint8_t SCI_WRAMADDR = 0x7;
+const uint8_t SCI_HDAT0 = 0x8;
+const uint8_t SCI_HDAT1 = 0x9;
+const uint16_t SM_RESET = 1 << 2;
+const uint16_t SM_CANCEL = 1 << 3;
+const uint16_t SM_SDINEW = 1 << 11;
+const uint16_t SS_VER_VS1053 = 4 << 4;
+const uint16_t WRAM_BYTERATE = 0x1E05;
+const uint16_t WRAM_ENDFILLBYTE = 0x1E06;
+
+VS1053Emulator *clock_owner = nullptr;
+}
+
+#ifndef ARDUINO
+#include "VS1053HostShims.h"
+
+static void emulator_delay(uint32_t ms) {
+    if (clock_owner) {
+        clock_owner->advance((uint64_t)ms * 1000);
+    }
+}
+#endif
+
+VS1053Emulator::VS1053Emulator()
+        : bytesPerSecond(16000), pollMicros(1), sciBusyMicros(5), resetBusyMicros(1800), cancelAfterBytes(512),
+          xtaliHz(12288000), streamHdat0(0xE190), streamHdat1(0xFFFB), streamAudata(44101), sciReads(0),
+          sciWrites(0), softResets(0), hardResets(0), sdiBytes(0), playedBytes(0), fifoOverflows(0),
+          fifoUnderruns(0), speedViolations(0), wram_words(65536, 0), now(0), busy_until(0), speed_hz(200000),
+          in_reset(false), in_data(false), decoding(false) {
+    power_on_state();
+}
+
+void VS1053Emulator::attachClock() {
+    clock_owner = this;
+#ifndef ARDUINO
+    vs1053_delay_hook = emulator_delay;
+#endif
+}
+
+void VS1053Emulator::power_on_state() {
+    for (int i = 0; i < 16; i++) {
+        registers[i] = 0;
+    }
+    registers[SCI_MODE] = SM_SDINEW;
+    registers[SCI_STATUS] = SS_VER_VS1053;
+    wram_words[WRAM_BYTERATE] = 0;
+    wram_words[WRAM_ENDFILLBYTE] = 0;
+    wram_address = 0;
+    cancel_countdown = 0;
+    decode_base = playedBytes;
+    stream_ended();
+}
+
+// Nothing being decoded: FIFO empty, HDAT0/HDAT1 zero
+void VS1053Emulator::stream_ended() {
+    fifo_level = 0;
+    drain_remainder = 0;
+    decoding = false;
+    registers[SCI_HDAT0] = 0;
+    registers[SCI_HDAT1] = 0;
+}
+
+void VS1053Emulator::advance(uint64_t micros) {
+    now += micros;
+    if (!fifo_level || in_reset || !bytesPerSecond) {
+        return;
+    }
+
+    uint64_t byte_micros = micros * bytesPerSecond + drain_remainder;
+    uint64_t played = byte_micros / 1000000;
+    drain_remainder = byte_micros % 1000000;
+    if (played >= fifo_level) {
+        played = fifo_level;
+        drain_remainder = 0;
+        fifoUnderruns++;
+    }
+    fifo_level -= played;
+    playedBytes += played;
+
+    // What the decoder reports back while it plays
+    if (decoding) {
+        registers[SCI_HDAT0] = streamHdat0;
+        registers[SCI_HDAT1] = streamHdat1;
+        registers[SCI_AUDATA] = streamAudata;
+    }
+    registers[SCI_DECODE_TIME] = (uint16_t)((playedBytes - decode_base) / bytesPerSecond);
+    wram_words[WRAM_BYTERATE] = (uint16_t)bytesPerSecond;
+}
+
+void VS1053Emulator::busy_for(uint32_t micros) {
+    if (now + micros > busy_until) {
+        busy_until = now + micros;
+    }
+}
+
+// Every transport holds XCS until DREQ comes back after an SCI command, so that time passes here
+void VS1053Emulator::wait_not_busy() {
+    while (now < busy_until) {
+        advance(pollMicros ? pollMicros : busy_until - now);
+    }
+}
+
+// SCI reads are good to CLKI/7, everything else to CLKI/4 (CLKI = XTALI x the CLOCKF multiplier)
+uint32_t VS1053Emulator::max_sci_read_hz() const {
+    uint32_t multiplier_x2 = 2 + (registers[SCI_CLOCKF] >> 13); // SC_MULT: 1.0, 2.0, 2.5 .. 5.0
+    if (multiplier_x2 > 2) {
+        multiplier_x2++;
+    }
+    return (uint32_t)((uint64_t)xtaliHz * multiplier_x2 / 2 / 7);
+}
+
+void VS1053Emulator::transfer(size_t bytes, bool sci) {
+    uint32_t limit = sci ? max_sci_read_hz() : max_sci_read_hz() * 7 / 4;
+    if (speed_hz > limit) {
+        speedViolations++;
+    }
+    advance(speed_hz ? (uint64_t)bytes * 8 * 1000000 / speed_hz : 0);
+}
+
+void VS1053Emulator::begin(uint8_t, uint8_t, uint8_t) {
+    in_reset = false;
+    in_data = false;
+}
+
+void VS1053Emulator::setSpeed(uint32_t hz) {
+    speed_hz = hz;
+}
+
+void VS1053Emulator::setReset(bool asserted) {
+    if (asserted && !in_reset) {
+        hardResets++;
+        power_on_state();
+    } else if (!asserted && in_reset) {
+        busy_for(resetBusyMicros);
+    }
+    in_reset = asserted;
+}
+
+bool VS1053Emulator::dreq() {
+    advance(pollMicros);
+    if (in_reset || now < busy_until) {
+        return false;
+    }
+    return fifo_size - fifo_level >= 32;
+}
+
+uint16_t VS1053Emulator::sciRead(uint8_t reg) {
+    sciReads++;
+    transfer(4, true);
+    busy_for(sciBusyMicros);
+    wait_not_busy();
+    reg &= 0x0F;
+    if (reg == SCI_WRAM) {
+        return wram_words[wram_address++];
+    }
+    return registers[reg];
+}
+
+void VS1053Emulator::sciWrite(uint8_t reg, uint16_t value) {
+    sciWrites++;
+    transfer(4, true);
+    busy_for(sciBusyMicros);
+    reg &= 0x0F;
+
+    switch (reg) {
+        case SCI_MODE:
+            if (value & SM_RESET) {
+                // Soft reset: decoder state and FIFO gone, the mode itself survives
+                softResets++;
+                stream_ended();
+                cancel_countdown = 0;
+                decode_base = playedBytes;
+                value &= ~(SM_RESET | SM_CANCEL);
+                busy_for(resetBusyMicros);
+            } else if ((value & SM_CANCEL) && !(registers[SCI_MODE] & SM_CANCEL)) {
+                cancel_countdown = cancelAfterBytes;
+            }
+            registers[SCI_MODE] = value;
+            break;
+        case SCI_DECODE_TIME:
+            decode_base = playedBytes; // Only ever zeroed in practice
+            registers[reg] = value;
+            break;
+        case SCI_WRAMADDR:
+            wram_address = value;
+            registers[reg] = value;
+            break;
+        case SCI_WRAM:
+            wram_words[wram_address++] = value;
+            break;
+        case SCI_STATUS:
+            registers[reg] = (value & ~0x00F0) | SS_VER_VS1053; // Version is read only
+            break;
+        default:
+            registers[reg] = value;
+            break;
+    }
+    wait_not_busy();
+}
+
+void VS1053Emulator::sdiBegin() {
+    in_data = true;
+}
+
+void VS1053Emulator::sdiWrite(const uint8_t *data, size_t len) {
+    transfer(len, false);
+
+    // End fill bytes on their own don't start a decoder
+    for (size_t i = 0; i < len && !decoding; i++) {
+        decoding = data[i] != (wram_words[WRAM_ENDFILLBYTE] & 0xFF);
+    }
+
+    size_t room = fifo_size - fifo_level;
+    if (len > room) {
+        fifoOverflows++;
+        len = room;
+    }
+    fifo_level += len;
+    sdiBytes += len;
+
+    // The decoder notices SM_CANCEL somewhere in the next lot of data
+    if (cancel_countdown) {
+        cancel_countdown = len >= cancel_countdown ? 0 : cancel_countdown - len;
+        if (!cancel_countdown) {
+            registers[SCI_MODE] &= ~SM_CANCEL;
+            stream_ended();
+        }
+    }
+}
+
+void VS1053Emulator::sdiEnd() {
+    in_data = false;
+}
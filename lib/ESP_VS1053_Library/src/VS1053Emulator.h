@@ -0,0 +1,112 @@
+/**
+ * A register-level model of the VS1053, as a transport, so the driver can be
+ * run (and timed) on a host.
+ *
+ * What is modelled:
+ *  - the SCI register file, with SCI_WRAMADDR/SCI_WRAM giving access to a
+ *    64K word WRAM that auto-increments like the real thing
+ *  - a 2048 byte SDI FIFO that the "decoder" empties at a configurable byte
+ *    rate; DREQ is high while there is room for 32 bytes and the chip is
+ *    not busy with an SCI command, a reset or a soft reset
+ *  - SM_RESET (soft reset) and SM_CANCEL (cleared after a further N bytes)
+ *  - the SPI clock: transfers take the time they would on the wire, and
+ *    clocking SCI faster than CLOCKF allows is counted as a violation
+ *
+ * Time is virtual. It moves on with every transfer, every DREQ poll and
+ * every delay() the driver makes (call attachClock() so the host delay()
+ * lands here), so the multi-second begin() sequence finishes instantly
+ * while micros() reports what it would have taken on the chip.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef VS1053_EMULATOR_H
+#define VS1053_EMULATOR_H
+
+#include <vector>
+#include "VS1053Transport.h"
+
+class VS1053Emulator : public VS1053Transport {
+public:
+    static const size_t fifo_size = 2048;
+
+    // Knobs, all in virtual microseconds unless named otherwise
+    uint32_t bytesPerSecond;        // Decoder consumption rate (128kbit/s MP3 is 16000)
+    uint32_t pollMicros;            // Cost of one DREQ poll
+    uint32_t sciBusyMicros;         // DREQ low after an SCI command (the transport waits it out)
+    uint32_t resetBusyMicros;       // DREQ low after hardware or soft reset
+    uint32_t cancelAfterBytes;      // SDI bytes before SM_CANCEL clears itself
+    uint32_t xtaliHz;               // Crystal, the SPI limits follow from it and CLOCKF
+    uint16_t streamHdat0;           // What HDAT0/HDAT1/AUDATA show once decoding starts
+    uint16_t streamHdat1;           // (default: 128kbit/s 44.1kHz stereo MP3)
+    uint16_t streamAudata;
+
+    // What happened
+    uint32_t sciReads;
+    uint32_t sciWrites;
+    uint32_t softResets;
+    uint32_t hardResets;
+    uint64_t sdiBytes;              // Accepted into the FIFO
+    uint64_t playedBytes;           // Taken out of the FIFO by the decoder
+    uint32_t fifoOverflows;         // Writes that did not fit (data lost)
+    uint32_t fifoUnderruns;         // Times the FIFO ran dry after being fed
+    uint32_t speedViolations;       // Transfers clocked faster than the chip allows
+
+    VS1053Emulator();
+
+    // Route the host delay() to this emulator's clock (one emulator at a time)
+    void attachClock();
+
+    // Move virtual time on, playing out the FIFO as it goes
+    void advance(uint64_t micros);
+    uint64_t micros() const {
+        return now;
+    }
+
+    size_t fifoLevel() const {
+        return fifo_level;
+    }
+    uint16_t reg(uint8_t reg) const {
+        return registers[reg & 0x0F];
+    }
+    uint16_t wram(uint16_t address) const {
+        return wram_words[address];
+    }
+    void setWram(uint16_t address, uint16_t value) {
+        wram_words[address] = value;
+    }
+
+    void begin(uint8_t cs_pin, uint8_t dcs_pin, uint8_t dreq_pin) override;
+    void setSpeed(uint32_t hz) override;
+    void setReset(bool asserted) override;
+    bool dreq() override;
+    uint16_t sciRead(uint8_t reg) override;
+    void sciWrite(uint8_t reg, uint16_t value) override;
+    void sdiBegin() override;
+    void sdiWrite(const uint8_t *data, size_t len) override;
+    void sdiEnd() override;
+
+private:
+    uint16_t registers[16];
+    std::vector<uint16_t> wram_words;
+    uint16_t wram_address;
+    size_t fifo_level;
+    uint64_t now;
+    uint64_t busy_until;
+    uint64_t drain_remainder;       // Byte-microseconds not yet a whole byte
+    uint64_t decode_base;           // playedBytes when DECODE_TIME was last zeroed
+    uint32_t speed_hz;
+    uint32_t cancel_countdown;
+    bool in_reset;
+    bool in_data;
+    bool decoding;                  // Seen something other than endFillByte since the last stream ended
+
+    void power_on_state();
+    void stream_ended();
+    void transfer(size_t bytes, bool sci);
+    void busy_for(uint32_t micros);
+    void wait_not_busy();
+    uint32_t max_sci_read_hz() const;
+};
+
+#endif
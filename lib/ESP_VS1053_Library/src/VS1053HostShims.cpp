@@ -0,0 +1,25 @@
+/**
+ * The few Arduino things the VS1053 driver uses, for building it on a host.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef ARDUINO
+
+#include <chrono>
+#include <thread>
+#include "VS1053HostShims.h"
+
+void (*vs1053_delay_hook)(uint32_t ms) = nullptr;
+
+VS1053HostLog Log;
+
+void delay(uint32_t ms) {
+    if (vs1053_delay_hook) {
+        vs1053_delay_hook(ms);
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * The few Arduino things the VS1053 driver uses, for building it on a host
+ * (Linux/macOS) against VS1053Emulator or VS1053MockTransport.
+ *
+ * delay() does not sleep: it goes to vs1053_delay_hook, which the emulator
+ * points at its own clock, so a multi-second init sequence runs (and can be
+ * timed) in virtual time. With no hook it does really sleep.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef VS1053_HOST_SHIMS_H
+#define VS1053_HOST_SHIMS_H
+
+#ifndef ARDUINO
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef CR
+#define CR "\n"
+#endif
+
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+extern void (*vs1053_delay_hook)(uint32_t ms);
+
+void delay(uint32_t ms);
+
+inline void yield() {
+}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// Just enough of ArduinoLog: printf to stdout, or nothing when quiet
+class VS1053HostLog {
+public:
+    bool quiet = false;
+
+    void notice(const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        print(format, args);
+        va_end(args);
+    }
+
+    void error(const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        print(format, args);
+        va_end(args);
+    }
+
+private:
+    void print(const char *format, va_list args) {
+        if (!quiet) {
+            vprintf(format, args);
+        }
+    }
+};
+
+extern VS1053HostLog Log;
+
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * A VS1053 transport with no chip behind it.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#include <string.h>
+#include "VS1053MockTransport.h"
+
+VS1053MockTransport::VS1053MockTransport()
+        : dreqLevel(true), inReset(false), inData(false), speedHz(0), sciReads(0), sciWrites(0),
+          sdiTransactions(0), sdiBytes(0), handler(nullptr), handlerCtx(nullptr) {
+    memset(registers, 0, sizeof(registers));
+}
+
+void VS1053MockTransport::onData(dataHandler _handler, void *ctx) {
+    handler = _handler;
+    handlerCtx = ctx;
+}
+
+void VS1053MockTransport::begin(uint8_t, uint8_t, uint8_t) {
+    inReset = false;
+    inData = false;
+}
+
+void VS1053MockTransport::setSpeed(uint32_t hz) {
+    speedHz = hz;
+}
+
+void VS1053MockTransport::setReset(bool asserted) {
+    inReset = asserted;
+}
+
+bool VS1053MockTransport::dreq() {
+    return dreqLevel;
+}
+
+uint16_t VS1053MockTransport::sciRead(uint8_t reg) {
+    sciReads++;
+    return registers[reg & 0x0F];
+}
+
+void VS1053MockTransport::sciWrite(uint8_t reg, uint16_t value) {
+    sciWrites++;
+    registers[reg & 0x0F] = value;
+}
+
+void VS1053MockTransport::sdiBegin() {
+    inData = true;
+    sdiTransactions++;
+}
+
+void VS1053MockTransport::sdiWrite(const uint8_t *data, size_t len) {
+    sdiBytes += len;
+    if (handler) {
+        handler(data, len, handlerCtx);
+    }
+}
+
+void VS1053MockTransport::sdiEnd() {
+    inData = false;
+}
@@ -0,0 +1,49 @@
+/**
+ * A VS1053 transport with no chip behind it. SCI writes land in a register
+ * file that reads return, SDI bytes are counted (and optionally handed to a
+ * callback) and DREQ is whatever the test says it is. Plain C++, so the
+ * driver and its callers can be exercised on a host.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef VS1053_MOCK_TRANSPORT_H
+#define VS1053_MOCK_TRANSPORT_H
+
+#include "VS1053Transport.h"
+
+class VS1053MockTransport : public VS1053Transport {
+public:
+    typedef void (*dataHandler)(const uint8_t *data, size_t len, void *ctx);
+
+    uint16_t registers[16];     // Last value written to each SCI register
+    bool dreqLevel;             // What dreq() reports
+    bool inReset;               // XCS and XDCS held low together
+    bool inData;                // Between sdiBegin() and sdiEnd()
+    uint32_t speedHz;
+    uint32_t sciReads;
+    uint32_t sciWrites;
+    uint32_t sdiTransactions;
+    uint32_t sdiBytes;
+
+    VS1053MockTransport();
+
+    // Called with every SDI write
+    void onData(dataHandler handler, void *ctx);
+
+    void begin(uint8_t cs_pin, uint8_t dcs_pin, uint8_t dreq_pin) override;
+    void setSpeed(uint32_t hz) override;
+    void setReset(bool asserted) override;
+    bool dreq() override;
+    uint16_t sciRead(uint8_t reg) override;
+    void sciWrite(uint8_t reg, uint16_t value) override;
+    void sdiBegin() override;
+    void sdiWrite(const uint8_t *data, size_t len) override;
+    void sdiEnd() override;
+
+private:
+    dataHandler handler;
+    void *handlerCtx;
+};
+
+#endif
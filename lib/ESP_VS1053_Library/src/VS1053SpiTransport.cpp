@@ -0,0 +1,115 @@
+/**
+ * VS1053 transport over the Arduino SPI class.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifdef ARDUINO
+
+#include "VS1053SpiTransport.h"
+
+VS1053SpiTransport::VS1053SpiTransport()
+        : cs_pin(0), dcs_pin(0), dreq_pin(0), VS1053_SPI(200000, MSBFIRST, SPI_MODE0), spi(&SPI), sck_pin(-1),
+          miso_pin(-1), mosi_pin(-1) {
+}
+
+VS1053SpiTransport::VS1053SpiTransport(SPIClass &_spi, int8_t _sck_pin, int8_t _miso_pin, int8_t _mosi_pin)
+        : cs_pin(0), dcs_pin(0), dreq_pin(0), VS1053_SPI(200000, MSBFIRST, SPI_MODE0), spi(&_spi), sck_pin(_sck_pin),
+          miso_pin(_miso_pin), mosi_pin(_mosi_pin) {
+}
+
+void VS1053SpiTransport::begin(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin) {
+    cs_pin = _cs_pin;
+    dcs_pin = _dcs_pin;
+    dreq_pin = _dreq_pin;
+    pinMode(dreq_pin, INPUT); // DREQ is an input
+    pinMode(cs_pin, OUTPUT);  // The SCI and SDI signals
+    pinMode(dcs_pin, OUTPUT);
+    digitalWrite(dcs_pin, HIGH); // Start HIGH for SCI en SDI
+    digitalWrite(cs_pin, HIGH);
+    if (sck_pin >= 0) {
+        spi->begin(sck_pin, miso_pin, mosi_pin);
+    }
+}
+
+void VS1053SpiTransport::setSpeed(uint32_t hz) {
+    VS1053_SPI = SPISettings(hz, MSBFIRST, SPI_MODE0);
+}
+
+void VS1053SpiTransport::setReset(bool asserted) {
+    // Low & Low will bring reset pin low
+    digitalWrite(dcs_pin, asserted ? LOW : HIGH);
+    digitalWrite(cs_pin, asserted ? LOW : HIGH);
+}
+
+void VS1053SpiTransport::dreqPullUp() {
+    pinMode(dreq_pin, INPUT_PULLUP); // DREQ is now input with pull-up
+}
+
+uint16_t VS1053SpiTransport::sciRead(uint8_t reg) {
+    uint16_t result;
+
+    control_mode_on();
+    spi->write(3);   // Read operation
+    spi->write(reg); // Register to write (0..0xF)
+    // Note: transfer16 does not seem to work
+    result = (spi->transfer(0xFF) << 8) | // Read 16 bits data
+             (spi->transfer(0xFF));
+    await_data_request(); // Wait for DREQ to be HIGH again
+    control_mode_off();
+    return result;
+}
+
+void VS1053SpiTransport::sciWrite(uint8_t reg, uint16_t value) {
+    control_mode_on();
+    spi->write(2);       // Write operation
+    spi->write(reg);     // Register to write (0..0xF)
+    spi->write16(value); // Send 16 bits data
+    await_data_request();
+    control_mode_off();
+}
+
+void VS1053SpiTransport::sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count) {
+    spi->beginTransaction(VS1053_SPI); // One transaction, XCS still goes high after each command
+    digitalWrite(dcs_pin, HIGH);
+    for (size_t i = 0; i < count; i++) {
+        digitalWrite(cs_pin, LOW);
+        spi->write(3);
+        spi->write(regs[i]);
+        values[i] = (spi->transfer(0xFF) << 8) | (spi->transfer(0xFF));
+        await_data_request();
+        digitalWrite(cs_pin, HIGH);
+    }
+    spi->endTransaction();
+}
+
+void VS1053SpiTransport::sciWriteBatch(const VS1053RegisterWrite *writes, size_t count) {
+    spi->beginTransaction(VS1053_SPI); // One transaction, XCS still goes high after each command
+    digitalWrite(dcs_pin, HIGH);
+    for (size_t i = 0; i < count; i++) {
+        digitalWrite(cs_pin, LOW);
+        spi->write(2);
+        spi->write(writes[i].reg);
+        spi->write16(writes[i].value);
+        await_data_request();
+        digitalWrite(cs_pin, HIGH);
+    }
+    spi->endTransaction();
+}
+
+void VS1053SpiTransport::sdiBegin() {
+    spi->beginTransaction(VS1053_SPI); // Prevent other SPI users
+    digitalWrite(cs_pin, HIGH);        // Bring slave in data mode
+    digitalWrite(dcs_pin, LOW);
+}
+
+void VS1053SpiTransport::sdiWrite(const uint8_t *data, size_t len) {
+    spi->writeBytes(data, len);
+}
+
+void VS1053SpiTransport::sdiEnd() {
+    digitalWrite(dcs_pin, HIGH); // End data mode
+    spi->endTransaction();       // Allow other SPI users
+}
+
+#endif
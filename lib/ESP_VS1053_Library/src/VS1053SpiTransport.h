@@ -0,0 +1,69 @@
+/**
+ * VS1053 transport over the Arduino SPI class, one byte at a time from the CPU.
+ * This is the original (and default) way the driver talks to the chip, on the
+ * global SPI object. Given another SPIClass and its pins it begins that bus
+ * itself, so it can also stand in for VS1053DmaTransport on a bus of its own.
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef VS1053_SPI_TRANSPORT_H
+#define VS1053_SPI_TRANSPORT_H
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "VS1053Transport.h"
+
+class VS1053SpiTransport : public VS1053Transport {
+private:
+    uint8_t cs_pin;                         // Pin where CS line is connected
+    uint8_t dcs_pin;                        // Pin where DCS line is connected
+    uint8_t dreq_pin;                       // Pin where DREQ line is connected
+    SPISettings VS1053_SPI;                 // SPI settings for this slave
+    SPIClass *spi;                          // The bus the chip is on
+    int8_t sck_pin;                         // Its pins, -1 if someone else begins it
+    int8_t miso_pin;
+    int8_t mosi_pin;
+
+    inline void await_data_request() const {
+        while (!digitalRead(dreq_pin)) {
+            yield();                        // Very short delay
+        }
+    }
+
+    inline void control_mode_on() const {
+        spi->beginTransaction(VS1053_SPI);  // Prevent other SPI users
+        digitalWrite(dcs_pin, HIGH);        // Bring slave in control mode
+        digitalWrite(cs_pin, LOW);
+    }
+
+    inline void control_mode_off() const {
+        digitalWrite(cs_pin, HIGH);         // End control mode
+        spi->endTransaction();              // Allow other SPI users
+    }
+
+public:
+    VS1053SpiTransport();
+    VS1053SpiTransport(SPIClass &_spi, int8_t _sck_pin, int8_t _miso_pin, int8_t _mosi_pin);
+
+    void begin(uint8_t _cs_pin, uint8_t _dcs_pin, uint8_t _dreq_pin) override;
+    void setSpeed(uint32_t hz) override;
+    void setReset(bool asserted) override;
+    bool dreq() override {
+        return digitalRead(dreq_pin) == HIGH;
+    }
+    void dreqPullUp() override;
+    uint16_t sciRead(uint8_t reg) override;
+    void sciWrite(uint8_t reg, uint16_t value) override;
+    void sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count) override;
+    void sciWriteBatch(const VS1053RegisterWrite *writes, size_t count) override;
+    void sdiBegin() override;
+    void sdiWrite(const uint8_t *data, size_t len) override;
+    void sdiEnd() override;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * How the VS1053 driver talks to the chip.
+ *
+ * The driver only ever needs a handful of bus operations: SCI register reads
+ * and writes (XCS), SDI data writes (XDCS), the state of DREQ and the
+ * module reset trick (XCS and XDCS low together). Putting them behind this
+ * interface lets the same driver run over:
+ *
+ *  - VS1053SpiTransport   the Arduino SPI class (the original code path)
+ *  - VS1053DmaTransport   ESP-IDF spi_master queued DMA transactions (ESP32)
+ *  - VS1053MockTransport  a host-side fake that records what was sent
+ *  - VS1053Emulator       a host-side model of the chip: registers, WRAM, FIFO and DREQ
+ *
+ * Licensed under GNU GPLv3 <http://gplv3.fsf.org/>
+ */
+
+#ifndef VS1053_TRANSPORT_H
+#define VS1053_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One SCI register write, for batches
+struct VS1053RegisterWrite {
+    uint8_t reg;
+    uint16_t value;
+};
+
+class VS1053Transport {
+public:
+    virtual ~VS1053Transport() {}
+
+    // Set the pins up, chip selects inactive
+    virtual void begin(uint8_t cs_pin, uint8_t dcs_pin, uint8_t dreq_pin) = 0;
+
+    // SPI clock for both SCI and SDI
+    virtual void setSpeed(uint32_t hz) = 0;
+
+    // Pull XCS and XDCS low together (resets most VS1053 modules), or release them
+    virtual void setReset(bool asserted) = 0;
+
+    // DREQ high: the chip can take another SCI command or 32 bytes of SDI data
+    virtual bool dreq() = 0;
+
+    // No VS1053 fitted: stop DREQ floating so nothing waits on it forever
+    virtual void dreqPullUp() {}
+
+    // SCI register access, each one waits for DREQ before releasing XCS
+    virtual uint16_t sciRead(uint8_t reg) = 0;
+    virtual void sciWrite(uint8_t reg, uint16_t value) = 0;
+
+    // Several SCI reads in one go, same idea
+    virtual void sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = sciRead(regs[i]);
+        }
+    }
+
+    // Several SCI writes in one go. Transports that can hold the bus across them override this.
+    virtual void sciWriteBatch(const VS1053RegisterWrite *writes, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            sciWrite(writes[i].reg, writes[i].value);
+        }
+    }
+
+    // SDI data: sdiBegin() claims the bus and selects XDCS, sdiWrite() sends (or queues)
+    // up to 32 bytes and sdiEnd() waits for anything queued and releases the bus.
+    virtual void sdiBegin() = 0;
+    virtual void sdiWrite(const uint8_t *data, size_t len) = 0;
+    virtual void sdiEnd() = 0;
+};
+
+#endif
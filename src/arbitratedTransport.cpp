@@ -0,0 +1,88 @@
+#include "arbitratedTransport.h"
+
+ArbitratedTransport::ArbitratedTransport(SpiBusArbiter &arbiter)
+	: arbiter(arbiter), inner(nullptr)
+{
+}
+
+void ArbitratedTransport::wrap(VS1053Transport *inner)
+{
+	this->inner = inner;
+}
+
+void ArbitratedTransport::begin(uint8_t cs_pin, uint8_t dcs_pin, uint8_t dreq_pin)
+{
+	inner->begin(cs_pin, dcs_pin, dreq_pin);
+}
+
+void ArbitratedTransport::setSpeed(uint32_t hz)
+{
+	inner->setSpeed(hz);
+}
+
+void ArbitratedTransport::setReset(bool asserted)
+{
+	// XCS and XDCS low together would look like a transfer to anyone else on the bus
+	if (asserted)
+	{
+		arbiter.acquire(kBusAudio);
+		inner->setReset(true);
+	}
+	else
+	{
+		inner->setReset(false);
+		arbiter.release(kBusAudio);
+	}
+}
+
+bool ArbitratedTransport::dreq()
+{
+	return inner->dreq();
+}
+
+void ArbitratedTransport::dreqPullUp()
+{
+	inner->dreqPullUp();
+}
+
+uint16_t ArbitratedTransport::sciRead(uint8_t reg)
+{
+	SpiBusClaim claim(arbiter, kBusAudio);
+	return inner->sciRead(reg);
+}
+
+void ArbitratedTransport::sciWrite(uint8_t reg, uint16_t value)
+{
+	SpiBusClaim claim(arbiter, kBusAudio);
+	inner->sciWrite(reg, value);
+}
+
+void ArbitratedTransport::sciReadBatch(const uint8_t *regs, uint16_t *values, size_t count)
+{
+	SpiBusClaim claim(arbiter, kBusAudio);
+	inner->sciReadBatch(regs, values, count);
+}
+
+void ArbitratedTransport::sciWriteBatch(const VS1053RegisterWrite *writes, size_t count)
+{
+	// The whole batch on one claim
+	SpiBusClaim claim(arbiter, kBusAudio);
+	inner->sciWriteBatch(writes, count);
+}
+
+void ArbitratedTransport::sdiBegin()
+{
+	arbiter.acquire(kBusAudio);
+	inner->sdiBegin();
+}
+
+void ArbitratedTransport::sdiWrite(const uint8_t *data, size_t len)
+{
+	inner->sdiWrite(data, len);
+}
+
+void ArbitratedTransport::sdiEnd()
+{
+	inner->sdiEnd();
+	arbiter.release(kBusAudio);
+}
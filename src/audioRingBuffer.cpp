@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+#include "audioRingBuffer.h"
+
+AudioRingBuffer::AudioRingBuffer()
+	: buffer(nullptr), size(0), head(0), tail(0), peekedTail(0), writtenTotal(0), readTotal(0)
+{
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+	free(buffer);
+}
+
+bool AudioRingBuffer::begin(size_t capacity)
+{
+	free(buffer);
+	buffer = nullptr;
+	size = 0;
+	head.store(0);
+	tail.store(0);
+	peekedTail = 0;
+
+	if (capacity == 0)
+	{
+		return false;
+	}
+
+	// Prefer PSRAM, it's far too big for internal SRAM on most boards
+#ifdef ESP_PLATFORM
+	buffer = static_cast<uint8_t *>(heap_caps_malloc(capacity + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+#endif
+	if (!buffer)
+	{
+		buffer = static_cast<uint8_t *>(malloc(capacity + 1));
+	}
+	if (!buffer)
+	{
+		return false;
+	}
+
+	size = capacity + 1;
+	return true;
+}
+
+size_t AudioRingBuffer::available() const
+{
+	size_t h = head.load(std::memory_order_acquire);
+	size_t t = tail.load(std::memory_order_acquire);
+	return h >= t ? h - t : size - t + h;
+}
+
+size_t AudioRingBuffer::room() const
+{
+	return size ? capacity() - available() : 0;
+}
+
+void AudioRingBuffer::flush()
+{
+	// Move the read position up to the write position. If the consumer is part way
+	// through a peek()/consume() its consume() will notice and be ignored.
+	tail.store(head.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+AudioRingBuffer::Span AudioRingBuffer::reserve(size_t maxLen)
+{
+	Span span = {nullptr, 0};
+	if (!size)
+	{
+		return span;
+	}
+
+	size_t h = head.load(std::memory_order_relaxed);
+	size_t t = tail.load(std::memory_order_acquire);
+
+	// Free space runs to the end of the storage, or to just before the read position
+	size_t len;
+	if (h >= t)
+	{
+		len = size - h;
+		if (t == 0)
+		{
+			len--;
+		}
+	}
+	else
+	{
+		len = t - h - 1;
+	}
+
+	span.data = buffer + h;
+	span.len = len < maxLen ? len : maxLen;
+	return span;
+}
+
+void AudioRingBuffer::commit(size_t len)
+{
+	size_t h = head.load(std::memory_order_relaxed) + len;
+	if (h >= size)
+	{
+		h -= size;
+	}
+
+	// Release: the bytes written into the span are visible before the new position is
+	head.store(h, std::memory_order_release);
+	writtenTotal.fetch_add(len, std::memory_order_relaxed);
+}
+
+size_t AudioRingBuffer::write(const uint8_t *data, size_t len)
+{
+	size_t written = 0;
+
+	// At most two spans, either side of the wrap
+	while (written < len)
+	{
+		Span span = reserve(len - written);
+		if (!span.len)
+		{
+			break;
+		}
+		memcpy(span.data, data + written, span.len);
+		commit(span.len);
+		written += span.len;
+	}
+
+	return written;
+}
+
+AudioRingBuffer::Span AudioRingBuffer::peek(size_t maxLen)
+{
+	Span span = {nullptr, 0};
+	if (!size)
+	{
+		return span;
+	}
+
+	size_t t = tail.load(std::memory_order_acquire);
+	size_t h = head.load(std::memory_order_acquire);
+	peekedTail = t;
+
+	size_t len = h >= t ? h - t : size - t;
+
+	span.data = buffer + t;
+	span.len = len < maxLen ? len : maxLen;
+	return span;
+}
+
+void AudioRingBuffer::consume(size_t len)
+{
+	size_t t = peekedTail + len;
+	if (t >= size)
+	{
+		t -= size;
+	}
+
+	// If flush() moved the read position since our peek() leave it where flush() put it
+	size_t expected = peekedTail;
+	if (tail.compare_exchange_strong(expected, t, std::memory_order_release, std::memory_order_relaxed))
+	{
+		peekedTail = t;
+		readTotal.fetch_add(len, std::memory_order_relaxed);
+	}
+	else
+	{
+		peekedTail = expected;
+	}
+}
+
+size_t AudioRingBuffer::read(uint8_t *data, size_t len)
+{
+	size_t copied = 0;
+
+	while (copied < len)
+	{
+		Span span = peek(len - copied);
+		if (!span.len)
+		{
+			break;
+		}
+		memcpy(data + copied, span.data, span.len);
+		consume(span.len);
+		copied += span.len;
+	}
+
+	return copied;
+}
@@ -0,0 +1,166 @@
+#include "audioSink.h"
+#include "audioRingBuffer.h"
+#include "taskPort.h"
+
+size_t feedFromRing(AudioRingBuffer &ring, AudioSink &sink, size_t minBytes)
+{
+	if (ring.available() < minBytes || !sink.ready())
+	{
+		return 0;
+	}
+
+	size_t sent = 0;
+
+	sink.beginBurst();
+	do
+	{
+		// Point at (up to) a chunk of data in the ring buffer, no copying. It's
+		// shorter than a chunk only where the data wraps round the end of the buffer.
+		AudioRingBuffer::Span chunk = ring.peek(sink.chunkSize());
+		if (chunk.len == 0)
+		{
+			break;
+		}
+
+		// Release what the sink took back to the producer
+		size_t taken = sink.write(chunk.data, chunk.len);
+		ring.consume(taken);
+		sent += taken;
+		if (taken < chunk.len)
+		{
+			break;
+		}
+	} while (sink.ready());
+	sink.endBurst();
+
+	return sent;
+}
+
+RateLimitedSink::RateLimitedSink(uint32_t bytesPerSecond, size_t fifoBytes)
+	: bytesPerSecond(bytesPerSecond), fifoBytes(fifoBytes), fifoLevel(0), lastDrainMicros(monotonicMicros()),
+	  drainRemainder(0), totalWritten(0), currentVolume(100)
+{
+}
+
+void RateLimitedSink::setRate(uint32_t bytesPerSecond)
+{
+	drain();
+	this->bytesPerSecond = bytesPerSecond;
+}
+
+// Play out whatever the decoder would have played since we last looked
+void RateLimitedSink::drain()
+{
+	uint64_t now = monotonicMicros();
+	uint64_t elapsed = now - lastDrainMicros;
+	lastDrainMicros = now;
+
+	if (!bytesPerSecond)
+	{
+		fifoLevel = 0;
+		return;
+	}
+
+	uint64_t byteMicros = elapsed * bytesPerSecond + drainRemainder;
+	uint64_t played = byteMicros / 1000000;
+	drainRemainder = byteMicros % 1000000;
+	if (played >= fifoLevel)
+	{
+		// Ran dry, the decoder doesn't bank the time it sat idle
+		fifoLevel = 0;
+		drainRemainder = 0;
+	}
+	else
+	{
+		fifoLevel -= played;
+	}
+}
+
+bool RateLimitedSink::ready()
+{
+	drain();
+	return fifoBytes - fifoLevel >= chunkSize();
+}
+
+size_t RateLimitedSink::write(const uint8_t *data, size_t len)
+{
+	drain();
+
+	size_t room = fifoBytes - fifoLevel;
+	if (len > room)
+	{
+		len = room;
+	}
+	if (len > chunkSize())
+	{
+		len = chunkSize();
+	}
+
+	consume(data, len);
+	if (bytesPerSecond)
+	{
+		fifoLevel += len;
+	}
+	totalWritten += len;
+	return len;
+}
+
+void RateLimitedSink::setVolume(uint8_t volume)
+{
+	currentVolume = volume > 100 ? 100 : volume;
+}
+
+void RateLimitedSink::flush()
+{
+	fifoLevel = 0;
+	drainRemainder = 0;
+}
+
+void RateLimitedSink::consume(const uint8_t *data, size_t len)
+{
+	(void)data;
+	(void)len;
+}
+
+FileSink::FileSink(uint32_t bytesPerSecond)
+	: RateLimitedSink(bytesPerSecond), file(nullptr)
+{
+}
+
+FileSink::~FileSink()
+{
+	close();
+}
+
+bool FileSink::open(const char *path)
+{
+	close();
+	file = fopen(path, "wb");
+	return file != nullptr;
+}
+
+void FileSink::close()
+{
+	if (file)
+	{
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+void FileSink::flush()
+{
+	RateLimitedSink::flush();
+	if (file)
+	{
+		fflush(file);
+	}
+}
+
+void FileSink::consume(const uint8_t *data, size_t len)
+{
+	if (file && len)
+	{
+		fwrite(data, 1, len, file);
+	}
+}
@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "bufferHealth.h"
+
+namespace {
+// Producer/consumer rates are worked out over this long
+constexpr uint32_t kRateIntervalMs = 1000;
+} // namespace
+
+BufferHealth::BufferHealth()
+	: capacity(0), sequence(0)
+{
+	reset(0);
+}
+
+void BufferHealth::begin(size_t bufferCapacity)
+{
+	capacity = bufferCapacity;
+}
+
+void BufferHealth::reset(uint32_t nowMs)
+{
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+	memset(&stats, 0, sizeof(stats));
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+
+	started = false;
+	lastSampleMs = nowMs;
+	lastState = PrebufferController::kPrebuffering;
+	currentStarvationMs = 0;
+	fillTotal = 0;
+	fillSamples = 0;
+	rateStartMs = nowMs;
+	rateStartWritten = 0;
+	rateStartRead = 0;
+}
+
+void BufferHealth::sample(uint32_t nowMs, size_t fillBytes, uint32_t totalWritten, uint32_t totalRead,
+						  PrebufferController::bufferState state)
+{
+	// First sample after a reset just sets the starting point
+	if (!started)
+	{
+		started = true;
+		lastSampleMs = nowMs;
+		lastState = state;
+		rateStartMs = nowMs;
+		rateStartWritten = totalWritten;
+		rateStartRead = totalRead;
+		return;
+	}
+
+	uint32_t elapsed = nowMs - lastSampleMs;
+	if (elapsed < sampleIntervalMs && state == lastState)
+	{
+		return;
+	}
+
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+
+	// Time goes to whatever state we were in since the last sample
+	switch (lastState)
+	{
+	case PrebufferController::kPrebuffering:
+		stats.prebufferingMs += elapsed;
+		break;
+	case PrebufferController::kPlaying:
+		stats.playingMs += elapsed;
+		break;
+	case PrebufferController::kRebuffering:
+		stats.rebufferingMs += elapsed;
+		stats.starvedMs += elapsed;
+		currentStarvationMs += elapsed;
+		if (currentStarvationMs > stats.longestStarvationMs)
+		{
+			stats.longestStarvationMs = currentStarvationMs;
+		}
+		break;
+	}
+
+	// Ran dry?
+	if (state == PrebufferController::kRebuffering && lastState == PrebufferController::kPlaying)
+	{
+		stats.underruns++;
+		currentStarvationMs = 0;
+	}
+
+	// Fill level
+	uint32_t fill = (uint32_t)fillBytes;
+	if (fillSamples == 0 || fill < stats.minFill)
+	{
+		stats.minFill = fill;
+	}
+	if (fill > stats.maxFill)
+	{
+		stats.maxFill = fill;
+	}
+	fillTotal += fill;
+	fillSamples++;
+	stats.avgFill = (uint32_t)(fillTotal / fillSamples);
+
+	if (capacity)
+	{
+		int bucket = (int)((uint64_t)fill * histogramBuckets / capacity);
+		stats.fillHistogram[bucket < histogramBuckets ? bucket : histogramBuckets - 1]++;
+	}
+
+	// Rates in and out
+	uint32_t rateElapsed = nowMs - rateStartMs;
+	if (rateElapsed >= kRateIntervalMs)
+	{
+		stats.producerBytesPerSec = (uint32_t)((uint64_t)(totalWritten - rateStartWritten) * 1000 / rateElapsed);
+		stats.consumerBytesPerSec = (uint32_t)((uint64_t)(totalRead - rateStartRead) * 1000 / rateElapsed);
+		rateStartMs = nowMs;
+		rateStartWritten = totalWritten;
+		rateStartRead = totalRead;
+	}
+
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+
+	lastSampleMs = nowMs;
+	lastState = state;
+}
+
+void BufferHealth::snapshot(Stats &out) const
+{
+	// Copy until we get one that wasn't being updated while we copied it
+	uint32_t before, after;
+	do
+	{
+		before = sequence.load(std::memory_order_acquire);
+		memcpy(&out, &stats, sizeof(out));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = sequence.load(std::memory_order_acquire);
+	} while ((before & 1) || before != after);
+}
@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include "decoderMonitor.h"
+
+DecoderMonitor::DecoderMonitor()
+	: sequence(0), bestRate(0)
+{
+	reset();
+}
+
+void DecoderMonitor::reset()
+{
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+	memset(&status, 0, sizeof(status));
+	status.codec = codecName(0);
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+
+	bestRate.store(0, std::memory_order_relaxed);
+	windowStarted = false;
+	windowStartSeconds = 0;
+	windowStartBytes = 0;
+}
+
+void DecoderMonitor::update(uint16_t hdat1, uint16_t audata, uint16_t decodeTime, uint16_t byteRate,
+							uint32_t bytesDelivered)
+{
+	// Not decoding anything (yet)
+	if (!hdat1)
+	{
+		return;
+	}
+
+	// Drain rate: bytes fed per decoded second, measured between two ticks of DECODE_TIME
+	// (the FIFO holds at most 2KB we've fed but it hasn't decoded, small over a window)
+	uint32_t measured = status.drainBytesPerSec;
+	uint32_t windowSeconds = decodeTime >= windowStartSeconds ? decodeTime - windowStartSeconds : 0;
+	if (!windowStarted || decodeTime < windowStartSeconds)
+	{
+		windowStarted = true;
+		windowStartSeconds = decodeTime;
+		windowStartBytes = bytesDelivered;
+	}
+	else if (windowSeconds >= rateWindowSeconds)
+	{
+		measured = (bytesDelivered - windowStartBytes) / windowSeconds;
+		windowStartSeconds = decodeTime;
+		windowStartBytes = bytesDelivered;
+	}
+
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+	status.codec = codecName(hdat1);
+	status.kbps = (uint32_t)byteRate * 8 / 1000;
+	status.sampleRate = audata & 0xFFFE;
+	status.channels = (audata & 1) ? 2 : 1;
+	status.decodeSeconds = decodeTime;
+	status.drainBytesPerSec = measured;
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+
+	bestRate.store(measured ? measured : byteRate, std::memory_order_relaxed);
+}
+
+void DecoderMonitor::snapshot(Status &out) const
+{
+	// Copy until we get one that wasn't being updated while we copied it
+	uint32_t before, after;
+	do
+	{
+		before = sequence.load(std::memory_order_acquire);
+		memcpy(&out, &status, sizeof(out));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = sequence.load(std::memory_order_acquire);
+	} while ((before & 1) || before != after);
+}
+
+// HDAT1 says which decoder is running (VS1053b datasheet 9.6.10)
+const char *DecoderMonitor::codecName(uint16_t hdat1)
+{
+	if ((hdat1 & 0xFFE0) == 0xFFE0)
+	{
+		// MPEG audio frame sync, bits 2:1 are the layer
+		switch ((hdat1 >> 1) & 3)
+		{
+		case 1:
+			return "MP3";
+		case 2:
+			return "MP2";
+		case 3:
+			return "MP1";
+		default:
+			return "MPEG";
+		}
+	}
+
+	switch (hdat1)
+	{
+	case 0:
+		return "none";
+	case 0x7665: // "ve"
+		return "WAV";
+	case 0x4154: // "AT" ADTS
+	case 0x4144: // "AD" ADIF
+	case 0x4D34: // "M4" MP4
+		return "AAC";
+	case 0x574D: // "WM"
+		return "WMA";
+	case 0x4F67: // "Og"
+		return "Ogg";
+	case 0x664C: // "fL"
+		return "FLAC";
+	case 0x4D54: // "MT"
+		return "MIDI";
+	default:
+		return "?";
+	}
+}
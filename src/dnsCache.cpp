@@ -0,0 +1,183 @@
+#include <string.h>
+#include <strings.h>
+
+#include "dnsCache.h"
+
+DnsCache::DnsCache()
+	: useCounter(0), changed(false), savedCount(0)
+{
+	memset(entries, 0, sizeof(entries));
+	memset(&counters, 0, sizeof(counters));
+}
+
+DnsCache::lookupResult DnsCache::find(const char *host, uint32_t nowMs, uint32_t &address)
+{
+	Entry *entry = lookup(host);
+	uint32_t age = entry ? nowMs - entry->resolvedAt : 0;
+	if (!entry || (!entry->warm && age > ttlMs + staleMs))
+	{
+		counters.misses++;
+		return kMiss;
+	}
+
+	address = entry->address;
+	touch(entry);
+	counters.hits++;
+	counters.savedMs += entry->lookupMs;
+
+	if (entry->warm || age > ttlMs)
+	{
+		counters.staleHits++;
+		return kStale;
+	}
+	return kFresh;
+}
+
+void DnsCache::store(const char *host, uint32_t address, uint32_t lookupMs, uint32_t nowMs)
+{
+	if (address == 0 || strlen(host) > maxHostLength)
+	{
+		return;
+	}
+
+	Entry *entry = slotFor(host);
+	if (!entry->valid || entry->address != address)
+	{
+		changed = true;
+	}
+
+	strcpy(entry->host, host);
+	entry->address = address;
+	entry->resolvedAt = nowMs;
+	entry->lookupMs = lookupMs;
+	entry->valid = true;
+	entry->warm = false;
+	touch(entry);
+	counters.stores++;
+}
+
+void DnsCache::forget(const char *host)
+{
+	Entry *entry = lookup(host);
+	if (entry)
+	{
+		entry->valid = false;
+		changed = true;
+		counters.forgotten++;
+	}
+}
+
+size_t DnsCache::saveWarm(WarmEntry *out, size_t max) const
+{
+	// Pick the most recently used, newest first (there are only a handful)
+	size_t count = 0;
+	uint32_t below = UINT32_MAX;
+	while (count < max)
+	{
+		const Entry *newest = nullptr;
+		for (size_t i = 0; i < maxEntries; i++)
+		{
+			const Entry &entry = entries[i];
+			if (entry.valid && entry.lastUsed < below && (!newest || entry.lastUsed > newest->lastUsed))
+			{
+				newest = &entry;
+			}
+		}
+		if (!newest)
+		{
+			break;
+		}
+
+		memcpy(out[count].host, newest->host, sizeof(out[count].host));
+		out[count].address = newest->address;
+		out[count].lookupMs = newest->lookupMs;
+		below = newest->lastUsed;
+		count++;
+	}
+
+	changed = false;
+	savedCount = count;
+	return count;
+}
+
+void DnsCache::loadWarm(const WarmEntry *in, size_t count, uint32_t nowMs)
+{
+	// Oldest first, so the newest ends up the most recently used
+	for (size_t i = count; i-- > 0;)
+	{
+		if (in[i].address == 0 || memchr(in[i].host, '\0', sizeof(in[i].host)) == nullptr)
+		{
+			continue;
+		}
+
+		Entry *entry = slotFor(in[i].host);
+		strcpy(entry->host, in[i].host);
+		entry->address = in[i].address;
+		entry->resolvedAt = nowMs;
+		entry->lookupMs = in[i].lookupMs;
+		entry->lastUsed = ++useCounter;
+		entry->valid = true;
+		entry->warm = true;
+	}
+
+	// What we just loaded is what is saved
+	savedCount = 0;
+	for (size_t i = 0; i < maxEntries; i++)
+	{
+		savedCount += entries[i].valid ? 1 : 0;
+	}
+}
+
+// Most recently used now. If it wasn't among the ones last saved, the saved set is out of date.
+void DnsCache::touch(Entry *entry)
+{
+	size_t newer = 0;
+	for (size_t i = 0; i < maxEntries; i++)
+	{
+		if (entries[i].valid && &entries[i] != entry && entries[i].lastUsed > entry->lastUsed)
+		{
+			newer++;
+		}
+	}
+	if (newer >= savedCount)
+	{
+		changed = true;
+	}
+	entry->lastUsed = ++useCounter;
+}
+
+DnsCache::Entry *DnsCache::lookup(const char *host)
+{
+	for (size_t i = 0; i < maxEntries; i++)
+	{
+		if (entries[i].valid && strcasecmp(entries[i].host, host) == 0)
+		{
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+// The entry for this host, else an empty one, else the least recently used
+DnsCache::Entry *DnsCache::slotFor(const char *host)
+{
+	Entry *entry = lookup(host);
+	if (entry)
+	{
+		return entry;
+	}
+
+	Entry *victim = &entries[0];
+	for (size_t i = 0; i < maxEntries; i++)
+	{
+		if (!entries[i].valid)
+		{
+			return &entries[i];
+		}
+		if (entries[i].lastUsed < victim->lastUsed)
+		{
+			victim = &entries[i];
+		}
+	}
+	return victim;
+}
@@ -40,28 +40,68 @@ bool METADATA = true;
 
 // The number of bytes between metadata (title track)
 uint16_t metaDataInterval = 0; //bytes
-uint16_t bytesUntilmetaData = 0;
 int bitRate = 0;
-bool redirected = false;
 bool volumeMax = false;
 
-// Dedicated 32-byte buffer for VS1053 aligned on 4-byte boundary for efficiency
-uint8_t mp3buff[32] __attribute__((aligned(4)));
+// Circular "Read Buffer" to stop stuttering on some stations (storage allocated in setup)
+AudioRingBuffer circBuffer;
 
-// Circular "Read Buffer" to stop stuttering on some stations
-cbuf circBuffer(10);
+// Start/resume levels for the ring buffer
+PrebufferController prebuffer;
 
-// Internet stream buffer that we copy in chunks to the ring buffer
-char readBuffer[100] __attribute__((aligned(4)));
+// Gives up on a station that has stopped sending, while there's still audio to cover a reconnect
+StallWatchdog stallWatchdog;
+
+// Ring buffer health figures, see printBufferHealth()
+BufferHealth bufferHealth;
+
+// Decoder readback, see printDecoderStatus()
+DecoderMonitor decoderMonitor;
+
+// Audio/metadata splitter for the stream
+IcyDemuxer icyDemuxer;
+
+// Metadata repeat counters, see handleMetaData()
+metadataStatistics metadataStats = {0, 0};
+
+// The last metadata block handleMetaData() acted on
+uint32_t lastMetaDataHash = 0;
+size_t lastMetaDataLength = 0;
+bool haveMetaDataHash = false;
+
+// VS1053 feeding counters, see printFeederStats()
+feederStatistics feederStats = {0, 0, 0};
+
+// SPI bus sharing, the VS1053 goes through playerBus to get at it
+SpiBusArbiter spiBus;
+ArbitratedTransport playerBus(spiBus);
+
+// Station changes for the ingest task, screen updates for loop()
+MessageQueue ingestCommands;
+MessageQueue uiEvents;
 
 // MP3 decoder
 VS1053 player(VS1053_CS, VS1053_DCS, VS1053_DREQ);
+Vs1053Sink playerSink(player);
+AudioSink *audioSink = &playerSink;
+#ifdef VS1053_DMA
+VS1053DmaTransport playerTransport(HSPI_HOST, VS1053_SCK, VS1053_MISO, VS1053_MOSI);
+SPIClass playerSpi(HSPI);
+VS1053SpiTransport playerSpiTransport(playerSpi, VS1053_SCK, VS1053_MISO, VS1053_MOSI);
+#endif
 
 // Instantiate screen (object) using hardware SPI. Defaults to 320H x 240W
 TFT_eSPI tft = TFT_eSPI();
 
 // Start the WiFi client here
 WiFiClient client;
+StationConnector stationConnector(client);
+RedirectCache redirectCache;
+
+// Reading the stream into the ring buffer (read counters for printIngestStats())
+WiFiStreamSource stationStream(client);
+ArduinoClock ingestClock;
+IngestLoop ingestLoop(stationStream, ingestClock, circBuffer, icyDemuxer, prebuffer, stallWatchdog);
 
 namespace {
 String decodeXmlEntities(String value)
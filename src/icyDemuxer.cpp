@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "icyDemuxer.h"
+
+IcyDemuxer::IcyDemuxer()
+{
+	reset(0);
+}
+
+void IcyDemuxer::reset(uint32_t metaInterval)
+{
+	state = kAudio;
+	interval = metaInterval;
+	audioRemaining = metaInterval;
+	metaRemaining = 0;
+	metaLength = 0;
+	blocks = 0;
+	metaStartMs = 0;
+	split = 0;
+	longestMs = 0;
+	metadata[0] = '\0';
+}
+
+size_t IcyDemuxer::process(uint8_t *data, size_t len, uint32_t nowMs, metadataHandler handler, void *context)
+{
+	// No metadata in this stream, it's all audio
+	if (interval == 0)
+	{
+		return len;
+	}
+
+	const uint8_t *in = data;
+	const uint8_t *end = data + len;
+	uint8_t *out = data;
+
+	while (in < end)
+	{
+		size_t left = end - in;
+
+		switch (state)
+		{
+		case kAudio:
+		{
+			// Keep a run of audio, shuffled down over any metadata we removed before it
+			size_t run = left < audioRemaining ? left : audioRemaining;
+			if (out != in)
+			{
+				memmove(out, in, run);
+			}
+			out += run;
+			in += run;
+			audioRemaining -= run;
+			if (audioRemaining == 0)
+			{
+				state = kLength;
+			}
+			break;
+		}
+
+		case kLength:
+			// The length is in 16 byte units, usually 0 as it's only sent on a change
+			metaRemaining = (size_t)(*in++) * 16;
+			metaLength = 0;
+			if (metaRemaining == 0)
+			{
+				blocks++;
+				audioRemaining = interval;
+				state = kAudio;
+			}
+			else
+			{
+				metaStartMs = nowMs;
+				state = kMetadata;
+			}
+			break;
+
+		case kMetadata:
+		{
+			size_t run = left < metaRemaining ? left : metaRemaining;
+			memcpy(metadata + metaLength, in, run);
+			metaLength += run;
+			metaRemaining -= run;
+			in += run;
+
+			if (metaRemaining == 0)
+			{
+				// Took more than this read to get it all?
+				if (metaLength != run)
+				{
+					split++;
+					if (nowMs - metaStartMs > longestMs)
+					{
+						longestMs = nowMs - metaStartMs;
+					}
+				}
+
+				// Blocks are padded with nulls, so the string may well end before metaLength
+				metadata[metaLength] = '\0';
+				blocks++;
+				if (handler)
+				{
+					handler(metadata, metaLength, context);
+				}
+				audioRemaining = interval;
+				state = kAudio;
+			}
+			break;
+		}
+		}
+	}
+
+	return out - data;
+}
@@ -0,0 +1,165 @@
+#include <string.h>
+#include <strings.h>
+
+#include "icyMetadata.h"
+
+namespace {
+bool isKeyChar(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Does the quote just before at close the value? Only if "';" is followed by the end or another key.
+bool closesValue(const char *at, const char *end)
+{
+	if (at >= end)
+	{
+		return true;
+	}
+	if (*at != ';')
+	{
+		return false;
+	}
+
+	const char *next = at + 1;
+	while (next < end && isSpace(*next))
+	{
+		next++;
+	}
+	if (next >= end)
+	{
+		return true;
+	}
+
+	const char *key = next;
+	while (next < end && isKeyChar(*next))
+	{
+		next++;
+	}
+	return next > key && next < end && *next == '=';
+}
+} // namespace
+
+bool IcyMetadata::Span::equals(const char *other) const
+{
+	return strlen(other) == len && strncasecmp(text, other, len) == 0;
+}
+
+IcyMetadata::IcyMetadata()
+	: fieldCount(0), droppedFields(0), badText(false)
+{
+}
+
+size_t IcyMetadata::parse(char *block, size_t len)
+{
+	fieldCount = 0;
+	droppedFields = 0;
+	badText = false;
+
+	// The block is padded out with nulls to a multiple of 16
+	char *p = block;
+	char *end = block + strnlen(block, len);
+
+	while (p < end)
+	{
+		// Between pairs
+		while (p < end && (isSpace(*p) || *p == ';'))
+		{
+			p++;
+		}
+		if (p >= end)
+		{
+			break;
+		}
+
+		char *key = p;
+		while (p < end && isKeyChar(*p))
+		{
+			p++;
+		}
+		if (p == key || p >= end || *p != '=')
+		{
+			badText = true;
+			break;
+		}
+		size_t keyLen = p - key;
+		*p++ = '\0';
+
+		// Collapse escapes as we go, out never gets ahead of p
+		char *value = p;
+		char *out = p;
+		if (p < end && *p == '\'')
+		{
+			value = out = ++p;
+			bool closed = false;
+			while (p < end)
+			{
+				if (*p == '\\' && p + 1 < end && p[1] == '\'')
+				{
+					*out++ = '\'';
+					p += 2;
+				}
+				else if (*p == '\'' && closesValue(p + 1, end))
+				{
+					p++;
+					closed = true;
+					break;
+				}
+				else
+				{
+					*out++ = *p++;
+				}
+			}
+
+			// Cut off part way through, keep what there is
+			if (!closed)
+			{
+				badText = true;
+			}
+		}
+		else
+		{
+			while (p < end && *p != ';')
+			{
+				*out++ = *p++;
+			}
+		}
+
+		// Past the ';' before terminating, the value may end right on it
+		if (p < end)
+		{
+			p++;
+		}
+		*out = '\0';
+
+		if (fieldCount == maxFields)
+		{
+			droppedFields++;
+			continue;
+		}
+		Field &field = fields[fieldCount++];
+		field.key.text = key;
+		field.key.len = keyLen;
+		field.value.text = value;
+		field.value.len = out - value;
+	}
+
+	return fieldCount;
+}
+
+const IcyMetadata::Span *IcyMetadata::find(const char *key) const
+{
+	for (size_t i = 0; i < fieldCount; i++)
+	{
+		if (fields[i].key.equals(key))
+		{
+			return &fields[i].value;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,122 @@
+#include "ingestLoop.h"
+
+IngestLoop::IngestLoop(StreamSource &source, IngestClock &clock, AudioRingBuffer &ring, IcyDemuxer &demuxer,
+					   PrebufferController &prebuffer, StallWatchdog &stallWatchdog)
+	: source(source), clock(clock), ring(ring), demuxer(demuxer), prebuffer(prebuffer),
+	  stallWatchdog(stallWatchdog), handler(nullptr), handlerContext(nullptr), corrupt(false), audioBytes(0),
+	  lost(kLostNone), counters{0, 0, 0, 0}
+{
+}
+
+void IngestLoop::setMetadataHandler(IcyDemuxer::metadataHandler handler, void *context)
+{
+	this->handler = handler;
+	handlerContext = context;
+}
+
+const char *IngestLoop::lostName(lostCause cause)
+{
+	switch (cause)
+	{
+	case kLostClosed:
+		return "client not connected";
+	case kLostOutOfSync:
+		return "metadata out of sync";
+	case kLostMetadataOverdue:
+		return "metadata block overdue";
+	case kLostStalled:
+		return "stalled";
+	default:
+		return "none";
+	}
+}
+
+uint32_t IngestLoop::takeSlowestReadMicros()
+{
+	uint32_t slowest = counters.slowestReadMicros;
+	counters.slowestReadMicros = 0;
+	return slowest;
+}
+
+IngestLoop::stepResult IngestLoop::lose(lostCause cause)
+{
+	lost = cause;
+	return kLost;
+}
+
+IngestLoop::stepResult IngestLoop::step(uint32_t drainRate)
+{
+	audioBytes = 0;
+	lost = kLostNone;
+	stepResult result = kWaiting;
+
+	int waiting = source.available();
+	if (waiting > 0)
+	{
+		uint32_t readStart = clock.nowMicros();
+		bool inSync = readStream((size_t)waiting);
+		uint32_t readMicros = clock.nowMicros() - readStart;
+		if (readMicros > counters.slowestReadMicros)
+		{
+			counters.slowestReadMicros = readMicros;
+		}
+
+		// If the metadata we found was rubbish we've lost sync with the stream
+		if (!inSync)
+		{
+			return lose(kLostOutOfSync);
+		}
+		result = ring.room() == 0 ? kBufferFull : kRead;
+	}
+	else if (!source.connected())
+	{
+		return lose(kLostClosed);
+	}
+
+	uint32_t now = clock.nowMs();
+	if (demuxer.metadataOverdue(now))
+	{
+		return lose(kLostMetadataOverdue);
+	}
+
+	// Connected, but is anything (enough) still arriving?
+	if (stallWatchdog.check(now, ring.available(), drainRate))
+	{
+		return lose(kLostStalled);
+	}
+
+	return result;
+}
+
+// Read the stream into the ring buffer's free space, then have the demuxer take the metadata
+// out (shuffling the audio down over it). Returns false if the stream needs reconnecting.
+bool IngestLoop::readStream(size_t waiting)
+{
+	// Largest contiguous free space in the ring buffer (shorter at the wrap point, we get the rest next time)
+	AudioRingBuffer::Span freeSpace = ring.reserve(waiting < maxRead ? waiting : maxRead);
+	if (freeSpace.len == 0)
+	{
+		return true;
+	}
+
+	int bytesReadFromStream = source.read(freeSpace.data, freeSpace.len);
+	counters.readCalls++;
+
+	// Nothing could be read: a server that has stopped sending is left to the stall watchdog
+	if (bytesReadFromStream <= 0)
+	{
+		counters.emptyReads++;
+		return true;
+	}
+	counters.bytesRead += bytesReadFromStream;
+
+	// Strip out the metadata then hand the audio over to the player task
+	corrupt = false;
+	uint32_t now = clock.nowMs();
+	audioBytes = demuxer.process(freeSpace.data, bytesReadFromStream, now, handler, handlerContext);
+	ring.commit(audioBytes);
+	prebuffer.onArrival(now, audioBytes);
+	stallWatchdog.onArrival(now, audioBytes);
+
+	return !corrupt;
+}
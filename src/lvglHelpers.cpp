@@ -12,6 +12,7 @@ namespace {
 constexpr uint16_t kLvglHorRes = 320;
 constexpr uint16_t kLvglVerRes = 240;
 constexpr uint32_t kLvglBufPixels = kLvglHorRes * 40;
+constexpr uint32_t kFlushSliceRows = 8; // rows pushed per SPI bus claim, see lvglFlushCb()
 
 constexpr int kPanelMargin = 6;
 constexpr int kPanelY = 98;
@@ -69,15 +70,33 @@ const GenreStyle kGenreStyles[] = {
     {nullptr, "GEN", 0x202020, 0xE0E0E0},
 };
 
+// Push the area a few rows at a time, so the VS1053 never waits for more than one
+// slice (about 1ms at 40MHz for a full width slice) to get at the shared SPI bus
 void lvglFlushCb(lv_display_t *display, const lv_area_t *area, uint8_t *px_map)
 {
     uint32_t w = static_cast<uint32_t>(area->x2 - area->x1 + 1);
     uint32_t h = static_cast<uint32_t>(area->y2 - area->y1 + 1);
+    uint16_t *pixels = reinterpret_cast<uint16_t *>(px_map);
 
+    spiBus.acquire(kBusDisplay);
     tft.startWrite();
-    tft.setAddrWindow(area->x1, area->y1, w, h);
-    tft.pushColors(reinterpret_cast<uint16_t *>(px_map), w * h, true);
+    for (uint32_t row = 0; row < h; row += kFlushSliceRows)
+    {
+        uint32_t rows = (h - row < kFlushSliceRows) ? h - row : kFlushSliceRows;
+
+        // Audio (or touch) waiting? Let it in between slices
+        if (row && spiBus.contended(kBusDisplay))
+        {
+            tft.endWrite();
+            spiBus.yieldIfWaiting(kBusDisplay);
+            tft.startWrite();
+        }
+
+        tft.setAddrWindow(area->x1, area->y1 + row, w, rows);
+        tft.pushColors(pixels + row * w, w * rows, true);
+    }
     tft.endWrite();
+    spiBus.release(kBusDisplay);
 
     lv_display_flush_ready(display);
 }
@@ -87,7 +106,7 @@ void lvglTouchRead(lv_indev_t *indev, lv_indev_data_t *data)
     uint16_t x = 0;
     uint16_t y = 0;
 
-    bool touched = tft.getTouch(&x, &y);
+    bool touched = readTouch(&x, &y);
     if (touched)
     {
         data->state = LV_INDEV_STATE_PRESSED;
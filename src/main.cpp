@@ -6,9 +6,24 @@
 #include "lvglHelpers.h"
 
 namespace {
-	char redirectedHost[64] = "";
-	char redirectedPath[128] = "";
-	int redirectedPort = 80;
+	// The connect in progress: the station's own URL (as a redirect cache key), where we
+	// are actually connecting, and the redirects followed to get there
+	uint32_t stationUrlKey = 0;
+	RedirectCache::Target connectTarget;
+	int redirectHops = 0;
+	bool redirectsPermanent = true;
+	bool targetFromCache = false;
+
+	// Did the server itself let us down (rather than our WiFi or a timeout)?
+	bool serverFailed(StationConnector::failReason reason)
+	{
+		if (WiFi.status() != WL_CONNECTED)
+		{
+			return false;
+		}
+		return reason == StationConnector::kFailDns || reason == StationConnector::kFailConnect ||
+			   reason == StationConnector::kFailBadResponse || reason == StationConnector::kFailClosed;
+	}
 }
 
 // ==================================================================================
@@ -20,7 +35,14 @@ void setup()
 	Serial.begin(115200);
 
 	// Are we using PSRAM?
-	circBuffer.resize(CIRCULARBUFFERSIZE);
+	if (!circBuffer.begin(CIRCULARBUFFERSIZE))
+	{
+		Serial.println("Unable to allocate the ring buffer.");
+		while (1)
+			delay(1);
+	}
+	prebuffer.begin(CIRCULARBUFFERSIZE);
+	bufferHealth.begin(CIRCULARBUFFERSIZE);
 	log_d("Total heap: %d", ESP.getHeapSize());
 	log_d("Free heap: %d", ESP.getFreeHeap());
 	log_d("Total PSRAM: %d", ESP.getPsramSize());
@@ -35,6 +57,7 @@ void setup()
 	// initialize SPI bus;
 	Serial.println("Starting SPI");
 	SPI.begin();
+	spiBus.begin();
 
 	// Start the display so we can show connection/hardware errors on it
 	initDisplay();
@@ -65,9 +88,35 @@ void setup()
 		}
 	}
 
+	// Saved settings (last station, brightness, VS1053 self test result)
+	preferences.begin("WebRadio", false);
+
 	// VS1053 MP3 decoder
 	Serial.println("Starting player");
-	player.begin();
+#ifdef VS1053_DMA
+	playerTransport.setFallback(&playerSpiTransport);
+	player.setTransport(&playerTransport);
+#else
+	// Sharing the bus with the screen, so ask the arbiter first
+	playerBus.wrap(player.getTransport());
+	player.setTransport(&playerBus);
+#endif
+	// The exhaustive fast SPI self test only needs to pass once per power up (it takes
+	// about half a second): after a software restart or crash a quick test will do
+	bool coldBoot = esp_reset_reason() == ESP_RST_POWERON;
+	bool fullSelfTest = coldBoot || !preferences.getBool("vsSelfTest", false);
+	bool selfTestPassed = player.begin(fullSelfTest);
+	if (fullSelfTest)
+	{
+		preferences.putBool("vsSelfTest", selfTestPassed);
+	}
+	Serial.printf("VS1053 %s self test %s\n", fullSelfTest ? "full" : "quick", selfTestPassed ? "passed" : "FAILED");
+#ifdef VS1053_DMA
+	if (playerTransport.usingFallback())
+	{
+		Serial.println("VS1053 DMA could not be set up, using plain SPI");
+	}
+#endif
 
 	// Wait for the player to be ready to accept data
 	Serial.println("Waiting for VS1053 initialisation to complete.");
@@ -135,7 +184,6 @@ void setup()
 	METADATA = digitalRead(ICYDATAPIN) == HIGH;
 
 	// Get the station number that was previously playing
-	preferences.begin("WebRadio", false);
 	currStnNo = preferences.getUInt("currStnNo", 0);
 	if (currStnNo > stationCnt - 1)
 	{
@@ -143,17 +191,6 @@ void setup()
 	}
 	prevStnNo = currStnNo;
 
-	// Connect to that station
-	Serial.printf("Current station number: %u\n", currStnNo);
-	while (!stationConnect(currStnNo))
-	{
-		checkForStationChange();
-		if (!client.connected())
-		{
-			connectToWifi();
-		}
-	};
-
 	// Set screen brightness to previous level
 	ledcSetup(0, 5000, 8);
 	ledcAttachPin(TFT_BL, 0);
@@ -163,7 +200,8 @@ void setup()
 	Serial.printf("Restored screen brightness to %d\n", prevTFTBright);
 	ledcWrite(0, prevTFTBright);
 
-	// We need to set up independent task that plays the music from the circular buffer
+	// We need to set up independent tasks that play the music from the circular buffer
+	// and fill it from the station (which connects to the station above)
 	taskSetup();
 
 	//Now how much SRAM free (heap memory)
@@ -175,68 +213,15 @@ void setup()
 // ==================================================================================
 void loop()
 {
-	// Data to read from mainBuffer?
-	if (client.available())
-	{
-		populateRingBuffer();
+	// Anything from the ingest task to show on screen?
+	processUiEvents();
 
-		// If we've read all data between metadata bytes, check to see if there is track title to read
-		if (bytesUntilmetaData == 0 && METADATA)
-		{
-			// TODO: if cant read valid metadata we need to reconnect
-			if (!readMetaData())
-			{
-				while (!stationConnect(currStnNo))
-				{
-					checkForStationChange();
-					if (!client.connected())
-					{
-						connectToWifi();
-					}
-				};
-			}
-
-			// reset byte count for next bit of metadata
-			bytesUntilmetaData = metaDataInterval;
-		}
-	}
-	else
-	{
-		// Sometimes we get randomly disconnected from WiFi BUG Why?
-		if (!client.connected())
-		{
-			// TODO: if client suddenly not connected we will have to reconnect
-			Serial.println("Client not connected.");
-			connectToWifi();
-			while (!stationConnect(currStnNo))
-			{
-				checkForStationChange();
-				if (!client.connected())
-				{
-					connectToWifi();
-				}
-			};
-		}
-	}
-
-	// // If we (no longer) need to buffer the streaming data (after a station change)
-	// // allow the buffer to be played
-	// if (canPlayMusicFromBuffer)
-	// {
-	// 	// If we failed to play 32b from the buffer (insufficient data) set the flag again
-	// 	if (!playMusicFromRingBuffer())
-	// 	{
-	// 		canPlayMusicFromBuffer = false;
-	// 	};
-	// }
-	// else
-	// {
-	// 	// Otherwise, check whether we now have enough data to start playing
-	// 	checkBufferForPlaying();
-	// }
-
-	// So how many bytes have we got in the buffer (should hover around 90%)
+	// So how much audio have we got in the buffer (in seconds, should hover around 90% full)
 	drawBufferLevel(circBuffer.available());
+	printBufferHealth();
+	printFeederStats();
+	printSpiBusStats();
+	printDecoderStatus();
 
 	// Has CHANGE STATION button been pressed?
 	checkForStationChange();
@@ -251,61 +236,224 @@ void loop()
 	lvglTaskHandler();
 }
 
-// Populate ring buffer with streaming data
-void populateRingBuffer()
+// Every so often show how many reads we need to keep up with the stream
+// (eg Radio Paradise, station 15, is 320kbps = 40000 bytes/sec)
+void printIngestStats()
 {
-	// Signed because we might -1 returned
-	signed int bytesReadFromStream = 0;
+	static unsigned long prevMillis = millis();
+	static IngestLoop::Stats prevStats = {0, 0, 0, 0};
+	static metadataStatistics prevMetadata = {0, 0};
 
-	// Room in the ring buffer for (up to) X bytes?
-	if (circBuffer.room() >= streamingCharsMax)
+	unsigned long elapsed = millis() - prevMillis;
+	if (elapsed < 10000)
 	{
-		// Read either the maximum available (max 100) or the number of bytes to the next meata data interval
-		bytesReadFromStream = client.read((uint8_t *)readBuffer, min(streamingCharsMax, METADATA ? (int)bytesUntilmetaData : streamingCharsMax));
+		return;
+	}
+	prevMillis = millis();
 
-		// If we get -1 here it means nothing could be read from the stream
-		// TODO: find out why this might be. Remote server not streaming?
-		if (bytesReadFromStream > 0)
+	const IngestLoop::Stats &stats = ingestLoop.stats();
+	uint32_t calls = stats.readCalls - prevStats.readCalls;
+	uint32_t bytes = stats.bytesRead - prevStats.bytesRead;
+	uint32_t empty = stats.emptyReads - prevStats.emptyReads;
+	prevStats = stats;
+
+	Serial.printf("Ingest: %lu reads/s, %lu bytes/s, %lu bytes/read, %lu empty reads\n",
+				  (unsigned long)(calls * 1000UL / elapsed),
+				  (unsigned long)(bytes * 1000UL / elapsed),
+				  (unsigned long)(calls ? bytes / calls : 0),
+				  (unsigned long)empty);
+
+	// Titles that changed, and repeats of the last one that handleMetaData() dropped
+	Serial.printf("Metadata: %lu applied, %lu repeats dropped\n",
+				  (unsigned long)(metadataStats.applied - prevMetadata.applied),
+				  (unsigned long)(metadataStats.suppressed - prevMetadata.suppressed));
+	prevMetadata = metadataStats;
+}
+
+// Check whether there's enough in the ring buffer to (still) be playing. After a station
+// connect, or if we ran dry, this waits until the buffer has had a chance to fill up.
+bool checkBufferForPlaying()
+{
+	PrebufferController::bufferState prevState = prebuffer.state();
+	uint32_t prevStationChanges = prebuffer.stationChanges();
+	size_t buffered = circBuffer.available();
+	bool canPlay = prebuffer.update(millis(), buffered);
+
+	// Buffer health figures are per station
+	if (prebuffer.stationChanges() != prevStationChanges)
+	{
+		bufferHealth.reset(millis());
+	}
+	bufferHealth.sample(millis(), buffered, circBuffer.totalWritten(), circBuffer.totalRead(), prebuffer.state());
+
+	// Report the changes so we can see how long stations take to start, and how often they stutter
+	if (prebuffer.state() != prevState)
+	{
+		switch (prebuffer.state())
 		{
-			// Add them to the circular buffer
-			circBuffer.write(readBuffer, bytesReadFromStream);
+		case PrebufferController::kPlaying:
+			if (prevState == PrebufferController::kPrebuffering)
+			{
+				Serial.printf("Playing after %lums (%lums buffered, jitter %lums, %lu bytes/sec)\n",
+							  (unsigned long)prebuffer.timeToAudioMs(), (unsigned long)prebuffer.bytesToMs(buffered),
+							  (unsigned long)prebuffer.jitterMs(), (unsigned long)prebuffer.byteRate());
+			}
+			else
+			{
+				Serial.printf("Playing again (%lums buffered)\n", (unsigned long)prebuffer.bytesToMs(buffered));
+			}
+			break;
 
-			// If we didn't read the amount we "expected" debug that here
-			// if (bytesReadFromStream < streamingCharsMax && bytesReadFromStream != bytesUntilmetaData)
-			// {
-			// 	Serial.printf("%db to circ\n", bytesReadFromStream);
-			// }
+		case PrebufferController::kRebuffering:
+			Serial.printf("Buffer underrun (%lu this station, %lu total), rebuffering to %lums\n",
+						  (unsigned long)prebuffer.stationUnderruns(), (unsigned long)prebuffer.underruns(),
+						  (unsigned long)prebuffer.recoveryLevelMs());
+			break;
 
-			// Subtract bytes actually read from incoming http data stream from the bytesUntilmetaData
-			bytesUntilmetaData -= bytesReadFromStream;
+		default:
+			break;
 		}
 	}
+
+	return canPlay;
 }
 
-// Copy streaming data to our ring buffer and check wheter there's enough to start playing yet
-// This is only excuted after a station connect to give the buffer a chance to fill up.
-void checkBufferForPlaying()
+// Every so often show how hard we work to get the audio to the VS1053. Sending one chunk
+// per transaction (the old way) this was 32 bytes per transaction.
+void printFeederStats()
 {
-	// If we have now got enough in the ring buffer to allow playing to start without stuttering?
-	if (circBuffer.available() > CIRCULARBUFFERSIZE / 3)
+	static unsigned long prevMillis = millis();
+	static feederStatistics prevStats = {0, 0, 0};
+
+	unsigned long elapsed = millis() - prevMillis;
+	if (elapsed < 10000)
+	{
+		return;
+	}
+	prevMillis = millis();
+
+	feederStatistics stats = feederStats;
+	uint32_t transactions = stats.transactions - prevStats.transactions;
+	uint32_t bytes = stats.bytesSent - prevStats.bytesSent;
+	uint32_t spiMicros = stats.spiMicros - prevStats.spiMicros;
+	prevStats = stats;
+
+	Serial.printf("Feeder: %lu SPI transactions/s, %lu bytes/transaction, %lu us/KB\n",
+				  (unsigned long)(transactions * 1000UL / elapsed),
+				  (unsigned long)(transactions ? bytes / transactions : 0),
+				  (unsigned long)(bytes ? (uint64_t)spiMicros * 1024 / bytes : 0));
+}
+
+// Every so often show who has been holding the SPI bus, and who has been kept waiting
+void printSpiBusStats()
+{
+	static unsigned long prevMillis = millis();
+
+	if (millis() - prevMillis < 30000)
+	{
+		return;
+	}
+	prevMillis = millis();
+
+	for (int client = 0; client < kBusClients; client++)
 	{
-		// Reset the flag, allowing data to be played, won't get reset again until station change
-		canPlayMusicFromBuffer = true;
+		SpiBusArbiter::Stats stats;
+		spiBus.snapshot(static_cast<spiBusClient>(client), stats);
+		Serial.printf("SPI %-7s: %lu grants, %lu yields, hold avg/max %lu/%lu us, wait avg/max %lu/%lu us\n",
+					  SpiBusArbiter::clientName(static_cast<spiBusClient>(client)),
+					  (unsigned long)stats.grants,
+					  (unsigned long)stats.yields,
+					  (unsigned long)(stats.grants ? stats.holdMicros / stats.grants : 0),
+					  (unsigned long)stats.maxHoldMicros,
+					  (unsigned long)(stats.grants ? stats.waitMicros / stats.grants : 0),
+					  (unsigned long)stats.maxWaitMicros);
 	}
 }
 
-// Connect to the station list number
-bool stationConnect(int stationNo)
+// Bytes/sec the decoder actually takes (if we know it yet), else our best guess at the station's rate
+uint32_t drainByteRate()
+{
+	uint32_t rate = decoderMonitor.drainRate();
+	return rate ? rate : prebuffer.byteRate();
+}
+
+// How much audio this many bytes is, at the rate it is being played
+uint32_t bufferedMs(size_t bytes)
+{
+	return (uint32_t)((uint64_t)bytes * 1000 / drainByteRate());
+}
+
+// Every so often show what the decoder says it is playing
+void printDecoderStatus()
+{
+	static unsigned long prevMillis = millis();
+
+	if (millis() - prevMillis < 30000)
+	{
+		return;
+	}
+	prevMillis = millis();
+
+	DecoderMonitor::Status status;
+	decoderMonitor.snapshot(status);
+	Serial.printf("Decoder: %s %lukbps %luHz %s, %lus decoded, drain %lu bytes/sec, buffer %lums\n",
+				  status.codec, (unsigned long)status.kbps, (unsigned long)status.sampleRate,
+				  status.channels == 2 ? "stereo" : "mono", (unsigned long)status.decodeSeconds,
+				  (unsigned long)status.drainBytesPerSec, (unsigned long)bufferedMs(circBuffer.available()));
+}
+
+// Every so often show how the ring buffer is coping with this station
+void printBufferHealth()
+{
+	static unsigned long prevMillis = millis();
+
+	if (millis() - prevMillis < 30000)
+	{
+		return;
+	}
+	prevMillis = millis();
+
+	BufferHealth::Stats stats;
+	bufferHealth.snapshot(stats);
+
+	Serial.printf("Buffer: fill min/avg/max %lu/%lu/%lu bytes, in %lu out %lu bytes/sec\n",
+				  (unsigned long)stats.minFill, (unsigned long)stats.avgFill, (unsigned long)stats.maxFill,
+				  (unsigned long)stats.producerBytesPerSec, (unsigned long)stats.consumerBytesPerSec);
+	Serial.printf("Buffer: %lu underruns, starved %lums (longest %lums), prebuffering %lums, playing %lums, rebuffering %lums\n",
+				  (unsigned long)stats.underruns, (unsigned long)stats.starvedMs, (unsigned long)stats.longestStarvationMs,
+				  (unsigned long)stats.prebufferingMs, (unsigned long)stats.playingMs, (unsigned long)stats.rebufferingMs);
+	Serial.print("Buffer: fill histogram (10% steps)");
+	for (int bucket = 0; bucket < BufferHealth::histogramBuckets; bucket++)
+	{
+		Serial.printf(" %lu", (unsigned long)stats.fillHistogram[bucket]);
+	}
+	Serial.println();
+}
+
+// Start connecting to the station list number, stationConnectStep() does the rest. When resuming
+// (the same station, after losing it) whatever audio is still buffered carries on playing.
+void stationConnectBegin(int stationNo, bool resume)
 {
 	Serial.println("--------------------------------------");
-	Serial.printf("        Connecting to station %d\n", stationNo);
+	Serial.printf("        %s station %d\n", resume ? "Reconnecting to" : "Connecting to", stationNo);
 	Serial.println("--------------------------------------");
 
-	// Flag to indicate we need to buffer data before allowing player to stream audio
-	canPlayMusicFromBuffer = false;
+	if (resume)
+	{
+		Serial.printf("Still playing %lums of buffered audio\n", (unsigned long)bufferedMs(circBuffer.available()));
+	}
+	else
+	{
+		// We need to buffer data before allowing player to stream audio
+		prebuffer.reset(millis());
+		bitRate = 0;
+
+		// Clear down the streaming buffer and optionally reset the player (to flush it)
+		circBuffer.flush();
 
-	// Clear down the streaming buffer and optionally reset the player (to flush it)
-	circBuffer.flush();
+		// The screen is cleared, so the first title from the new station must go up
+		haveMetaDataHash = false;
+	}
 	
 	//How much SRAM free (heap memory)
 	Serial.printf("Free memory: %d bytes\n", ESP.getFreeHeap());
@@ -324,144 +472,129 @@ bool stationConnect(int stationNo)
 	metaDataInterval = 0;
 
 	// Clear down any screen info
-	displayStationName(radioStation[stationNo].friendlyName);
-	lvglUpdateGenre(radioStation[stationNo].genre);
-	displayTrackArtist((char *)"");
-	drawBufferLevel(0, true);
-
-	// We try a few times to connect to the station
-	bool connected = false;
-	int connectAttempt = 0;
-
-	const char *host = redirected ? redirectedHost : radioStation[stationNo].host;
-	const char *path = redirected ? redirectedPath : radioStation[stationNo].path;
-	int port = redirected ? redirectedPort : radioStation[stationNo].port;
-
-	while (!connected && connectAttempt < 5)
+	if (!resume)
 	{
-		if (redirected)
-		{
-			Serial.printf("REDIRECTED URL DETECTED FOR STATION %d\n", stationNo);
-		}
-
-		connectAttempt++;
-		Serial.printf("Host: %s Port:%d\n", host, port);
-
-		// Connect to the redirected URL
-		if (client.connect(host, port))
-		{
-			connected = true;
-		}
+		postUiEvent(kUiStationChanged, stationNo, "");
 	}
 
-	// If we could not connect (eg bad URL) just exit
-	if (!connected)
+	// Go straight to wherever the station redirected us to last time (if it did)
+	const radioStationLayout &station = radioStation[stationNo];
+	stationUrlKey = RedirectCache::keyFor(station.host, station.port, station.path);
+	redirectHops = 0;
+	redirectsPermanent = true;
+	targetFromCache = redirectCache.find(stationUrlKey, connectTarget, redirectsPermanent);
+	if (targetFromCache)
 	{
-		Serial.printf("Could not connect to %s\n", host);
-		return false;
+		Serial.printf("Station %d redirects (%s) to %s:%u%s\n", stationNo,
+					  redirectsPermanent ? "permanently" : "this session", connectTarget.host,
+					  connectTarget.port, connectTarget.path);
 	}
 	else
 	{
-		Serial.printf("Connected to %s (%s%s)\n",
-					  host, radioStation[stationNo].friendlyName,
-					  redirected ? " - redirected" : "");
+		strncpy(connectTarget.host, station.host, sizeof(connectTarget.host));
+		strncpy(connectTarget.path, station.path, sizeof(connectTarget.path));
+		connectTarget.port = station.port;
 	}
 
-	// Get the data stream plus any metadata (eg station name, track info between songs / ads)
-	// TODO: Allow retries here (BBC Radio 4 very finicky before streaming).
-	// We might also get a redirection URL given back.
-	Serial.printf("Getting data from %s (%s Metadata)\n", path, (METADATA ? "WITH" : "WITHOUT"));
-	client.print(
-		String("GET ") + path + " HTTP/1.1\r\n" +
-		"Host: " + host + "\r\n" +
-		(METADATA ? "Icy-MetaData:1\r\n" : "") +
-		"Connection: close\r\n\r\n");
+	stationConnector.start(connectTarget.host, connectTarget.port, connectTarget.path, METADATA);
+}
+
+// The station sent us elsewhere: connect there instead, keeping track of the whole chain
+static bool followRedirect(int stationNo)
+{
+	uint16_t status = stationConnector.headers().status;
+	bool permanent = status == 301 || status == 308;
 
-	// Give the client a chance to connect
-	Serial.println("Waiting for header data");
-	int retryCnt = 30;
-	while (client.available() == 0 && --retryCnt > 0)
+	RedirectCache::Target next;
+	if (++redirectHops > RedirectCache::maxHops || !RedirectCache::parseLocation(stationConnector.location(), next))
 	{
-		delay(100);
+		Serial.printf("Station %d: can't follow redirect %d to '%s'\n", stationNo, redirectHops,
+					  stationConnector.location());
+		return false;
 	}
 
-	if (client.available() < 1)
-		return false;
+	Serial.printf("Station %d redirected (%u, %s) to %s:%u%s\n", stationNo, status,
+				  permanent ? "permanent" : "temporary", next.host, next.port, next.path);
+	redirectsPermanent = redirectsPermanent && permanent;
+	connectTarget = next;
+	stationConnector.start(connectTarget.host, connectTarget.port, connectTarget.path, METADATA);
+	return true;
+}
 
-	// Keep reading until we read two LF bytes in a row.
-	//
-	// The ICY (I Can Yell, a precursor to Shoutcast) format:
-	// In the http response we can look for icy-metaint: XXXX to tell us how far apart
-	// the header information (in bytes) is sent.
+// Move the connection to the station along (never waits). Returns the connector's new state:
+// kAwaitingAudio once the headers are in, kStreaming when the audio starts, kFailed if we
+// have to start again (timed out, refused, ...). Redirects are followed here.
+StationConnector::connectState stationConnectStep(int stationNo)
+{
+	StationConnector::connectState prevState = stationConnector.state();
+	StationConnector::connectState state = stationConnector.step();
+	if (state == prevState)
+	{
+		return state;
+	}
 
-	// Process all responses until we run out of header info (blank header)
-	while (client.available())
+	switch (state)
 	{
-		// Delimiter char is not included in data returned
-		String responseLine = client.readStringUntil('\n');
+	case StationConnector::kAwaitingAudio:
+		Serial.printf("Connected to %s (%s%s)\n",
+					  stationConnector.host(), radioStation[stationNo].friendlyName,
+					  redirectHops || targetFromCache ? " - redirected" : "");
 
-		if (responseLine.indexOf("Status: 200 OK") > 0)
+		// Remember where we ended up for next time, or that the remembered place still works
+		if (redirectHops)
 		{
-			// TODO: we really should check we have a response of 200 before anything else
-			Serial.println("200 - OK response");
-			continue;
+			redirectCache.learned(stationUrlKey, connectTarget, redirectsPermanent);
 		}
-
-		// If we have an EMPTY header (or just a CR) that means we had two linefeeds
-		if (responseLine[0] == (uint8_t)13 || responseLine == "")
+		else if (targetFromCache)
 		{
-			break;
+			redirectCache.succeeded(stationUrlKey);
 		}
 
-		// If the header is not empty process it
-		//Serial.print("HEADER: ");
-		//Serial.println(responseLine);
+		// Buffering levels are in milliseconds, so we need the bit rate (if the station told us)
+		metaDataInterval = stationConnector.metaInterval();
+		bitRate = stationConnector.bitRate();
+		prebuffer.setBitRate(bitRate);
 
-		// Critical value for this whole sketch to work: bytes between "frames"
-		// Sometimes you can't get this first time round so we just reconnect
-		// (Actually it's only BCC Radio 4 that doesn't always give this out)
-		if (responseLine.startsWith("icy-metaint"))
-		{
-			metaDataInterval = responseLine.substring(12).toInt();
-			Serial.printf("NEW Metadata Interval:%d\n", metaDataInterval);
-			continue;
-		}
+		// The audio starts straight after the headers, with the first metadata block metaDataInterval bytes in
+		icyDemuxer.reset(METADATA ? metaDataInterval : 0);
+		break;
 
-		// The bit rate of the transmission (FYI) eye candy
-		if (responseLine.startsWith("icy-br:"))
-		{
-			bitRate = responseLine.substring(7).toInt();
-			Serial.printf("Bit rate:%d\n", bitRate);
-			continue;
-		}
+	case StationConnector::kStreaming:
+	{
+		stationConnector.printTimings();
+
+		// Start watching the new stream, knowing how long a reconnect takes
+		stallWatchdog.setReconnectCostMs(stationConnector.timings().firstAudioMs);
+		stallWatchdog.reset(millis());
 
-		// TODO: Remove this testing override for station 4 (always redirects!)
-		// The URL we used has been redirected
-		if (!redirected && stationNo == 4)
+		const DnsCache::Stats &dns = stationConnector.dnsCache().stats();
+		Serial.printf("DNS cache: %lu hits (%lu stale), %lu misses, %lu dropped, %lums of lookups saved\n",
+					  (unsigned long)dns.hits, (unsigned long)dns.staleHits, (unsigned long)dns.misses,
+					  (unsigned long)dns.forgotten, (unsigned long)dns.savedMs);
+		break;
+	}
+
+	case StationConnector::kFailed:
+		if (stationConnector.failure() == StationConnector::kFailRedirect)
 		{
-			responseLine = "location: http://stream.antenne1.de:80/a1stg/livestream1.aac";
+			if (followRedirect(stationNo))
+			{
+				return stationConnector.state();
+			}
 		}
-
-		if (responseLine.startsWith("location: http://"))
+		else if (targetFromCache && redirectHops == 0 && serverFailed(stationConnector.failure()) &&
+				 redirectCache.failed(stationUrlKey))
 		{
-			getRedirectedStationInfo(responseLine, stationNo);
-			redirected = true;
-			return false;
+			// Next time we try the station's own URL again
+			Serial.printf("Station %d: forgotten where it redirects to\n", stationNo);
 		}
-	}
+		break;
 
-	// If we didn't find required metaDataInterval value in the headers, abort this connection
-	if (metaDataInterval == 0 && METADATA)
-	{
-		Serial.println("NO METADATA INTERVAL DETECTED - RECONNECTING");
-		return false;
+	default:
+		break;
 	}
 
-	// Update the count of bytes until the next metadata interval (used in loop) and exit
-	bytesUntilmetaData = metaDataInterval;
-
-	// All done here
-	return true;
+	return state;
 }
 
 // LITTLEFS card reader (done ONCE in setup)
@@ -564,9 +697,6 @@ void changeStation(int8_t btnValue)
 	// Make button inactive
 	canChangeStn = false;
 
-	// Reset any redirection flag
-	redirected = false;
-
 	// Get the next/prev station (in the list)
 	nextStnNo = currStnNo + btnValue;
 	if (nextStnNo > stationCnt - 1)
@@ -588,178 +718,138 @@ void changeStation(int8_t btnValue)
 	if (prevStnNo != nextStnNo)
 	{
 		prevStnNo = nextStnNo;
-		//player.softReset();
 
-		// Now actually connect to the new URL for the station
-		while (!stationConnect(nextStnNo))
+		// The ingest task does the actual connecting (and stores the new station in EEPROM)
+		ingestCommand command = {kCmdChangeStation, nextStnNo};
+		if (!ingestCommands.send(&command, 100))
 		{
-			checkForStationChange();
-			if (!client.connected())
-			{
-				connectToWifi();
-			}
-		};
+			Serial.println("Station change request dropped (queue full)");
+		}
+	}
 
-		// Next line might not be required for VS051
-		player.switchToMp3Mode();
+	// Button active again
+	canChangeStn = true;
+}
 
-		// Store (new) current station in EEPROM
-		preferences.putUInt("currStnNo", nextStnNo);
-		Serial.printf("Current station now stored: %u\n", nextStnNo);
+// Queue something for loop() to show on screen (called from the ingest task)
+void postUiEvent(uint8_t type, int stationNo, const char *text)
+{
+	uiEvent event;
+	event.type = type;
+	event.stationNo = stationNo;
+	strncpy(event.text, text, sizeof(event.text) - 1);
+	event.text[sizeof(event.text) - 1] = '\0';
 
-		// Button active again
-		canChangeStn = true;
+	// Don't hold up the stream if the screen is behind, it'll catch up with the next one
+	if (!uiEvents.send(&event))
+	{
+		Serial.println("Screen update dropped (queue full)");
 	}
 }
 
-inline bool readMetaData()
+// Update the screen with whatever the ingest task has sent us (called from loop)
+void processUiEvents()
 {
-	// The first byte is going to be the length of the metadata
-	int metaDataLength = client.read();
+	uiEvent event;
 
-	// Usually there is none as track/artist info is only updated when it changes
-	// It may also return the station URL (not necessarily the same as we are using).
-	// Example:
-	//  'StreamTitle='Love Is The Drug - Roxy Music';StreamUrl='https://listenapi.planetradio.co.uk/api9/eventdata/62247302';'
-	if (metaDataLength < 1) // includes -1
+	while (uiEvents.receive(&event))
 	{
-		// Warning sends out about 4 times per second!
-		//Serial.println("No metadata to read.");
-		return "";
-	}
+		switch (event.type)
+		{
+		case kUiStationChanged:
+			displayStationName(radioStation[event.stationNo].friendlyName);
+			lvglUpdateGenre(radioStation[event.stationNo].genre);
+			lvglUpdateTrackInfo("", "", "");
+			drawBufferLevel(0, true);
+			break;
 
-	// The actual length is 16 times bigger to allow from 16 up to 4080 bytes (255 * 16) of metadata
-	metaDataLength = (metaDataLength * 16);
-	Serial.printf("Metadata block size: %d\n", metaDataLength);
+		case kUiTrackInfo:
+			displayTrackArtist(event.text);
+			break;
+		}
+	}
+}
 
-	// Wait for the entire MetaData to become available in the stream
-	Serial.println("Waiting for METADATA");
-	while (client.available() < metaDataLength)
+// FNV-1a over the block up to its padding
+static uint32_t metaDataHash(const char *text, size_t len)
+{
+	uint32_t hash = 2166136261UL;
+	for (size_t cnt = 0; cnt < len && text[cnt]; cnt++)
 	{
-		delayMicroseconds(1);
+		hash = (hash ^ (uint8_t)text[cnt]) * 16777619UL;
 	}
+	return hash;
+}
 
-	// Temporary buffer for the metadata
-	char metaDataBuffer[metaDataLength + 1];
+// A complete metadata block has been taken out of the stream (called by the ICY demuxer)
+void handleMetaData(char *metaDataBuffer, size_t metaDataLength, void *context)
+{
+	(void)context;
 
-	// Initialise this temp buffer
-	memset(metaDataBuffer, 0, metaDataLength + 1);
+	// Stations resend the same title over and over, skip it before doing anything else with it
+	uint32_t hash = metaDataHash(metaDataBuffer, metaDataLength);
+	if (haveMetaDataHash && hash == lastMetaDataHash && metaDataLength == lastMetaDataLength)
+	{
+		metadataStats.suppressed++;
+		return;
+	}
 
-	// Populate it from the internet stream
-	client.readBytes((char *)metaDataBuffer, metaDataLength);
+	// Usually there is none as track/artist info is only updated when it changes
+	// It may also return the station URL (not necessarily the same as we are using).
+	// Example:
+	//  'StreamTitle='Love Is The Drug - Roxy Music';StreamUrl='https://listenapi.planetradio.co.uk/api9/eventdata/62247302';'
+	Serial.printf("Metadata block size: %u\n", (unsigned)metaDataLength);
 	Serial.print("MetaData:");
 	Serial.println(metaDataBuffer);
 
-	for (auto cnt = 0; cnt < metaDataLength; cnt++)
+	for (size_t cnt = 0; cnt < metaDataLength; cnt++)
 	{
 		if (metaDataBuffer[cnt] > 0 && metaDataBuffer[cnt] < 8)
 		{
 			Serial.printf("Corrupt METADATA found:%02X\n", metaDataBuffer[cnt]);
-
-			// Terminate the string right after the corrupt char so we can print it
-			metaDataBuffer[cnt + 1] = '\0';
-			Serial.println(metaDataBuffer);
-			return false;
+			ingestLoop.outOfSync();
+			return;
 		}
 	}
 
-	// Extract track Title/Artist from this string
-	char *startTrack = NULL;
-	char *endTrack = NULL;
-	std::string streamArtistTitle = "";
+	lastMetaDataHash = hash;
+	lastMetaDataLength = metaDataLength;
+	haveMetaDataHash = true;
+	metadataStats.applied++;
 
-	startTrack = strstr(metaDataBuffer, "StreamTitle");
-	if (startTrack != NULL)
+	// Split it up where it is, the values point into the demuxer's buffer
+	IcyMetadata metaData;
+	metaData.parse(metaDataBuffer, metaDataLength);
+	if (metaData.malformed() || metaData.dropped())
 	{
-		// We have found the streamtitle so just skip over "StreamTitle="
-		startTrack += 12;
-
-		// Now look for the end marker
-		endTrack = strstr(startTrack, ";");
-		if (endTrack == NULL)
-		{
-			// No end (very weird), so just set it as the string length
-			endTrack = (char *)startTrack + strlen(startTrack);
-		}
-
-		// There might be an opening and closing quote so skip over those (reduce data width) too
-		if (startTrack[0] == '\'')
-		{
-			startTrack += 1;
-			endTrack -= 1;
-		}
-
-		// We MUST terminate the 'string' (character array) with a null to denote the end
-		endTrack[0] = '\0';
-
-		// Extract the data by adjusting pointers
-		ptrdiff_t startIdx = startTrack - metaDataBuffer;
-		ptrdiff_t endIdx = endTrack - metaDataBuffer;
-		std::string streamInfo(metaDataBuffer, startIdx, endIdx);
-		streamArtistTitle = streamInfo;
-
-		// Debug only if there is something to see
-		if (streamArtistTitle != "")
-			Serial.printf("%s\n", streamArtistTitle.c_str());
-
-		// Always output the Artist/Track information even if just to clear it from screen
-		displayTrackArtist(toTitle(streamArtistTitle));
+		Serial.printf("Metadata: %u pairs, %u dropped%s\n", (unsigned)metaData.count(),
+					  (unsigned)metaData.dropped(), metaData.malformed() ? ", malformed" : "");
 	}
 
-	// All done
-	return true;
-}
-
-// Our streaming station has been 'redirected' to another URL
-// The header will look like: Location: http://<new host / path>[:<port>]
-void getRedirectedStationInfo(String header, int currStationNo)
-{
-	Serial.println("--------------------------------------");
-	Serial.println(" Extracting redirection information");
-	Serial.println("--------------------------------------");
-
-	// Placeholders for the new host/path
-	String newHost = "";
-	String newPath = "";
-
-	// We'll assume the port is 80 unless we find one in the host name
-	int newPort = 80;
-
-	// Skip the "redirected http://" bit at the front
-	header = header.substring(17);
-	Serial.printf("Redirecting to: %s\n", header.c_str());
-
-	// Split the header into host and path constituents
-	int pathDelimiter = header.indexOf("/");
-	if (pathDelimiter > 0)
+	const IcyMetadata::Span *streamUrl = metaData.streamUrl();
+	if (streamUrl && !streamUrl->empty())
 	{
-		newPath = header.substring(pathDelimiter);
-		newHost = header.substring(0, pathDelimiter);
+		Serial.printf("StreamUrl: %s\n", streamUrl->text);
 	}
-	// Look to split host into host and port number
-	// Example: stream/myradio.de:8080
-	int portDelimiter = newHost.indexOf(":");
-	if (portDelimiter > 0)
-	{
-		newPort = newHost.substring(portDelimiter + 1).toInt();
 
-		// Adjust the host name to exclude the port information
-		newHost = newHost.substring(0, portDelimiter);
-	}
+	// Extract track Title/Artist
+	const IcyMetadata::Span *streamTitle = metaData.streamTitle();
+	if (streamTitle)
+	{
+		// Debug only if there is something to see
+		if (!streamTitle->empty())
+			Serial.printf("%s\n", streamTitle->text);
 
-	// Store redirect target for this session (reverts on reboot)
-	Serial.println("New address: " + newHost + newPath + ":" + newPort);
-	strncpy(redirectedHost, newHost.c_str(), sizeof(redirectedHost) - 1);
-	redirectedHost[sizeof(redirectedHost) - 1] = '\0';
-	strncpy(redirectedPath, newPath.c_str(), sizeof(redirectedPath) - 1);
-	redirectedPath[sizeof(redirectedPath) - 1] = '\0';
-	redirectedPort = newPort;
+		// Some track titles are ALL IN UPPER CASE, so ugly, so let's convert them (on a copy the size
+		// of the screen's, as Latin-1 titles grow when they become UTF-8)
+		char title[sizeof(uiEvent::text)];
+		TitleCase::normaliseInto(title, sizeof(title), streamTitle->text, streamTitle->len);
 
-	(void)currStationNo;
-	return;
+		// Always output the Artist/Track information even if just to clear it from screen
+		postUiEvent(kUiTrackInfo, -1, title);
+	}
 }
 
-
 // Change station button / screen button pressed?
 void checkForStationChange()
 {
@@ -785,7 +875,7 @@ void checkForStationChange()
 			if (!digitalRead(tftTouchedPin) && canChangeStn)
 			{
 				//Serial.println("TFT Touch!");
-				boolean btnPressed = tft.getTouch(&x, &y, 50U);
+				boolean btnPressed = readTouch(&x, &y, 50U);
 
 				//Serial.printf("Prev: x=%d to %d, y=%d to %d\n", PREV_BUTTON_X, PREV_BUTTON_X + PREV_BUTTON_W, PREV_BUTTON_Y, PREV_BUTTON_Y + PREV_BUTTON_H);
 				//Serial.printf("Next: x=%d to %d, y=%d to %d\n", NEXT_BUTTON_X, NEXT_BUTTON_X + NEXT_BUTTON_W, NEXT_BUTTON_Y, NEXT_BUTTON_Y + NEXT_BUTTON_H);
@@ -801,6 +891,7 @@ void checkForStationChange()
 					if (getNextButtonPress(x, y))
 					{
 						changeStation(+1);
+						SpiBusClaim claim(spiBus, kBusDisplay);
 						nextBtn.drawButton(false);
 					}
 					else
@@ -809,6 +900,7 @@ void checkForStationChange()
 						if (getPrevButtonPress(x, y))
 						{
 							changeStation(-1);
+							SpiBusClaim claim(spiBus, kBusDisplay);
 							prevBtn.drawButton(false);
 						}
 					}
@@ -28,8 +28,52 @@
 // Your preferred TFT / LED screen definition here
 // As I'm using the TFT_eSPI from Bodmer they are all in User_Setup.h
 
-// Circular buffer - ESP32 built in (hacked by me to use PSRAM)
-#include <cbuf.h>
+// Lock-free single producer/single consumer ring buffer (allocated in PSRAM)
+#include "audioRingBuffer.h"
+
+// Tasks and queues (FreeRTOS on the ESP32, std::thread on the host)
+#include "taskPort.h"
+
+// Separates the ICY metadata from the audio
+#include "icyDemuxer.h"
+
+// Splits the metadata into its key='value'; pairs
+#include "icyMetadata.h"
+
+// Track titles into UTF-8 and title case
+#include "titleCase.h"
+
+// Start/resume buffering levels
+#include "prebufferController.h"
+
+// Spots a station that has stopped sending in time to reconnect
+#include "stallWatchdog.h"
+
+// Reads the stream into the ring buffer (WiFiClient here, canned bytes on the host)
+#include "ingestLoop.h"
+
+// Ring buffer fill/underrun statistics
+#include "bufferHealth.h"
+
+// Codec, bit rate and drain rate as the VS1053 reports them
+#include "decoderMonitor.h"
+
+// Shares the SPI bus between the VS1053, touch and the screen, audio first
+#include "spiBusArbiter.h"
+#include "arbitratedTransport.h"
+
+// Where the audio goes: the VS1053, or a stand-in for it
+#include "audioSink.h"
+#include "vs1053Sink.h"
+
+// Connects to a station a step at a time, so a station change can cut it short
+#include "stationConnector.h"
+
+// Where stations that redirect us really are
+#include "redirectCache.h"
+
+// When to try again after losing a station
+#include "reconnectScheduler.h"
 
 // EEPROM writing routines (eg: remembers previous radio stn)
 extern Preferences preferences;
@@ -82,50 +126,150 @@ extern bool METADATA;
 
 // The number of bytes between metadata (title track)
 extern uint16_t metaDataInterval; //bytes
-extern uint16_t bytesUntilmetaData;
 extern int bitRate;
-extern bool redirected;
 extern bool volumeMax;
 
-// Dedicated 32-byte buffer for VS1053 aligned on 4-byte boundary for efficiency
-extern uint8_t mp3buff[32] __attribute__((aligned(4)));
-
 // Circular "Read Buffer" to stop stuttering on some stations
 #ifdef BOARD_HAS_PSRAM
 #define CIRCULARBUFFERSIZE 150000 // Divide by 32 to see how many 2mS samples this can store
 #else
 #define CIRCULARBUFFERSIZE 10000
 #endif
-extern cbuf circBuffer;
-#define streamingCharsMax 32
+extern AudioRingBuffer circBuffer;
+
+// Decides when there is enough buffered (in milliseconds of audio) to start/resume playing
+extern PrebufferController prebuffer;
+
+// Arrival rate against drain rate, gives up on the connection while the buffer covers a new one
+extern StallWatchdog stallWatchdog;
+
+// Underruns, fill levels and rates for the ring buffer (since the last station change)
+extern BufferHealth bufferHealth;
 
-// Internet stream buffer that we copy in chunks to the ring buffer
-extern char readBuffer[100] __attribute__((aligned(4)));
+// What the VS1053 says it is playing, polled by the player task
+extern DecoderMonitor decoderMonitor;
+
+// Takes the metadata (track/artist) out of the stream before it goes into the ring buffer
+extern IcyDemuxer icyDemuxer;
+
+// The WiFiClient as the ingest loop sees it
+class WiFiStreamSource : public StreamSource
+{
+public:
+	WiFiStreamSource(WiFiClient &client) : client(client) {}
+
+	int available() override { return client.available(); }
+	int read(uint8_t *data, size_t len) override { return client.read(data, len); }
+	bool connected() override { return client.connected(); }
+
+private:
+	WiFiClient &client;
+};
+
+// Arduino time for the ingest loop
+class ArduinoClock : public IngestClock
+{
+public:
+	uint32_t nowMs() override { return millis(); }
+	uint32_t nowMicros() override { return micros(); }
+};
+
+// Reads the stream into the ring buffer and watches over it, see ingestLoop.h
+extern IngestLoop ingestLoop;
+
+// Metadata blocks we acted on, and repeats of the last one that we didn't
+struct metadataStatistics
+{
+	uint32_t applied;	 // parsed and sent to the screen
+	uint32_t suppressed; // same as the last one, dropped unparsed
+};
+extern metadataStatistics metadataStats;
+
+// The last metadata block we acted on, so repeats of it can be dropped (cleared on a station change)
+extern uint32_t lastMetaDataHash;
+extern size_t lastMetaDataLength;
+extern bool haveMetaDataHash;
+
+// How efficiently we are getting the audio out to the VS1053
+struct feederStatistics
+{
+	uint32_t transactions; // SDI (SPI) transactions, one per burst of chunks
+	uint32_t bytesSent;	   // audio bytes sent in them
+	uint32_t spiMicros;	   // time spent in them
+};
+extern feederStatistics feederStats;
+
+// Who gets the SPI bus next, and how long each user holds it
+extern SpiBusArbiter spiBus;
+extern ArbitratedTransport playerBus;
+
+// The ingest task owns the WiFiClient, so the UI (loop) asks it to do things via a queue...
+enum ingestCommandType
+{
+	kCmdChangeStation, // connect to stationNo
+};
+
+struct ingestCommand
+{
+	uint8_t type;
+	int stationNo;
+};
+extern MessageQueue ingestCommands;
+
+// ...and it tells the UI what to show via another queue
+enum uiEventType
+{
+	kUiStationChanged, // clear the screen down for stationNo
+	kUiTrackInfo,	   // text is the new Artist - Track
+};
+
+struct uiEvent
+{
+	uint8_t type;
+	int stationNo;
+	char text[256];
+};
+extern MessageQueue uiEvents;
 
 // Wiring of VS1053 board (SPI connected in a standard way) on ESP32 only
 #define VS1053_CS 32
 #define VS1053_DCS 33
 #define VS1053_DREQ 35
+
+// Build with -DVS1053_DMA to feed the VS1053 with queued DMA transactions instead.
+// That needs the VS1053 on its own bus (HSPI), away from the screen on VSPI. If DMA
+// can't be set up, the Arduino SPI class drives that same bus instead. Nothing locks
+// that bus, so once set up only the player task may use the VS1053 (see requestVolume()).
+#ifdef VS1053_DMA
+#include <VS1053DmaTransport.h>
+#define VS1053_SCK 14
+#define VS1053_MISO 12
+#define VS1053_MOSI 13
+extern VS1053DmaTransport playerTransport;
+extern SPIClass playerSpi;
+extern VS1053SpiTransport playerSpiTransport;
+#endif
 #define VOLUME 100 // treble/bass works better if NOT 100 here
 
 // WiFi specific defines
 #define WIFITIMEOUTSECONDS 20
 
 // Forward declarations of functions TODO: clean up & describe FIXME:
-bool stationConnect(int station_no);
+void stationConnectBegin(int stationNo, bool resume = false);
+StationConnector::connectState stationConnectStep(int stationNo);
 std::string readLITTLEFSInfo(char *itemRequired);
 std::string getWiFiPassword();
 std::string getSSID();
 void connectToWifi();
+void startWifiReconnect();
 const char *wl_status_to_string(wl_status_t status);
 void initDisplay();
 bool loadStationsFromLittleFS(const char *path = "/stations.xml");
 void changeStation(int8_t plusOrMinus);
-bool _GLIBCXX_ALWAYS_INLINE readMetaData();
-void getRedirectedStationInfo(String header, int currStationNo);
+void handleMetaData(char *metaDataBuffer, size_t metaDataLength, void *context);
 void setupDisplayModule();
 void displayStationName(const char *stationName);
-void displayTrackArtist(std::string);
+void displayTrackArtist(char *trackArtist);
 
 bool getNextButtonPress(uint16_t x, uint16_t y);
 bool getPrevButtonPress(uint16_t x, uint16_t y);
@@ -137,13 +281,24 @@ void drawBrightButton(bool invert);
 void drawDimButton(bool invert);
 void drawMuteBitmap(bool isMuted);
 
+bool readTouch(uint16_t *x, uint16_t *y, uint16_t threshold = 600);
 void getBrightButtonPress();
 void getDimButtonPress();
 
-std::string toTitle(std::string s, const std::locale &loc = std::locale());
 void drawBufferLevel(size_t bufferLevel, bool override = false);
 void checkForStationChange();
-void populateRingBuffer();
+void postUiEvent(uint8_t type, int stationNo, const char *text);
+void processUiEvents();
+void printIngestStats();
+void printBufferHealth();
+void printFeederStats();
+void printSpiBusStats();
+void printDecoderStatus();
+uint32_t drainByteRate();
+uint32_t bufferedMs(size_t bytes);
+void wakePlayMusicTask();
+void requestDecoderFlush();
+void requestVolume(uint8_t volume);
 
 void taskSetup();
 
@@ -152,10 +307,19 @@ void taskSetup();
 // MP3 decoder
 extern VS1053 player;
 
+// The playback path only talks to this, normally the VS1053
+extern AudioSink *audioSink;
+
 // Instantiate screen (object) using hardware SPI. Defaults to 320H x 240W
 extern TFT_eSPI tft;
 
 // Start the WiFi client here
 extern WiFiClient client;
 
+// Gets the client connected to a station, see stationConnectBegin()
+extern StationConnector stationConnector;
+
+// Redirect targets learned per station, the permanent ones are kept in NVS
+extern RedirectCache redirectCache;
+
 #endif
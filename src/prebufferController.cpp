@@ -0,0 +1,178 @@
+#include "prebufferController.h"
+
+namespace {
+// Levels before any jitter or underrun allowance
+constexpr uint32_t kStartMs = 1500;
+constexpr uint32_t kRecoveryMs = 3000;
+
+// Extra wait added per underrun on the same station, and the most we'll add
+constexpr uint32_t kUnderrunPenaltyMs = 1000;
+constexpr uint32_t kMaxPenaltyMs = 5000;
+
+// Assume 128kbps until we know better
+constexpr uint32_t kDefaultByteRate = 128 * 1000 / 8;
+
+// Arrival rate is measured over windows this long
+constexpr uint32_t kRateWindowMs = 2000;
+
+// The VS1053 takes 32 bytes at a time, less than that and we've run dry
+constexpr size_t kMinChunk = 32;
+} // namespace
+
+PrebufferController::PrebufferController()
+	: capacity(0), decoderByteRate(0), headerByteRate(0), arrivalByteRate(0), jitter(0), stationStartMs(0), resetPending(false),
+	  lastArrivalMs(0), meanGapMs(0), rateWindowStartMs(0), rateWindowBytes(0),
+	  currentState(kPrebuffering), lastTimeToAudio(0), totalUnderruns(0), underrunsThisStation(0), resets(0)
+{
+}
+
+void PrebufferController::begin(size_t bufferCapacity)
+{
+	capacity = bufferCapacity;
+}
+
+void PrebufferController::reset(uint32_t nowMs)
+{
+	decoderByteRate.store(0, std::memory_order_relaxed);
+	headerByteRate.store(0, std::memory_order_relaxed);
+	arrivalByteRate.store(0, std::memory_order_relaxed);
+	jitter.store(0, std::memory_order_relaxed);
+	stationStartMs.store(nowMs, std::memory_order_relaxed);
+
+	lastArrivalMs = 0;
+	meanGapMs = 0;
+	rateWindowStartMs = nowMs;
+	rateWindowBytes = 0;
+
+	// The player task picks this up on its next update()
+	resetPending.store(true, std::memory_order_release);
+}
+
+void PrebufferController::setBitRate(int kbps)
+{
+	headerByteRate.store(kbps > 0 ? (uint32_t)kbps * 1000 / 8 : 0, std::memory_order_relaxed);
+}
+
+void PrebufferController::setDecoderByteRate(uint32_t bytesPerSec)
+{
+	decoderByteRate.store(bytesPerSec, std::memory_order_relaxed);
+}
+
+void PrebufferController::onArrival(uint32_t nowMs, size_t bytes)
+{
+	if (bytes == 0)
+	{
+		return;
+	}
+
+	// Jitter: smoothed deviation of the gap between arrivals from the average gap
+	if (lastArrivalMs)
+	{
+		uint32_t gap = nowMs - lastArrivalMs;
+		meanGapMs = meanGapMs ? (meanGapMs * 7 + gap) / 8 : gap;
+		uint32_t deviation = gap > meanGapMs ? gap - meanGapMs : meanGapMs - gap;
+		uint32_t j = jitter.load(std::memory_order_relaxed);
+		jitter.store((j * 7 + deviation) / 8, std::memory_order_relaxed);
+	}
+	lastArrivalMs = nowMs;
+
+	// Arrival rate: bytes over a window, smoothed across windows
+	rateWindowBytes += bytes;
+	uint32_t elapsed = nowMs - rateWindowStartMs;
+	if (elapsed >= kRateWindowMs)
+	{
+		uint32_t rate = (uint32_t)((uint64_t)rateWindowBytes * 1000 / elapsed);
+		uint32_t prev = arrivalByteRate.load(std::memory_order_relaxed);
+		arrivalByteRate.store(prev ? (prev * 3 + rate) / 4 : rate, std::memory_order_relaxed);
+		rateWindowStartMs = nowMs;
+		rateWindowBytes = 0;
+	}
+}
+
+uint32_t PrebufferController::byteRate() const
+{
+	uint32_t rate = decoderByteRate.load(std::memory_order_relaxed);
+	if (!rate)
+	{
+		rate = headerByteRate.load(std::memory_order_relaxed);
+	}
+	if (!rate)
+	{
+		rate = arrivalByteRate.load(std::memory_order_relaxed);
+	}
+	return rate ? rate : kDefaultByteRate;
+}
+
+uint32_t PrebufferController::bytesToMs(size_t bytes) const
+{
+	return (uint32_t)((uint64_t)bytes * 1000 / byteRate());
+}
+
+size_t PrebufferController::msToBytes(uint32_t ms) const
+{
+	size_t bytes = (size_t)((uint64_t)ms * byteRate() / 1000);
+
+	// Never wait for more than 3/4 of the buffer, at a high bit rate it might never get there
+	size_t limit = capacity / 4 * 3;
+	if (limit && bytes > limit)
+	{
+		bytes = limit;
+	}
+	return bytes < kMinChunk ? kMinChunk : bytes;
+}
+
+uint32_t PrebufferController::startLevelMs() const
+{
+	uint32_t penalty = underrunsThisStation * kUnderrunPenaltyMs;
+	if (penalty > kMaxPenaltyMs)
+	{
+		penalty = kMaxPenaltyMs;
+	}
+	return kStartMs + penalty + 2 * jitterMs();
+}
+
+uint32_t PrebufferController::recoveryLevelMs() const
+{
+	return startLevelMs() + (kRecoveryMs - kStartMs);
+}
+
+bool PrebufferController::update(uint32_t nowMs, size_t bufferedBytes)
+{
+	// New station? Start buffering again from scratch
+	if (resetPending.exchange(false, std::memory_order_acquire))
+	{
+		currentState = kPrebuffering;
+		lastTimeToAudio = 0;
+		underrunsThisStation = 0;
+		resets++;
+	}
+
+	switch (currentState)
+	{
+	case kPrebuffering:
+		if (bufferedBytes >= msToBytes(startLevelMs()))
+		{
+			currentState = kPlaying;
+			lastTimeToAudio = nowMs - stationStartMs.load(std::memory_order_relaxed);
+		}
+		break;
+
+	case kPlaying:
+		if (bufferedBytes < kMinChunk)
+		{
+			currentState = kRebuffering;
+			totalUnderruns++;
+			underrunsThisStation++;
+		}
+		break;
+
+	case kRebuffering:
+		if (bufferedBytes >= msToBytes(recoveryLevelMs()))
+		{
+			currentState = kPlaying;
+		}
+		break;
+	}
+
+	return currentState == kPlaying;
+}
@@ -0,0 +1,161 @@
+#include <string.h>
+
+#include "reconnectScheduler.h"
+
+namespace
+{
+	// First retry, second retry (doubling from there) and the most we wait
+	const ReconnectScheduler::Policy kPolicies[ReconnectScheduler::kCauses] = {
+		{4000, 4000, 30000}, // WiFi down: give the access point time to associate each go
+		{1000, 2000, 60000}, // Server refused: back off hard, they may be overloaded
+		{500, 1000, 15000},	 // Stream lost: quickly back, there's audio in the buffer
+	};
+
+	// Aim to be streaming again with this fraction of the runway left
+	const uint32_t kRunwayDivisor = 4;
+
+	// ...but only for this many failures in a row, after that the back off wins
+	const uint32_t kRunwayRetries = 3;
+}
+
+ReconnectScheduler::ReconnectScheduler()
+	: pending(false), retryAt(0), outage(false), outageStart(0), failures(0), outageAttempts(0), up(false),
+	  upSince(0), cause(kCauseStreamLost), random(2463534242UL)
+{
+	memset(&counters, 0, sizeof(counters));
+}
+
+void ReconnectScheduler::seed(uint32_t seed)
+{
+	random = seed ? seed : 2463534242UL;
+}
+
+const ReconnectScheduler::Policy &ReconnectScheduler::policy(reconnectCause cause)
+{
+	return kPolicies[cause];
+}
+
+uint32_t ReconnectScheduler::failed(reconnectCause why, uint32_t nowMs, uint32_t runwayMs)
+{
+	// A connection that didn't last keeps the count going, so does a change of cause
+	up = false;
+	cause = why;
+
+	if (!outage)
+	{
+		outage = true;
+		outageStart = nowMs;
+		outageAttempts = 0;
+	}
+
+	const Policy &p = kPolicies[why];
+	uint32_t delay;
+	if (failures == 0)
+	{
+		delay = p.firstDelayMs;
+	}
+	else
+	{
+		delay = p.baseDelayMs;
+		for (uint32_t doubling = 1; doubling < failures && delay < p.maxDelayMs; doubling++)
+		{
+			delay *= 2;
+		}
+		if (delay > p.maxDelayMs)
+		{
+			delay = p.maxDelayMs;
+		}
+	}
+
+	// Equal jitter: somewhere between half and all of it
+	if (delay > 1)
+	{
+		delay = delay / 2 + nextRandom() % (delay / 2 + 1);
+	}
+
+	// Don't sit out the first retries while the buffer runs dry
+	if (runwayMs && failures < kRunwayRetries && delay > runwayMs / kRunwayDivisor)
+	{
+		delay = runwayMs / kRunwayDivisor;
+	}
+	if (delay < minDelayMs)
+	{
+		delay = minDelayMs;
+	}
+
+	failures++;
+	outageAttempts++;
+	counters.attempts[why]++;
+	pending = true;
+	retryAt = nowMs + delay;
+	return delay;
+}
+
+bool ReconnectScheduler::streaming(uint32_t nowMs)
+{
+	if (!up)
+	{
+		up = true;
+		upSince = nowMs;
+	}
+	if (nowMs - upSince < stableMs || (failures == 0 && !outage))
+	{
+		return false;
+	}
+
+	pending = false;
+	failures = 0;
+	if (!outage)
+	{
+		return false;
+	}
+
+	// It was over when the stream came back, not now we believe it
+	outage = false;
+	uint32_t lasted = upSince - outageStart;
+	counters.outages++;
+	counters.downtimeMs += lasted;
+	counters.lastOutageMs = lasted;
+	counters.lastAttempts = outageAttempts;
+	if (lasted > counters.longestOutageMs)
+	{
+		counters.longestOutageMs = lasted;
+	}
+	return true;
+}
+
+void ReconnectScheduler::abandon()
+{
+	if (outage)
+	{
+		counters.abandoned++;
+	}
+	pending = false;
+	outage = false;
+	up = false;
+	failures = 0;
+}
+
+const char *ReconnectScheduler::causeName(reconnectCause cause)
+{
+	switch (cause)
+	{
+	case kCauseWifiDown:
+		return "WiFi down";
+	case kCauseServerRefused:
+		return "server refused";
+	case kCauseStreamLost:
+		return "stream lost";
+	default:
+		return "?";
+	}
+}
+
+// xorshift32, plenty for jitter
+uint32_t ReconnectScheduler::nextRandom()
+{
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	return random;
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "redirectCache.h"
+
+RedirectCache::RedirectCache()
+	: useCounter(0), changed(false)
+{
+	memset(entries, 0, sizeof(entries));
+	memset(&counters, 0, sizeof(counters));
+}
+
+// FNV-1a over host, port and path
+uint32_t RedirectCache::keyFor(const char *host, uint16_t port, const char *path)
+{
+	uint32_t hash = 2166136261UL;
+	for (const char *c = host; *c; c++)
+	{
+		hash = (hash ^ (uint8_t)*c) * 16777619UL;
+	}
+	hash = (hash ^ (port & 0xFF)) * 16777619UL;
+	hash = (hash ^ (port >> 8)) * 16777619UL;
+	for (const char *c = path; *c; c++)
+	{
+		hash = (hash ^ (uint8_t)*c) * 16777619UL;
+	}
+	return hash;
+}
+
+bool RedirectCache::parseLocation(const char *url, Target &target)
+{
+	if (strncasecmp(url, "http://", 7) != 0)
+	{
+		return false;
+	}
+	const char *host = url + 7;
+
+	// Host runs to the port or the path, whichever comes first
+	size_t hostLen = strcspn(host, ":/");
+	if (hostLen == 0 || hostLen >= sizeof(target.host))
+	{
+		return false;
+	}
+	memcpy(target.host, host, hostLen);
+	target.host[hostLen] = '\0';
+
+	const char *rest = host + hostLen;
+	target.port = 80;
+	if (*rest == ':')
+	{
+		char *end;
+		long port = strtol(rest + 1, &end, 10);
+		if (end == rest + 1 || port <= 0 || port > 65535)
+		{
+			return false;
+		}
+		target.port = (uint16_t)port;
+		rest = end;
+	}
+
+	const char *path = *rest == '/' ? rest : "/";
+	if (strlen(path) >= sizeof(target.path))
+	{
+		return false;
+	}
+	strcpy(target.path, path);
+	return true;
+}
+
+bool RedirectCache::find(uint32_t key, Target &target, bool &permanent)
+{
+	Entry *entry = lookup(key);
+	if (!entry)
+	{
+		return false;
+	}
+
+	target = entry->target;
+	permanent = entry->permanent;
+	entry->lastUsed = ++useCounter;
+	counters.hits++;
+	return true;
+}
+
+void RedirectCache::learned(uint32_t key, const Target &target, bool permanent)
+{
+	Entry *entry = slotFor(key);
+	bool same = entry->valid && entry->permanent == permanent && entry->target.port == target.port &&
+				strcmp(entry->target.host, target.host) == 0 && strcmp(entry->target.path, target.path) == 0;
+	if (!same)
+	{
+		counters.learned++;
+		// Saved set changes if this is permanent, or it replaces (or evicts) one that was
+		if (permanent || (entry->valid && entry->permanent))
+		{
+			changed = true;
+		}
+	}
+
+	entry->key = key;
+	entry->target = target;
+	entry->permanent = permanent;
+	entry->failures = 0;
+	entry->lastUsed = ++useCounter;
+	entry->valid = true;
+}
+
+void RedirectCache::succeeded(uint32_t key)
+{
+	Entry *entry = lookup(key);
+	if (entry)
+	{
+		entry->failures = 0;
+	}
+}
+
+bool RedirectCache::failed(uint32_t key)
+{
+	Entry *entry = lookup(key);
+	if (!entry || ++entry->failures < maxFailures)
+	{
+		return false;
+	}
+
+	entry->valid = false;
+	if (entry->permanent)
+	{
+		changed = true;
+	}
+	counters.invalidated++;
+	return true;
+}
+
+size_t RedirectCache::savePermanent(SavedEntry *out, size_t max) const
+{
+	// Newest first, so if there are more than we keep it's the oldest that go
+	size_t count = 0;
+	uint32_t below = UINT32_MAX;
+	while (count < max)
+	{
+		const Entry *newest = nullptr;
+		for (size_t i = 0; i < maxEntries; i++)
+		{
+			const Entry &entry = entries[i];
+			if (entry.valid && entry.permanent && entry.lastUsed < below &&
+				(!newest || entry.lastUsed > newest->lastUsed))
+			{
+				newest = &entry;
+			}
+		}
+		if (!newest)
+		{
+			break;
+		}
+
+		out[count].key = newest->key;
+		out[count].target = newest->target;
+		below = newest->lastUsed;
+		count++;
+	}
+	changed = false;
+	return count;
+}
+
+void RedirectCache::loadPermanent(const SavedEntry *in, size_t count)
+{
+	// Oldest first, so the newest ends up the most recently used
+	for (size_t i = count; i-- > 0;)
+	{
+		const Target &target = in[i].target;
+		if (!memchr(target.host, '\0', sizeof(target.host)) || !memchr(target.path, '\0', sizeof(target.path)) ||
+			target.host[0] == '\0')
+		{
+			continue;
+		}
+
+		Entry *entry = slotFor(in[i].key);
+		entry->key = in[i].key;
+		entry->target = target;
+		entry->permanent = true;
+		entry->failures = 0;
+		entry->lastUsed = ++useCounter;
+		entry->valid = true;
+	}
+}
+
+RedirectCache::Entry *RedirectCache::lookup(uint32_t key)
+{
+	for (size_t i = 0; i < maxEntries; i++)
+	{
+		if (entries[i].valid && entries[i].key == key)
+		{
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+// The entry for this key, else an empty one, else the least recently used
+RedirectCache::Entry *RedirectCache::slotFor(uint32_t key)
+{
+	Entry *entry = lookup(key);
+	if (entry)
+	{
+		return entry;
+	}
+
+	Entry *victim = &entries[0];
+	for (size_t i = 0; i < maxEntries; i++)
+	{
+		if (!entries[i].valid)
+		{
+			return &entries[i];
+		}
+		if (entries[i].lastUsed < victim->lastUsed)
+		{
+			victim = &entries[i];
+		}
+	}
+	return victim;
+}
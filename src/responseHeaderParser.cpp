@@ -0,0 +1,305 @@
+#include <string.h>
+#include <strings.h>
+
+#include "responseHeaderParser.h"
+
+ResponseHeaderParser::ResponseHeaderParser()
+{
+	reset();
+}
+
+void ResponseHeaderParser::reset()
+{
+	state = kStatusLine;
+	memset(&found, 0, sizeof(found));
+	lineLen = 0;
+	lineTooLong = false;
+	atLineStart = true;
+	lastWasCR = false;
+	bareCR = false;
+	blankLineCR = false;
+	folding = false;
+	lines = 0;
+	truncated = 0;
+	status[0] = '\0';
+}
+
+ResponseHeaderParser::parseResult ResponseHeaderParser::feed(char c)
+{
+	if (state == kDone)
+	{
+		return kComplete;
+	}
+	if (state == kFailed)
+	{
+		return kBadStatus;
+	}
+
+	// CRLF is one line end, not two
+	if (c == '\n' && lastWasCR)
+	{
+		lastWasCR = false;
+		if (blankLineCR)
+		{
+			state = kDone;
+			return kComplete;
+		}
+		return kNeedMore;
+	}
+
+	// A CR on its own ends lines on this server, so the CR of the blank line is the last byte
+	if (lastWasCR)
+	{
+		bareCR = true;
+	}
+	lastWasCR = c == '\r';
+	if (c == '\r' || c == '\n')
+	{
+		return endOfLine(c);
+	}
+
+	// First byte of a line: either a folded continuation of the last one, or the
+	// last one is finished with
+	if (atLineStart)
+	{
+		atLineStart = false;
+		if (lineLen > 0 && state == kHeaderLines && (c == ' ' || c == '\t'))
+		{
+			folding = true;
+			return kNeedMore;
+		}
+		lineComplete();
+		if (state == kFailed)
+		{
+			return kBadStatus;
+		}
+	}
+
+	// Folded lines are joined on with a single space
+	if (folding)
+	{
+		if (c == ' ' || c == '\t')
+		{
+			return kNeedMore;
+		}
+		folding = false;
+		append(' ');
+	}
+
+	append(c);
+
+	// An HTML page (or anything else) without a newline in it fails as soon as we can tell
+	if (state == kStatusLine && !couldBeStatusLine())
+	{
+		state = kFailed;
+		return kBadStatus;
+	}
+	return kNeedMore;
+}
+
+ResponseHeaderParser::parseResult ResponseHeaderParser::endOfLine(char c)
+{
+	// Just the end of a line with something on it, it might yet be folded (but not the
+	// status line, that is checked now)
+	if (!atLineStart)
+	{
+		atLineStart = true;
+		folding = false;
+		if (state == kStatusLine)
+		{
+			lineComplete();
+			if (state == kFailed)
+			{
+				return kBadStatus;
+			}
+		}
+		return kNeedMore;
+	}
+
+	// An empty line: whatever we were collecting is complete
+	lineComplete();
+	if (state == kFailed)
+	{
+		return kBadStatus;
+	}
+
+	// Blank lines before the status line are tolerated, after it they end the headers
+	if (state == kStatusLine)
+	{
+		return kNeedMore;
+	}
+
+	// The LF after this CR is still ours, the audio starts after it
+	if (c == '\r' && !bareCR)
+	{
+		blankLineCR = true;
+		return kNeedMore;
+	}
+	state = kDone;
+	return kComplete;
+}
+
+void ResponseHeaderParser::lineComplete()
+{
+	if (lineLen == 0)
+	{
+		return;
+	}
+
+	line[lineLen] = '\0';
+	lines++;
+	if (lineTooLong)
+	{
+		truncated++;
+	}
+
+	if (state == kStatusLine)
+	{
+		state = parseStatusLine() ? kHeaderLines : kFailed;
+	}
+	else
+	{
+		parseHeaderLine();
+	}
+
+	lineLen = 0;
+	lineTooLong = false;
+}
+
+// Is what we have of the status line so far the start of "HTTP/" or "ICY "?
+bool ResponseHeaderParser::couldBeStatusLine() const
+{
+	size_t httpLen = lineLen < 5 ? lineLen : 5;
+	size_t icyLen = lineLen < 4 ? lineLen : 4;
+	return strncmp(line, "HTTP/", httpLen) == 0 || strncmp(line, "ICY ", icyLen) == 0;
+}
+
+// "HTTP/1.1 200 OK", "HTTP/1.0 302 Found" or "ICY 200 OK"
+bool ResponseHeaderParser::parseStatusLine()
+{
+	copyValue(status, sizeof(status), line, lineLen);
+
+	const char *code;
+	if (strncmp(line, "ICY ", 4) == 0)
+	{
+		found.icy = true;
+		code = line + 4;
+	}
+	else if (strncmp(line, "HTTP/", 5) == 0 && line[5] >= '0' && line[5] <= '9' && line[6] == '.' &&
+			 line[7] >= '0' && line[7] <= '9' && line[8] == ' ')
+	{
+		code = line + 9;
+	}
+	else
+	{
+		return false;
+	}
+
+	// Exactly three digits, then the end or a reason phrase
+	for (int digit = 0; digit < 3; digit++)
+	{
+		if (code[digit] < '0' || code[digit] > '9')
+		{
+			return false;
+		}
+	}
+	if (code[3] != '\0' && code[3] != ' ')
+	{
+		return false;
+	}
+
+	found.status = (uint16_t)parseNumber(code);
+	return true;
+}
+
+// "Name: value", the name in any case
+void ResponseHeaderParser::parseHeaderLine()
+{
+	const char *colon = (const char *)memchr(line, ':', lineLen);
+	if (!colon)
+	{
+		return;
+	}
+
+	size_t nameLen = colon - line;
+	while (nameLen > 0 && (line[nameLen - 1] == ' ' || line[nameLen - 1] == '\t'))
+	{
+		nameLen--;
+	}
+
+	const char *value = colon + 1;
+	const char *end = line + lineLen;
+	while (value < end && (*value == ' ' || *value == '\t'))
+	{
+		value++;
+	}
+	while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+	{
+		end--;
+	}
+	size_t valueLen = end - value;
+
+	if (nameIs(line, nameLen, "icy-metaint"))
+	{
+		found.metaInt = parseNumber(value);
+	}
+	else if (nameIs(line, nameLen, "icy-br"))
+	{
+		// Sometimes a list ("128,128"), the first will do
+		found.bitRate = (int)parseNumber(value);
+	}
+	else if (nameIs(line, nameLen, "location"))
+	{
+		copyValue(found.location, sizeof(found.location), value, valueLen);
+	}
+	else if (nameIs(line, nameLen, "content-type"))
+	{
+		copyValue(found.contentType, sizeof(found.contentType), value, valueLen);
+	}
+	else if (nameIs(line, nameLen, "icy-name"))
+	{
+		copyValue(found.name, sizeof(found.name), value, valueLen);
+	}
+	else if (nameIs(line, nameLen, "icy-genre"))
+	{
+		copyValue(found.genre, sizeof(found.genre), value, valueLen);
+	}
+}
+
+void ResponseHeaderParser::append(char c)
+{
+	if (lineLen < maxLineLength)
+	{
+		line[lineLen++] = c;
+	}
+	else
+	{
+		lineTooLong = true;
+	}
+}
+
+bool ResponseHeaderParser::nameIs(const char *name, size_t nameLen, const char *wanted)
+{
+	return nameLen == strlen(wanted) && strncasecmp(name, wanted, nameLen) == 0;
+}
+
+// Leading decimal digits, anything after them is ignored
+uint32_t ResponseHeaderParser::parseNumber(const char *text)
+{
+	uint32_t number = 0;
+	while (*text >= '0' && *text <= '9')
+	{
+		number = number * 10 + (*text++ - '0');
+	}
+	return number;
+}
+
+void ResponseHeaderParser::copyValue(char *dest, size_t destSize, const char *value, size_t valueLen)
+{
+	if (valueLen > destSize - 1)
+	{
+		valueLen = destSize - 1;
+	}
+	memcpy(dest, value, valueLen);
+	dest[valueLen] = '\0';
+}
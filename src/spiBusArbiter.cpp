@@ -0,0 +1,149 @@
+#include <string.h>
+
+#include "spiBusArbiter.h"
+#include "taskPort.h"
+
+SpiBusArbiter::SpiBusArbiter()
+	: grantedAt(0)
+#ifdef ESP_PLATFORM
+	  ,
+	  lock(nullptr)
+#endif
+{
+	for (int client = 0; client < kBusClients; client++)
+	{
+		waiting[client] = 0;
+	}
+	memset(stats, 0, sizeof(stats));
+}
+
+bool SpiBusArbiter::begin()
+{
+#ifdef ESP_PLATFORM
+	// A mutex (not a binary semaphore) so the holder inherits the priority of whoever waits
+	lock = xSemaphoreCreateMutex();
+	return lock != nullptr;
+#else
+	return true;
+#endif
+}
+
+void SpiBusArbiter::acquire(spiBusClient client)
+{
+	waiting[client]++;
+	uint32_t startedWaiting = static_cast<uint32_t>(monotonicMicros());
+
+	// If someone more important turns up while we wait for the lock, they go first
+	for (;;)
+	{
+		lockTake();
+		if (!contended(client))
+		{
+			break;
+		}
+		lockGive();
+		taskSleepMs(1);
+	}
+	waiting[client]--;
+
+	grantedAt = static_cast<uint32_t>(monotonicMicros());
+	uint32_t waited = grantedAt - startedWaiting;
+	Stats &s = stats[client];
+	s.grants++;
+	s.waitMicros += waited;
+	if (waited > s.maxWaitMicros)
+	{
+		s.maxWaitMicros = waited;
+	}
+}
+
+void SpiBusArbiter::release(spiBusClient client)
+{
+	uint32_t held = static_cast<uint32_t>(monotonicMicros()) - grantedAt;
+	Stats &s = stats[client];
+	s.holdMicros += held;
+	if (held > s.maxHoldMicros)
+	{
+		s.maxHoldMicros = held;
+	}
+	lockGive();
+}
+
+bool SpiBusArbiter::contended(spiBusClient client) const
+{
+	for (int other = 0; other < client; other++)
+	{
+		if (waiting[other])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SpiBusArbiter::yieldIfWaiting(spiBusClient client)
+{
+	if (!contended(client))
+	{
+		return false;
+	}
+	stats[client].yields++;
+	release(client);
+	acquire(client);
+	return true;
+}
+
+void SpiBusArbiter::snapshot(spiBusClient client, Stats &copy)
+{
+	// Figures only change while the bus is held, so holding it gives a consistent copy
+	lockTake();
+	copy = stats[client];
+	lockGive();
+}
+
+const char *SpiBusArbiter::clientName(spiBusClient client)
+{
+	switch (client)
+	{
+	case kBusAudio:
+		return "audio";
+	case kBusTouch:
+		return "touch";
+	case kBusDisplay:
+		return "display";
+	default:
+		return "?";
+	}
+}
+
+#ifdef ESP_PLATFORM
+
+void SpiBusArbiter::lockTake()
+{
+	if (lock)
+	{
+		xSemaphoreTake(lock, portMAX_DELAY);
+	}
+}
+
+void SpiBusArbiter::lockGive()
+{
+	if (lock)
+	{
+		xSemaphoreGive(lock);
+	}
+}
+
+#else
+
+void SpiBusArbiter::lockTake()
+{
+	lock.lock();
+}
+
+void SpiBusArbiter::lockGive()
+{
+	lock.unlock();
+}
+
+#endif
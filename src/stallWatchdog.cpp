@@ -0,0 +1,173 @@
+#include <string.h>
+
+#include "stallWatchdog.h"
+
+namespace {
+// The window is kSlots of these
+constexpr uint32_t kSlotMs = 500;
+
+// Don't judge a new connection until it has filled the window
+constexpr uint32_t kGraceMs = StallWatchdog::kSlots * kSlotMs;
+
+// No need to work it all out every time round the ingest loop
+constexpr uint32_t kCheckEveryMs = 100;
+
+// Nothing at all for this long and we give up whatever the buffer says
+constexpr uint32_t kSilenceMs = 10000;
+
+// Assumed until we have timed a connect, and the least we allow for one
+constexpr uint32_t kDefaultReconnectMs = 2000;
+constexpr uint32_t kMinLeadMs = 2000;
+constexpr uint32_t kLeadMarginMs = 1000;
+} // namespace
+
+StallWatchdog::StallWatchdog()
+	: slotStart(0), windowStart(0), lastArrival(0), lastCheck(0), reconnectCost(kDefaultReconnectMs),
+	  open(false), stalledAt(0)
+{
+	memset(slotBytes, 0, sizeof(slotBytes));
+	memset(&counters, 0, sizeof(counters));
+}
+
+void StallWatchdog::reset(uint32_t nowMs)
+{
+	memset(slotBytes, 0, sizeof(slotBytes));
+	slotStart = nowMs / kSlotMs;
+	windowStart = nowMs;
+	lastArrival = nowMs;
+	lastCheck = nowMs;
+}
+
+void StallWatchdog::setReconnectCostMs(uint32_t ms)
+{
+	if (ms)
+	{
+		reconnectCost = ms;
+	}
+}
+
+// Move the window on to now, emptying the slots we have passed
+void StallWatchdog::advance(uint32_t nowMs)
+{
+	uint32_t slot = nowMs / kSlotMs;
+	if (slot - slotStart >= kSlots)
+	{
+		memset(slotBytes, 0, sizeof(slotBytes));
+		slotStart = slot;
+		return;
+	}
+	while (slotStart != slot)
+	{
+		slotStart++;
+		slotBytes[slotStart % kSlots] = 0;
+	}
+}
+
+void StallWatchdog::onArrival(uint32_t nowMs, size_t bytes)
+{
+	if (bytes == 0)
+	{
+		return;
+	}
+	advance(nowMs);
+	slotBytes[slotStart % kSlots] += bytes;
+	lastArrival = nowMs;
+}
+
+uint32_t StallWatchdog::arrivalRate(uint32_t nowMs)
+{
+	advance(nowMs);
+
+	uint32_t bytes = 0;
+	for (size_t i = 0; i < kSlots; i++)
+	{
+		bytes += slotBytes[i];
+	}
+
+	// The older slots are whole, the newest only partly gone
+	uint32_t span = (kSlots - 1) * kSlotMs + nowMs % kSlotMs;
+	if (span > nowMs - windowStart)
+	{
+		span = nowMs - windowStart;
+	}
+	return span ? (uint32_t)((uint64_t)bytes * 1000 / span) : 0;
+}
+
+uint32_t StallWatchdog::predictRunwayMs(size_t bufferedBytes, uint32_t drainRate, uint32_t arrivalRate)
+{
+	if (arrivalRate >= drainRate)
+	{
+		return UINT32_MAX;
+	}
+	return (uint32_t)((uint64_t)bufferedBytes * 1000 / (drainRate - arrivalRate));
+}
+
+uint32_t StallWatchdog::leadMs() const
+{
+	uint32_t lead = reconnectCost + reconnectCost / 2 + kLeadMarginMs;
+	return lead < kMinLeadMs ? kMinLeadMs : lead;
+}
+
+bool StallWatchdog::check(uint32_t nowMs, size_t bufferedBytes, uint32_t drainRate)
+{
+	if (open || drainRate == 0 || nowMs - lastCheck < kCheckEveryMs || nowMs - windowStart < kGraceMs)
+	{
+		return false;
+	}
+	lastCheck = nowMs;
+
+	uint32_t runway;
+	bool silence = nowMs - lastArrival >= kSilenceMs;
+	if (silence)
+	{
+		runway = predictRunwayMs(bufferedBytes, drainRate, 0);
+	}
+	else
+	{
+		// A bit slow for a moment is normal, well short of the drain rate isn't
+		uint32_t arrival = arrivalRate(nowMs);
+		if (arrival >= drainRate / 4 * 3)
+		{
+			return false;
+		}
+		runway = predictRunwayMs(bufferedBytes, drainRate, arrival);
+		if (runway > leadMs())
+		{
+			return false;
+		}
+	}
+
+	open = true;
+	stalledAt = nowMs;
+	counters.stalls++;
+	if (silence)
+	{
+		counters.silent++;
+	}
+	counters.lastPredictedMs = runway;
+	return true;
+}
+
+uint32_t StallWatchdog::recovered(uint32_t nowMs, uint32_t leftMs)
+{
+	if (!open)
+	{
+		return 0;
+	}
+	open = false;
+	counters.recovered++;
+	counters.lastActualMs = nowMs - stalledAt + leftMs;
+	return counters.lastActualMs;
+}
+
+uint32_t StallWatchdog::ranDry(uint32_t nowMs)
+{
+	if (!open)
+	{
+		return 0;
+	}
+	open = false;
+	counters.ranDry++;
+	counters.lastActualMs = nowMs - stalledAt;
+	return counters.lastActualMs;
+}
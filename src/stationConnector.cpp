@@ -0,0 +1,508 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <lwip/dns.h>
+#include <lwip/sockets.h>
+
+#include "stationConnector.h"
+
+std::atomic<StationConnector *> StationConnector::lookupOwner(nullptr);
+
+StationConnector::StationConnector(WiFiClient &client)
+	: client(client),
+	  currentState(kIdle),
+	  failedWith(kFailNone),
+	  startedAt(0),
+	  phaseStartedAt(0),
+	  hostPort(80),
+	  metadata(false),
+	  dnsResult(0),
+	  dnsGeneration(0),
+	  dnsStartedAt(0),
+	  dnsCollected(true),
+	  serverAddress(0),
+	  haveAddress(false),
+	  addressFromCache(false),
+	  socketFd(-1)
+{
+	memset(&phaseTimes, 0, sizeof(phaseTimes));
+	hostName[0] = '\0';
+	requestPath[0] = '\0';
+}
+
+void StationConnector::start(const char *host, uint16_t port, const char *path, bool wantMetadata)
+{
+	if (busy())
+	{
+		Serial.printf("Connect to %s cancelled in %s after %lums\n", hostName, stateName(currentState),
+					  (unsigned long)elapsedMs());
+	}
+	cancel();
+
+	strncpy(hostName, host, sizeof(hostName) - 1);
+	hostName[sizeof(hostName) - 1] = '\0';
+	strncpy(requestPath, path, sizeof(requestPath) - 1);
+	requestPath[sizeof(requestPath) - 1] = '\0';
+	hostPort = port;
+	metadata = wantMetadata;
+
+	failedWith = kFailNone;
+	memset(&phaseTimes, 0, sizeof(phaseTimes));
+	parser.reset();
+	startedAt = millis();
+
+	haveAddress = false;
+	addressFromCache = false;
+
+	// No lookup needed for a dotted address
+	IPAddress literal;
+	if (literal.fromString(hostName))
+	{
+		serverAddress = (uint32_t)literal;
+		haveAddress = true;
+		enter(kResolving);
+		return;
+	}
+
+	// Known already? A stale address is used now and refreshed in the background.
+	uint32_t cached = 0;
+	DnsCache::lookupResult cachedAs = cache.find(hostName, millis(), cached);
+	if (cachedAs != DnsCache::kMiss)
+	{
+		serverAddress = cached;
+		haveAddress = true;
+		addressFromCache = true;
+	}
+
+	enter(kResolving);
+	if (cachedAs != DnsCache::kFresh && !startLookup() && !haveAddress)
+	{
+		fail(kFailDns);
+	}
+}
+
+void StationConnector::cancel()
+{
+	// A lookup still in flight can't be stopped, dnsFound() just ignores its answer
+	abandonLookup();
+	dnsCollected = true;
+	closeSocket();
+	client.stop();
+	enter(kIdle);
+}
+
+StationConnector::connectState StationConnector::step()
+{
+	collectLookup();
+
+	switch (currentState)
+	{
+	case kResolving:
+		return stepResolving();
+	case kConnecting:
+		return stepConnecting();
+	case kAwaitingHeaders:
+	case kReadingHeaders:
+		return stepHeaders();
+	case kAwaitingAudio:
+		return stepAwaitingAudio();
+	default:
+		return currentState;
+	}
+}
+
+StationConnector::connectState StationConnector::stepResolving()
+{
+	if (!haveAddress)
+	{
+		uint32_t address;
+		if (!lookupFinished(address))
+		{
+			if (phaseExpired(dnsTimeoutMs))
+			{
+				abandonLookup();
+				dnsCollected = true;
+				return fail(kFailDns);
+			}
+			return currentState;
+		}
+
+		if (address == 0)
+		{
+			return fail(kFailDns);
+		}
+		serverAddress = address;
+		haveAddress = true;
+	}
+	phaseTimes.resolvedMs = elapsedMs();
+
+	if (!beginConnect())
+	{
+		return fail(kFailConnect);
+	}
+	enter(kConnecting);
+	return currentState;
+}
+
+// lwip answers straight away from its own (small) cache, otherwise calls dnsFound() later
+bool StationConnector::startLookup()
+{
+	ip_addr_t address;
+	uint32_t generation = ++dnsGeneration;
+	dnsCollected = false;
+	dnsStartedAt = millis();
+	lookupOwner = this;
+	dnsResult = ((uint64_t)generation << 32) | kLookupPending;
+
+	err_t result = dns_gethostbyname(hostName, &address, &StationConnector::dnsFound, (void *)(uintptr_t)generation);
+	if (result == ERR_OK)
+	{
+		dnsResult = ((uint64_t)generation << 32) | address.u_addr.ip4.addr;
+		return true;
+	}
+	if (result != ERR_INPROGRESS)
+	{
+		abandonLookup();
+		dnsCollected = true;
+		return false;
+	}
+	return true;
+}
+
+// Has the current lookup been answered? address is 0 if it failed.
+bool StationConnector::lookupFinished(uint32_t &address) const
+{
+	uint64_t result = dnsResult;
+	if ((uint32_t)(result >> 32) != dnsGeneration || (uint32_t)result == kLookupPending)
+	{
+		return false;
+	}
+	address = (uint32_t)result;
+	return true;
+}
+
+// A lookup has finished (we may be well past needing it, if it was a refresh): keep the answer
+void StationConnector::collectLookup()
+{
+	uint32_t address;
+	if (dnsCollected || !lookupFinished(address))
+	{
+		return;
+	}
+	dnsCollected = true;
+
+	if (address == 0)
+	{
+		return;
+	}
+	if (addressFromCache && address != serverAddress)
+	{
+		Serial.printf("DNS: %s has moved\n", hostName);
+	}
+	cache.store(hostName, address, millis() - dnsStartedAt, millis());
+}
+
+StationConnector::connectState StationConnector::stepConnecting()
+{
+	// Writable means the connect has finished, one way or the other
+	fd_set writable;
+	FD_ZERO(&writable);
+	FD_SET(socketFd, &writable);
+	struct timeval noWait = {0, 0};
+	int ready = select(socketFd + 1, NULL, &writable, NULL, &noWait);
+	if (ready == 0)
+	{
+		return phaseExpired(connectTimeoutMs) ? fail(kFailConnect) : currentState;
+	}
+
+	int error = 0;
+	socklen_t errorLen = sizeof(error);
+	if (ready < 0 || getsockopt(socketFd, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0 || error != 0)
+	{
+		Serial.printf("Connect to %s:%u failed (%d)\n", hostName, hostPort, ready < 0 ? errno : error);
+		return fail(kFailConnect);
+	}
+
+	// Blocking again, as the WiFiClient expects (it reads with MSG_DONTWAIT anyway)
+	fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL, 0) & ~O_NONBLOCK);
+	int enable = 1;
+	setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	setsockopt(socketFd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+
+	// The client owns (and will close) the socket from now on
+	client = WiFiClient(socketFd);
+	socketFd = -1;
+	phaseTimes.connectedMs = elapsedMs();
+
+	if (!sendRequest())
+	{
+		return fail(kFailSend);
+	}
+	enter(kAwaitingHeaders);
+	return currentState;
+}
+
+StationConnector::connectState StationConnector::stepHeaders()
+{
+	// Only what has already arrived, and a byte at a time so we stop at the first byte of audio
+	while (client.available() > 0)
+	{
+		int c = client.read();
+		if (c < 0)
+		{
+			break;
+		}
+
+		if (currentState == kAwaitingHeaders)
+		{
+			phaseTimes.firstHeaderByteMs = elapsedMs();
+			enter(kReadingHeaders);
+		}
+
+		switch (parser.feed((char)c))
+		{
+		case ResponseHeaderParser::kComplete:
+			return headersComplete();
+		case ResponseHeaderParser::kBadStatus:
+			Serial.printf("Not an HTTP/ICY response: %s\n", parser.statusLine());
+			return fail(kFailBadResponse);
+		default:
+			break;
+		}
+	}
+
+	if (!client.connected() && client.available() <= 0)
+	{
+		return fail(kFailClosed);
+	}
+	if (currentState == kAwaitingHeaders && phaseExpired(firstHeaderTimeoutMs))
+	{
+		return fail(kFailTimeout);
+	}
+	if (currentState == kReadingHeaders && phaseExpired(headersTimeoutMs))
+	{
+		return fail(kFailTimeout);
+	}
+	return currentState;
+}
+
+// The ICY (I Can Yell, a precursor to Shoutcast) format:
+// In the http response we can look for icy-metaint: XXXX to tell us how far apart
+// the header information (in bytes) is sent.
+StationConnector::connectState StationConnector::headersComplete()
+{
+	const ResponseHeaderParser::Headers &h = parser.headers();
+	Serial.printf("Response: %s\n", parser.statusLine());
+	if (h.name[0] || h.contentType[0])
+	{
+		Serial.printf("Station: '%s' (%s) %s\n", h.name, h.genre, h.contentType);
+	}
+
+	// The URL we used has been redirected (we can only follow it to another http:// one)
+	if (h.location[0])
+	{
+		if (strncasecmp(h.location, "http://", 7) != 0)
+		{
+			Serial.printf("Can't follow redirect to '%s'\n", h.location);
+			return fail(kFailBadResponse);
+		}
+		return fail(kFailRedirect);
+	}
+
+	if (h.status != 200)
+	{
+		return fail(kFailBadResponse);
+	}
+
+	// Critical value for this whole sketch to work: bytes between "frames"
+	// If we didn't find it in the headers, abort this connection
+	// (Actually it's only BBC Radio 4 that doesn't always give this out)
+	if (metadata && h.metaInt == 0)
+	{
+		return fail(kFailNoMetaInt);
+	}
+	Serial.printf("NEW Metadata Interval:%lu\n", (unsigned long)h.metaInt);
+	Serial.printf("Bit rate:%d\n", h.bitRate);
+
+	phaseTimes.headersMs = elapsedMs();
+	enter(kAwaitingAudio);
+	return currentState;
+}
+
+StationConnector::connectState StationConnector::stepAwaitingAudio()
+{
+	if (client.available() > 0)
+	{
+		phaseTimes.firstAudioMs = elapsedMs();
+		enter(kStreaming);
+		return currentState;
+	}
+
+	if (!client.connected())
+	{
+		return fail(kFailClosed);
+	}
+	return phaseExpired(firstAudioTimeoutMs) ? fail(kFailTimeout) : currentState;
+}
+
+bool StationConnector::beginConnect()
+{
+	socketFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (socketFd < 0)
+	{
+		Serial.printf("No socket for %s (%d)\n", hostName, errno);
+		return false;
+	}
+	fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL, 0) | O_NONBLOCK);
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = serverAddress;
+	address.sin_port = htons(hostPort);
+
+	Serial.printf("Host: %s Port:%u\n", hostName, hostPort);
+	if (connect(socketFd, (struct sockaddr *)&address, sizeof(address)) < 0 && errno != EINPROGRESS)
+	{
+		Serial.printf("Connect to %s:%u failed (%d)\n", hostName, hostPort, errno);
+		return false;
+	}
+	return true;
+}
+
+// Get the data stream plus any metadata (eg station name, track info between songs / ads)
+bool StationConnector::sendRequest()
+{
+	Serial.printf("Getting data from %s (%s Metadata)\n", requestPath, (metadata ? "WITH" : "WITHOUT"));
+
+	// Host and path are at most 63 and 127 characters, so this always fits
+	char request[sizeof(requestPath) + sizeof(hostName) + 80];
+	int len = snprintf(request, sizeof(request),
+					   "GET %s HTTP/1.1\r\n"
+					   "Host: %s\r\n"
+					   "%s"
+					   "Connection: close\r\n\r\n",
+					   requestPath, hostName, metadata ? "Icy-MetaData:1\r\n" : "");
+	if (len <= 0 || (size_t)len >= sizeof(request))
+	{
+		return false;
+	}
+	return client.write((const uint8_t *)request, len) == (size_t)len;
+}
+
+void StationConnector::enter(connectState next)
+{
+	currentState = next;
+	phaseStartedAt = millis();
+}
+
+StationConnector::connectState StationConnector::fail(failReason reason)
+{
+	Serial.printf("Connect to %s failed in %s after %lums: %s\n", hostName, stateName(currentState),
+				  (unsigned long)elapsedMs(), failureName(reason));
+	failedWith = reason;
+
+	// Whatever the cache gave us is no good (any refresh will put it back)
+	if (reason == kFailConnect && addressFromCache)
+	{
+		cache.forget(hostName);
+	}
+	closeSocket();
+	client.stop();
+	enter(kFailed);
+	return currentState;
+}
+
+void StationConnector::closeSocket()
+{
+	if (socketFd >= 0)
+	{
+		close(socketFd);
+		socketFd = -1;
+	}
+}
+
+void StationConnector::printTimings() const
+{
+	const Timings &t = phaseTimes;
+	Serial.printf("Connect timings: DNS %lums, TCP %lums, first header byte %lums, headers %lums, first audio %lums (total %lums)\n",
+				  (unsigned long)t.resolvedMs,
+				  (unsigned long)(t.connectedMs - t.resolvedMs),
+				  (unsigned long)(t.firstHeaderByteMs - t.connectedMs),
+				  (unsigned long)(t.headersMs - t.firstHeaderByteMs),
+				  (unsigned long)(t.firstAudioMs - t.headersMs),
+				  (unsigned long)t.firstAudioMs);
+}
+
+// Called by lwip (in its own task) when the lookup finishes, address is NULL if it failed. Nothing
+// else of the connector's is touched here: the answer only goes in if the lookup with this
+// generation is still the one waiting, so a cancelled or overtaken lookup is dropped.
+void StationConnector::dnsFound(const char *name, const ip_addr_t *address, void *context)
+{
+	(void)name;
+	StationConnector *self = lookupOwner;
+	if (!self)
+	{
+		return;
+	}
+
+	uint64_t generation = (uint64_t)(uint32_t)(uintptr_t)context << 32;
+	uint64_t waiting = generation | kLookupPending;
+	uint64_t answer = generation | (address ? address->u_addr.ip4.addr : 0);
+	self->dnsResult.compare_exchange_strong(waiting, answer);
+}
+
+const char *StationConnector::stateName(connectState state)
+{
+	switch (state)
+	{
+	case kIdle:
+		return "idle";
+	case kResolving:
+		return "DNS";
+	case kConnecting:
+		return "TCP connect";
+	case kAwaitingHeaders:
+		return "waiting for headers";
+	case kReadingHeaders:
+		return "reading headers";
+	case kAwaitingAudio:
+		return "waiting for audio";
+	case kStreaming:
+		return "streaming";
+	case kFailed:
+		return "failed";
+	default:
+		return "?";
+	}
+}
+
+const char *StationConnector::failureName(failReason reason)
+{
+	switch (reason)
+	{
+	case kFailNone:
+		return "none";
+	case kFailDns:
+		return "DNS lookup failed";
+	case kFailConnect:
+		return "could not connect";
+	case kFailSend:
+		return "could not send request";
+	case kFailTimeout:
+		return "timed out";
+	case kFailBadResponse:
+		return "bad response";
+	case kFailClosed:
+		return "server closed the connection";
+	case kFailRedirect:
+		return "redirected";
+	case kFailNoMetaInt:
+		return "no metadata interval";
+	default:
+		return "?";
+	}
+}
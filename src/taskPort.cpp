@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include "taskPort.h"
+
+#ifdef ESP_PLATFORM
+
+#include <esp_timer.h>
+
+bool startTask(taskFunction function, const char *name, uint32_t stackBytes, void *parameter,
+			   unsigned priority, int core, taskHandle *handle)
+{
+	return xTaskCreatePinnedToCore(function, name, stackBytes, parameter, priority, handle, core) == pdPASS;
+}
+
+void taskSleepMs(uint32_t ms)
+{
+	// Always sleep at least one tick or lower priority tasks (and the idle task's watchdog) starve
+	TickType_t ticks = pdMS_TO_TICKS(ms);
+	vTaskDelay(ticks ? ticks : 1);
+}
+
+uint64_t monotonicMicros()
+{
+	return static_cast<uint64_t>(esp_timer_get_time());
+}
+
+MessageQueue::MessageQueue()
+	: itemSize(0), queue(nullptr)
+{
+}
+
+bool MessageQueue::begin(size_t itemSize, size_t length)
+{
+	this->itemSize = itemSize;
+	queue = xQueueCreate(length, itemSize);
+	return queue != nullptr;
+}
+
+bool MessageQueue::send(const void *item, uint32_t waitMs)
+{
+	return queue && xQueueSend(queue, item, pdMS_TO_TICKS(waitMs)) == pdTRUE;
+}
+
+bool MessageQueue::receive(void *item, uint32_t waitMs)
+{
+	return queue && xQueueReceive(queue, item, pdMS_TO_TICKS(waitMs)) == pdTRUE;
+}
+
+#else
+
+#include <chrono>
+#include <thread>
+
+bool startTask(taskFunction function, const char *name, uint32_t stackBytes, void *parameter,
+			   unsigned priority, int core, taskHandle *handle)
+{
+	(void)name;
+	(void)stackBytes;
+	(void)priority;
+	(void)core;
+
+	// Tasks never return so the thread is left to run on its own
+	std::thread task(function, parameter);
+	task.detach();
+	if (handle)
+	{
+		*handle = nullptr;
+	}
+	return true;
+}
+
+void taskSleepMs(uint32_t ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms ? ms : 1));
+}
+
+uint64_t monotonicMicros()
+{
+	using namespace std::chrono;
+	return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+MessageQueue::MessageQueue()
+	: itemSize(0), length(0)
+{
+}
+
+bool MessageQueue::begin(size_t itemSize, size_t length)
+{
+	this->itemSize = itemSize;
+	this->length = length;
+	return itemSize && length;
+}
+
+bool MessageQueue::send(const void *item, uint32_t waitMs)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (!changed.wait_for(guard, std::chrono::milliseconds(waitMs), [this] { return items.size() < length; }))
+	{
+		return false;
+	}
+
+	const uint8_t *bytes = static_cast<const uint8_t *>(item);
+	items.push_back(std::vector<uint8_t>(bytes, bytes + itemSize));
+	changed.notify_all();
+	return true;
+}
+
+bool MessageQueue::receive(void *item, uint32_t waitMs)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (!changed.wait_for(guard, std::chrono::milliseconds(waitMs), [this] { return !items.empty(); }))
+	{
+		return false;
+	}
+
+	memcpy(item, items.front().data(), itemSize);
+	items.pop_front();
+	changed.notify_all();
+	return true;
+}
+
+#endif
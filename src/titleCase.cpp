@@ -0,0 +1,317 @@
+#include <string.h>
+
+#include "titleCase.h"
+
+namespace {
+enum rangeKind
+{
+	kOffset, // the range is upper case, lower case is delta above it
+	kPairs,	 // upper and lower alternate, starting with upper at first
+};
+
+struct caseRange
+{
+	uint16_t first;
+	uint16_t last;
+	uint8_t kind;
+	int16_t delta;
+};
+
+// In code point order. Every mapping stays within the same UTF-8 length.
+const caseRange kCaseRanges[] = {
+	{0x0041, 0x005A, kOffset, 32},	// A-Z
+	{0x00C0, 0x00D6, kOffset, 32},	// À-Ö
+	{0x00D8, 0x00DE, kOffset, 32},	// Ø-Þ (not ×)
+	{0x0100, 0x012F, kPairs, 0},	// Ā-į
+	{0x0132, 0x0137, kPairs, 0},	// Ĳ-ķ
+	{0x0139, 0x0148, kPairs, 0},	// Ĺ-ň (ľ, ĺ)
+	{0x014A, 0x0177, kPairs, 0},	// Ŋ-ŷ (ŕ, š, ť)
+	{0x0178, 0x0178, kOffset, -121}, // Ÿ-ÿ
+	{0x0179, 0x017E, kPairs, 0},	// Ź-ž
+	{0x0400, 0x040F, kOffset, 80},	// Ѐ-Џ
+	{0x0410, 0x042F, kOffset, 32},	// А-Я
+	{0x0460, 0x0481, kPairs, 0},	// Ѡ-ҁ
+	{0x048A, 0x04BF, kPairs, 0},	// Ҋ-ҿ
+	{0x04C1, 0x04CE, kPairs, 0},	// Ӂ-ӎ
+	{0x04D0, 0x04FF, kPairs, 0},	// Ӑ-ӿ
+};
+
+const size_t kCaseRangeCount = sizeof(kCaseRanges) / sizeof(kCaseRanges[0]);
+
+// Windows-1252 puts printable characters where ISO-8859-1 has controls (0 is undefined)
+const uint16_t kCp1252[32] = {
+	0x20AC, 0, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+	0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017D, 0,
+	0, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+	0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0, 0x017E, 0x0178,
+};
+
+uint32_t fromLatin1(uint8_t c)
+{
+	if (c >= 0x80 && c < 0xA0)
+	{
+		return kCp1252[c - 0x80] ? kCp1252[c - 0x80] : '?';
+	}
+	return c;
+}
+
+size_t utf8Length(uint32_t cp)
+{
+	return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+void putUtf8(char *out, uint32_t cp, size_t n)
+{
+	switch (n)
+	{
+	case 1:
+		out[0] = (char)cp;
+		break;
+	case 2:
+		out[0] = (char)(0xC0 | (cp >> 6));
+		out[1] = (char)(0x80 | (cp & 0x3F));
+		break;
+	case 3:
+		out[0] = (char)(0xE0 | (cp >> 12));
+		out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (cp & 0x3F));
+		break;
+	default:
+		out[0] = (char)(0xF0 | (cp >> 18));
+		out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		out[3] = (char)(0x80 | (cp & 0x3F));
+		break;
+	}
+}
+
+// A new word starts after one of these
+bool isWordBreak(uint32_t cp)
+{
+	return cp == ' ' || cp == '\t' || cp == '\r' || cp == '\n' || cp == 0xA0 || cp == '(' || cp == '[' || cp == '"';
+}
+} // namespace
+
+uint32_t TitleCase::toLower(uint32_t cp)
+{
+	for (size_t i = 0; i < kCaseRangeCount && cp >= kCaseRanges[i].first; i++)
+	{
+		const caseRange &range = kCaseRanges[i];
+		if (cp > range.last)
+		{
+			continue;
+		}
+		if (range.kind == kOffset)
+		{
+			return cp + range.delta;
+		}
+		return (cp - range.first) % 2 == 0 ? cp + 1 : cp;
+	}
+	return cp;
+}
+
+uint32_t TitleCase::toUpper(uint32_t cp)
+{
+	for (size_t i = 0; i < kCaseRangeCount; i++)
+	{
+		const caseRange &range = kCaseRanges[i];
+		if (range.kind == kOffset)
+		{
+			if (cp >= (uint32_t)(range.first + range.delta) && cp <= (uint32_t)(range.last + range.delta))
+			{
+				return cp - range.delta;
+			}
+		}
+		else if (cp >= range.first && cp <= range.last)
+		{
+			return (cp - range.first) % 2 == 1 ? cp - 1 : cp;
+		}
+	}
+	return cp;
+}
+
+TitleCase::textEncoding TitleCase::detect(const char *text, size_t len, size_t &validLen)
+{
+	const uint8_t *s = (const uint8_t *)text;
+	bool multiByte = false;
+	size_t i = 0;
+
+	while (i < len)
+	{
+		uint8_t c = s[i];
+		if (c < 0x80)
+		{
+			i++;
+			continue;
+		}
+
+		size_t n;
+		uint32_t cp;
+		uint32_t least;
+		if ((c & 0xE0) == 0xC0)
+		{
+			n = 2;
+			cp = c & 0x1F;
+			least = 0x80;
+		}
+		else if ((c & 0xF0) == 0xE0)
+		{
+			n = 3;
+			cp = c & 0x0F;
+			least = 0x800;
+		}
+		else if ((c & 0xF8) == 0xF0)
+		{
+			n = 4;
+			cp = c & 0x07;
+			least = 0x10000;
+		}
+		else
+		{
+			validLen = len;
+			return kLatin1;
+		}
+
+		// Cut off in the middle of a character? Only believable if there were whole ones before it.
+		size_t have = len - i < n ? len - i : n;
+		for (size_t j = 1; j < have; j++)
+		{
+			if ((s[i + j] & 0xC0) != 0x80)
+			{
+				validLen = len;
+				return kLatin1;
+			}
+			cp = (cp << 6) | (s[i + j] & 0x3F);
+		}
+		if (have < n)
+		{
+			validLen = multiByte ? i : len;
+			return multiByte ? kUtf8 : kLatin1;
+		}
+
+		// Overlong, surrogate or out of range: not UTF-8
+		if (cp < least || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		{
+			validLen = len;
+			return kLatin1;
+		}
+		multiByte = true;
+		i += n;
+	}
+
+	validLen = len;
+	return multiByte ? kUtf8 : kAscii;
+}
+
+size_t TitleCase::latin1ToUtf8(char *text, size_t len, size_t capacity)
+{
+	// How much of it fits once converted, in whole characters
+	size_t outLen = 0;
+	size_t keep = 0;
+	while (keep < len)
+	{
+		size_t n = utf8Length(fromLatin1((uint8_t)text[keep]));
+		if (outLen + n > capacity - 1)
+		{
+			break;
+		}
+		outLen += n;
+		keep++;
+	}
+
+	// It only ever grows, so work from the back and nothing is overwritten before it is read
+	size_t out = outLen;
+	for (size_t i = keep; i-- > 0;)
+	{
+		uint32_t cp = fromLatin1((uint8_t)text[i]);
+		size_t n = utf8Length(cp);
+		out -= n;
+		putUtf8(text + out, cp, n);
+	}
+	return outLen;
+}
+
+void TitleCase::titleCaseUtf8(char *text, size_t len)
+{
+	bool wordStart = true;
+	size_t i = 0;
+
+	while (i < len)
+	{
+		uint8_t c = (uint8_t)text[i];
+
+		// Most titles are mostly ASCII
+		if (c < 0x80)
+		{
+			if (wordStart && c >= 'a' && c <= 'z')
+			{
+				text[i] = (char)(c - 32);
+			}
+			else if (!wordStart && c >= 'A' && c <= 'Z')
+			{
+				text[i] = (char)(c + 32);
+			}
+			wordStart = isWordBreak(c);
+			i++;
+			continue;
+		}
+
+		// Only two byte characters have a case in our table, the rest are just letters
+		if ((c & 0xE0) != 0xC0)
+		{
+			size_t n = (c & 0xF0) == 0xE0 ? 3 : 4;
+			i += n;
+			wordStart = false;
+			continue;
+		}
+
+		uint32_t cp = ((c & 0x1F) << 6) | ((uint8_t)text[i + 1] & 0x3F);
+		uint32_t mapped = wordStart ? toUpper(cp) : toLower(cp);
+		if (mapped != cp)
+		{
+			putUtf8(text + i, mapped, 2);
+		}
+		wordStart = isWordBreak(cp);
+		i += 2;
+	}
+}
+
+size_t TitleCase::normalise(char *text, size_t len, size_t capacity)
+{
+	return normaliseInto(text, capacity, text, len);
+}
+
+size_t TitleCase::normaliseInto(char *out, size_t capacity, const char *text, size_t len)
+{
+	if (capacity == 0)
+	{
+		return 0;
+	}
+
+	size_t validLen;
+	textEncoding encoding = detect(text, len, validLen);
+	if (encoding != kLatin1)
+	{
+		len = validLen;
+	}
+
+	// Back up to the start of a character rather than cut one in half
+	if (len > capacity - 1)
+	{
+		len = capacity - 1;
+		while (encoding == kUtf8 && len > 0 && ((uint8_t)text[len] & 0xC0) == 0x80)
+		{
+			len--;
+		}
+	}
+
+	memmove(out, text, len);
+	if (encoding == kLatin1)
+	{
+		len = latin1ToUtf8(out, len, capacity);
+	}
+
+	out[len] = '\0';
+	titleCaseUtf8(out, len);
+	return len;
+}
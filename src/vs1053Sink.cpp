@@ -0,0 +1,43 @@
+#include "vs1053Sink.h"
+
+Vs1053Sink::Vs1053Sink(VS1053 &player)
+	: player(player)
+{
+}
+
+bool Vs1053Sink::ready()
+{
+	return player.data_request();
+}
+
+size_t Vs1053Sink::write(const uint8_t *data, size_t len)
+{
+	// Never more than the VS1053 is guaranteed to have room for when DREQ is high
+	if (len > chunkSize())
+	{
+		len = chunkSize();
+	}
+	player.sendDataChunk(data, len);
+	return len;
+}
+
+void Vs1053Sink::setVolume(uint8_t volume)
+{
+	player.setVolume(volume);
+}
+
+void Vs1053Sink::flush()
+{
+	// Abandon the current bitstream (SM_CANCEL), a soft reset only if that fails
+	player.cancelSong();
+}
+
+void Vs1053Sink::beginBurst()
+{
+	player.startDataBurst();
+}
+
+void Vs1053Sink::endBurst()
+{
+	player.endDataBurst();
+}
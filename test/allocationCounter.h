@@ -0,0 +1,36 @@
+/*
+	Counts every allocation made through operator new, for the suites
+	whose code under test mustn't touch the heap. Include it in one file
+	per suite only, it replaces the global operator new and delete.
+
+	allocations  how many there have been, reset it before the code under
+	             test runs and check it after
+*/
+#pragma once
+
+#include <new>
+#include <stddef.h>
+#include <stdlib.h>
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+	allocations++;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,92 @@
+/*
+	The Arduino ESP32 core's cbuf (cores/esp32/cbuf.cpp, 2.0.x), as the
+	radio used it before AudioRingBuffer, so the ring buffer benchmark has
+	something real to beat. Same algorithm: plain begin/end pointers, one
+	byte kept free, write() and read() copy in at most two memcpy()s at the
+	wrap. Only the parts the radio used are here. Test code only.
+
+	cbuf.cpp - Circular buffer implementation
+	Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
+	This file is part of the esp8266 core for Arduino environment.
+	GNU Lesser General Public License 2.1 or later.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+class cbuf
+{
+public:
+	cbuf(size_t size) : _size(size), _buf(new char[size]), _bufend(_buf + size), _begin(_buf), _end(_begin) {}
+	~cbuf() { delete[] _buf; }
+
+	size_t available() const
+	{
+		if (_end >= _begin)
+		{
+			return _end - _begin;
+		}
+		return _size - (_begin - _end);
+	}
+
+	size_t room() const
+	{
+		if (_end >= _begin)
+		{
+			return _size - (_end - _begin) - 1;
+		}
+		return _begin - _end - 1;
+	}
+
+	size_t read(char *dst, size_t size)
+	{
+		size_t bytes_available = available();
+		size_t size_to_read = (size < bytes_available) ? size : bytes_available;
+		size_t size_read = size_to_read;
+		if (_end < _begin && size_to_read > (size_t)(_bufend - _begin))
+		{
+			size_t top_size = _bufend - _begin;
+			memcpy(dst, _begin, top_size);
+			_begin = _buf;
+			size_to_read -= top_size;
+			dst += top_size;
+		}
+		memcpy(dst, _begin, size_to_read);
+		_begin = wrap_if_bufend(_begin + size_to_read);
+		return size_read;
+	}
+
+	size_t write(const char *src, size_t size)
+	{
+		size_t bytes_available = room();
+		size_t size_to_write = (size < bytes_available) ? size : bytes_available;
+		size_t size_written = size_to_write;
+		if (_end >= _begin && size_to_write > (size_t)(_bufend - _end))
+		{
+			size_t top_size = _bufend - _end;
+			memcpy(_end, src, top_size);
+			_end = _buf;
+			size_to_write -= top_size;
+			src += top_size;
+		}
+		memcpy(_end, src, size_to_write);
+		_end = wrap_if_bufend(_end + size_to_write);
+		return size_written;
+	}
+
+	void flush()
+	{
+		_begin = _buf;
+		_end = _buf;
+	}
+
+private:
+	char *wrap_if_bufend(char *ptr) const { return (ptr == _bufend) ? _buf : ptr; }
+
+	size_t _size;
+	char *_buf;
+	const char *_bufend;
+	char *_begin;
+	char *_end;
+};
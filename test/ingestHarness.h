@@ -0,0 +1,82 @@
+/*
+	Stand-ins for the station and the clock, so IngestLoop (see
+	ingestLoop.h) can be run on the host. Test code only, the firmware
+	has WiFiStreamSource and ArduinoClock (main.h).
+
+	- CannedStream  hands out a fixed run of bytes a piece at a time, then
+	                hangs up (or goes quiet, for stall tests)
+	- ManualClock   time only moves when told to
+	- PortClock     real time, from monotonicMicros() (taskPort.h)
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ingestLoop.h"
+#include "taskPort.h"
+
+// A fixed run of bytes, in pieces of at most pieceBytes per read
+class CannedStream : public StreamSource
+{
+public:
+	// Once it has all been read: hang up, or stay connected and send nothing
+	CannedStream(const uint8_t *data, size_t len, size_t pieceBytes, bool closeAtEnd = true)
+		: data(data), len(len), pieceBytes(pieceBytes ? pieceBytes : 1), closeAtEnd(closeAtEnd), position(0)
+	{
+	}
+
+	int available() override
+	{
+		size_t left = len - position;
+		return (int)(left < pieceBytes ? left : pieceBytes);
+	}
+
+	int read(uint8_t *out, size_t outLen) override
+	{
+		size_t n = (size_t)available();
+		if (n > outLen)
+		{
+			n = outLen;
+		}
+		memcpy(out, data + position, n);
+		position += n;
+		return (int)n;
+	}
+
+	bool connected() override { return !closeAtEnd || position < len; }
+
+	size_t bytesLeft() const { return len - position; }
+
+private:
+	const uint8_t *data;
+	size_t len;
+	size_t pieceBytes;
+	bool closeAtEnd;
+	size_t position;
+};
+
+// Time stands still until advanced
+class ManualClock : public IngestClock
+{
+public:
+	ManualClock(uint32_t startMs = 0) : elapsedMicros((uint64_t)startMs * 1000) {}
+
+	uint32_t nowMs() override { return (uint32_t)(elapsedMicros / 1000); }
+	uint32_t nowMicros() override { return (uint32_t)elapsedMicros; }
+
+	void advanceMs(uint32_t ms) { elapsedMicros += (uint64_t)ms * 1000; }
+	void advanceMicros(uint32_t us) { elapsedMicros += us; }
+
+private:
+	uint64_t elapsedMicros;
+};
+
+// The time as the host task port has it
+class PortClock : public IngestClock
+{
+public:
+	uint32_t nowMs() override { return (uint32_t)(monotonicMicros() / 1000); }
+	uint32_t nowMicros() override { return (uint32_t)monotonicMicros(); }
+};
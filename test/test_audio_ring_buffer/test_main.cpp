@@ -0,0 +1,403 @@
+/*
+	AudioRingBuffer on the host: spans at the wrap point, flush() racing a
+	consume(), a producer and a consumer thread hammering it with a known
+	byte pattern, and how fast audio goes through it compared with the
+	Arduino cbuf it replaced (test/cbufPort.h).
+
+	pio test -e native -f test_audio_ring_buffer
+*/
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unity.h>
+
+#include "../cbufPort.h"
+#include "audioRingBuffer.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Byte n of the test stream
+static uint8_t pattern(size_t n)
+{
+	return (uint8_t)(n * 31 + (n >> 8));
+}
+
+void testEmptyAndFull()
+{
+	AudioRingBuffer ring;
+	TEST_ASSERT_TRUE(ring.begin(100));
+	TEST_ASSERT_EQUAL(100, ring.capacity());
+	TEST_ASSERT_EQUAL(0, ring.available());
+	TEST_ASSERT_EQUAL(100, ring.room());
+	TEST_ASSERT_EQUAL(0, ring.peek().len);
+
+	uint8_t data[150];
+	memset(data, 0x55, sizeof(data));
+	TEST_ASSERT_EQUAL(100, ring.write(data, sizeof(data)));
+	TEST_ASSERT_EQUAL(0, ring.room());
+	TEST_ASSERT_EQUAL(0, ring.reserve().len);
+	TEST_ASSERT_EQUAL(100, ring.available());
+}
+
+void testSpansAtTheWrapPoint()
+{
+	AudioRingBuffer ring;
+	ring.begin(100);
+
+	uint8_t data[100];
+	for (size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = pattern(i);
+	}
+
+	// Move both positions to 70 of the 101 bytes of storage
+	ring.write(data, 70);
+	uint8_t out[100];
+	ring.read(out, 70);
+
+	// The free space is in two pieces: the reservation stops at the end of the storage
+	AudioRingBuffer::Span span = ring.reserve();
+	TEST_ASSERT_EQUAL(31, span.len);
+	memcpy(span.data, data, span.len);
+	ring.commit(span.len);
+	span = ring.reserve();
+	TEST_ASSERT_EQUAL(69, span.len);
+	memcpy(span.data, data + 31, span.len);
+	ring.commit(span.len);
+	TEST_ASSERT_EQUAL(100, ring.available());
+
+	// And so does the data
+	span = ring.peek();
+	TEST_ASSERT_EQUAL(31, span.len);
+	TEST_ASSERT_EQUAL_MEMORY(data, span.data, span.len);
+	ring.consume(span.len);
+	span = ring.peek(32);
+	TEST_ASSERT_EQUAL(32, span.len);
+	TEST_ASSERT_EQUAL_MEMORY(data + 31, span.data, span.len);
+	ring.consume(span.len);
+
+	// The copying wrappers cross the wrap point in one call
+	TEST_ASSERT_EQUAL(37, ring.read(out, sizeof(out)));
+	TEST_ASSERT_EQUAL_MEMORY(data + 63, out, 37);
+	TEST_ASSERT_EQUAL(170, ring.totalWritten());
+	TEST_ASSERT_EQUAL(170, ring.totalRead());
+}
+
+void testFlushDiscardsARacingConsume()
+{
+	AudioRingBuffer ring;
+	ring.begin(64);
+
+	uint8_t data[40];
+	memset(data, 1, sizeof(data));
+	ring.write(data, sizeof(data));
+
+	// The consumer peeks, the producer flushes before it consumes
+	AudioRingBuffer::Span span = ring.peek(32);
+	TEST_ASSERT_EQUAL(32, span.len);
+	ring.flush();
+	TEST_ASSERT_EQUAL(0, ring.available());
+
+	// New station's audio goes in, the stale consume() must not eat it
+	memset(data, 2, sizeof(data));
+	ring.write(data, 10);
+	ring.consume(span.len);
+	TEST_ASSERT_EQUAL(10, ring.available());
+
+	uint8_t out[10];
+	TEST_ASSERT_EQUAL(10, ring.read(out, sizeof(out)));
+	TEST_ASSERT_EQUAL(2, out[0]);
+	TEST_ASSERT_EQUAL(2, out[9]);
+}
+
+// The ingest task and the player task: random sized reservations against 32 byte reads
+void testProducerConsumerStress()
+{
+	const size_t total = 32 * 1024 * 1024;
+	AudioRingBuffer ring;
+	ring.begin(150000);
+
+	std::thread producer([&ring, total]() {
+		uint32_t seed = 12345;
+		size_t written = 0;
+		while (written < total)
+		{
+			seed = seed * 1103515245 + 12345;
+			size_t want = 1 + (seed >> 16) % 1400;
+			if (want > total - written)
+			{
+				want = total - written;
+			}
+			AudioRingBuffer::Span span = ring.reserve(want);
+			for (size_t i = 0; i < span.len; i++)
+			{
+				span.data[i] = pattern(written + i);
+			}
+			ring.commit(span.len);
+			written += span.len;
+			if (span.len == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	size_t read = 0;
+	size_t mismatches = 0;
+	while (read < total)
+	{
+		AudioRingBuffer::Span span = ring.peek(32);
+		for (size_t i = 0; i < span.len; i++)
+		{
+			if (span.data[i] != pattern(read + i))
+			{
+				mismatches++;
+			}
+		}
+		ring.consume(span.len);
+		read += span.len;
+		if (span.len == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+	producer.join();
+
+	TEST_ASSERT_EQUAL(0, mismatches);
+	TEST_ASSERT_EQUAL(0, ring.available());
+	TEST_ASSERT_EQUAL((uint32_t)total, ring.totalWritten());
+	TEST_ASSERT_EQUAL((uint32_t)total, ring.totalRead());
+}
+
+namespace {
+const size_t kBenchBytes = 64 * 1024 * 1024;
+const size_t kBenchCapacity = 150000;
+const size_t kStreamingCharsMax = 100; // what populateRingBuffer() read at a time, into readBuffer
+const size_t kChunk = 32;			   // what the VS1053 takes per DREQ
+
+// Where the producer copies the "stream" from, as the WiFiClient would
+uint8_t station[8192];
+
+struct benchResult
+{
+	double secs;
+	size_t mismatches; // chunks that didn't start with the byte they should have
+};
+
+size_t pieceAt(size_t written, size_t most)
+{
+	size_t offset = written % sizeof(station);
+	size_t left = sizeof(station) - offset;
+	return left < most ? left : most;
+}
+
+// Before: client.read() into readBuffer, then circBuffer.write() once there was room for all of
+// it; the player task read 32 byte chunks out into mp3buff. With two tasks every call needs the
+// lock cbuf doesn't have.
+benchResult runCbuf(bool threaded)
+{
+	cbuf buffer(kBenchCapacity);
+	std::mutex lock;
+	size_t mismatches = 0;
+
+	auto produce = [&](size_t &written) {
+		char readBuffer[kStreamingCharsMax];
+		size_t n = pieceAt(written, kStreamingCharsMax);
+		std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+		if (threaded)
+		{
+			guard.lock();
+		}
+		if (buffer.room() < kStreamingCharsMax)
+		{
+			return false;
+		}
+		if (threaded)
+		{
+			guard.unlock();
+		}
+		memcpy(readBuffer, station + written % sizeof(station), n);
+		if (threaded)
+		{
+			guard.lock();
+		}
+		buffer.write(readBuffer, n);
+		written += n;
+		return true;
+	};
+	auto consume = [&](size_t &read, bool last) {
+		char mp3buff[kChunk];
+		std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+		if (threaded)
+		{
+			guard.lock();
+		}
+		if (buffer.available() < (last ? 1 : kChunk))
+		{
+			return false;
+		}
+		size_t n = buffer.read(mp3buff, kChunk);
+		if (threaded)
+		{
+			guard.unlock();
+		}
+		mismatches += (uint8_t)mp3buff[0] != station[read % sizeof(station)];
+		read += n;
+		return true;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	size_t written = 0, read = 0;
+	if (threaded)
+	{
+		std::atomic<bool> produced(false);
+		std::thread producer([&]() {
+			size_t w = 0;
+			while (w < kBenchBytes)
+			{
+				if (!produce(w))
+				{
+					std::this_thread::yield();
+				}
+			}
+			produced = true;
+		});
+		while (read < kBenchBytes)
+		{
+			if (!consume(read, produced))
+			{
+				std::this_thread::yield();
+			}
+		}
+		producer.join();
+	}
+	else
+	{
+		while (read < kBenchBytes)
+		{
+			while (written < kBenchBytes && produce(written))
+			{
+			}
+			while (consume(read, written == kBenchBytes))
+			{
+			}
+		}
+	}
+	return {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), mismatches};
+}
+
+// Now: the ingest loop reads up to maxRead bytes straight into the free space, the player sends
+// 32 byte chunks straight out of the storage. No lock either side.
+benchResult runRing(bool threaded)
+{
+	AudioRingBuffer ring;
+	ring.begin(kBenchCapacity);
+	size_t mismatches = 0;
+
+	auto produce = [&](size_t &written) {
+		AudioRingBuffer::Span span = ring.reserve(pieceAt(written, 8192));
+		if (!span.len)
+		{
+			return false;
+		}
+		memcpy(span.data, station + written % sizeof(station), span.len);
+		ring.commit(span.len);
+		written += span.len;
+		return true;
+	};
+	auto consume = [&](size_t &read, bool last) {
+		if (ring.available() < (last ? 1 : kChunk))
+		{
+			return false;
+		}
+		AudioRingBuffer::Span span = ring.peek(kChunk);
+		mismatches += span.data[0] != station[read % sizeof(station)];
+		ring.consume(span.len);
+		read += span.len;
+		return true;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	size_t written = 0, read = 0;
+	if (threaded)
+	{
+		std::atomic<bool> produced(false);
+		std::thread producer([&]() {
+			size_t w = 0;
+			while (w < kBenchBytes)
+			{
+				if (!produce(w))
+				{
+					std::this_thread::yield();
+				}
+			}
+			produced = true;
+		});
+		while (read < kBenchBytes)
+		{
+			if (!consume(read, produced))
+			{
+				std::this_thread::yield();
+			}
+		}
+		producer.join();
+	}
+	else
+	{
+		while (read < kBenchBytes)
+		{
+			while (written < kBenchBytes && produce(written))
+			{
+			}
+			while (consume(read, written == kBenchBytes))
+			{
+			}
+		}
+	}
+	return {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), mismatches};
+}
+} // namespace
+
+// The ring buffer against the cbuf it replaced, each used the way the radio used it, in one
+// thread and then with the producer and consumer on two. Reported, not judged.
+void testThroughputAgainstCbuf()
+{
+	for (size_t i = 0; i < sizeof(station); i++)
+	{
+		station[i] = pattern(i);
+	}
+
+	for (bool threaded : {false, true})
+	{
+		benchResult before = runCbuf(threaded);
+		benchResult after = runRing(threaded);
+		TEST_ASSERT_EQUAL(0, before.mismatches);
+		TEST_ASSERT_EQUAL(0, after.mismatches);
+
+		char message[100];
+		snprintf(message, sizeof(message), "%s: cbuf%s %.0f MB/s, AudioRingBuffer %.0f MB/s",
+				 threaded ? "Two threads" : "One thread", threaded ? " (locked)" : "",
+				 kBenchBytes / before.secs / 1e6, kBenchBytes / after.secs / 1e6);
+		TEST_MESSAGE(message);
+	}
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testEmptyAndFull);
+	RUN_TEST(testSpansAtTheWrapPoint);
+	RUN_TEST(testFlushDiscardsARacingConsume);
+	RUN_TEST(testProducerConsumerStress);
+	RUN_TEST(testThroughputAgainstCbuf);
+	return UNITY_END();
+}
@@ -0,0 +1,176 @@
+/*
+	The host audio sinks and feedFromRing(): a RateLimitedSink must push
+	back like the VS1053 does (2KB FIFO, 32 byte chunks) and only take audio
+	as fast as its byte rate, and a FileSink must get the stream exactly as
+	it left the ring buffer, wrap point and all.
+
+	pio test -e native -f test_audio_sink
+*/
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+#include "audioRingBuffer.h"
+#include "audioSink.h"
+#include "taskPort.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+namespace {
+void fill(AudioRingBuffer &ring, size_t len, size_t first = 0)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		uint8_t b = (uint8_t)((first + i) * 7);
+		ring.write(&b, 1);
+	}
+}
+} // namespace
+
+void testNoRateNeverPushesBack()
+{
+	AudioRingBuffer ring;
+	ring.begin(10000);
+	fill(ring, 10000);
+
+	RateLimitedSink sink(0);
+	TEST_ASSERT_EQUAL(10000, feedFromRing(ring, sink));
+	TEST_ASSERT_EQUAL(0, ring.available());
+	TEST_ASSERT_EQUAL(10000, sink.bytesWritten());
+}
+
+void testFifoPushesBack()
+{
+	AudioRingBuffer ring;
+	ring.begin(10000);
+	fill(ring, 10000);
+
+	// Slow enough that nothing plays out while we fill it
+	RateLimitedSink sink(1, 2048);
+	TEST_ASSERT_EQUAL(2048, feedFromRing(ring, sink));
+	TEST_ASSERT_FALSE(sink.ready());
+	TEST_ASSERT_EQUAL(0, feedFromRing(ring, sink));
+	TEST_ASSERT_EQUAL(10000 - 2048, ring.available());
+
+	// A station change throws the FIFO away
+	sink.flush();
+	TEST_ASSERT_TRUE(sink.ready());
+	TEST_ASSERT_EQUAL(2048, feedFromRing(ring, sink));
+}
+
+void testChunksAreAtMost32Bytes()
+{
+	RateLimitedSink sink(0);
+	uint8_t data[100];
+	memset(data, 0, sizeof(data));
+	TEST_ASSERT_EQUAL(32, sink.chunkSize());
+	TEST_ASSERT_EQUAL(32, sink.write(data, sizeof(data)));
+}
+
+void testWaitsForMinBytes()
+{
+	AudioRingBuffer ring;
+	ring.begin(100);
+	fill(ring, 31);
+
+	RateLimitedSink sink(0);
+	TEST_ASSERT_EQUAL(0, feedFromRing(ring, sink));
+	fill(ring, 1);
+	TEST_ASSERT_EQUAL(32, feedFromRing(ring, sink));
+}
+
+void testVolumeIsClamped()
+{
+	RateLimitedSink sink;
+	sink.setVolume(150);
+	TEST_ASSERT_EQUAL(100, sink.volume());
+	sink.setVolume(40);
+	TEST_ASSERT_EQUAL(40, sink.volume());
+}
+
+// Half a second at 64000 bytes/sec: the FIFO's worth plus what played out, never more
+void testTakesAudioAtItsByteRate()
+{
+	const uint32_t rate = 64000;
+	AudioRingBuffer ring;
+	ring.begin(100000);
+	fill(ring, 100000);
+
+	RateLimitedSink sink(rate, 2048);
+	uint64_t start = monotonicMicros();
+	while (monotonicMicros() - start < 500000)
+	{
+		feedFromRing(ring, sink);
+		taskSleepMs(1);
+	}
+	uint64_t elapsed = monotonicMicros() - start;
+
+	uint64_t most = 2048 + elapsed * rate / 1000000;
+	char message[80];
+	snprintf(message, sizeof(message), "%lu bytes in %lu us, at most %lu",
+			 (unsigned long)sink.bytesWritten(), (unsigned long)elapsed, (unsigned long)most);
+	TEST_MESSAGE(message);
+	TEST_ASSERT_LESS_OR_EQUAL(most, sink.bytesWritten());
+
+	// A loaded machine may not come back round in time, but it should manage half
+	TEST_ASSERT_GREATER_THAN(2048 + (most - 2048) / 2, sink.bytesWritten());
+}
+
+void testFileGetsTheStreamAcrossTheWrap()
+{
+	const char *path = "test_audio_sink.mp3";
+	AudioRingBuffer ring;
+	ring.begin(1000);
+
+	FileSink sink;
+	TEST_ASSERT_TRUE(sink.open(path));
+
+	// Several times round the ring, so the spans split at the end of the storage
+	size_t written = 0;
+	while (written < 5000)
+	{
+		size_t len = ring.room() < 333 ? ring.room() : 333;
+		fill(ring, len, written);
+		written += len;
+		feedFromRing(ring, sink);
+	}
+	feedFromRing(ring, sink, 1);
+	sink.close();
+
+	FILE *file = fopen(path, "rb");
+	TEST_ASSERT_NOT_NULL(file);
+	std::vector<uint8_t> contents(6000);
+	size_t len = fread(contents.data(), 1, contents.size(), file);
+	fclose(file);
+	remove(path);
+
+	TEST_ASSERT_EQUAL(written, len);
+	for (size_t i = 0; i < len; i++)
+	{
+		if (contents[i] != (uint8_t)(i * 7))
+		{
+			TEST_FAIL_MESSAGE("file differs from what went into the ring buffer");
+		}
+	}
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testNoRateNeverPushesBack);
+	RUN_TEST(testFifoPushesBack);
+	RUN_TEST(testChunksAreAtMost32Bytes);
+	RUN_TEST(testWaitsForMinBytes);
+	RUN_TEST(testVolumeIsClamped);
+	RUN_TEST(testTakesAudioAtItsByteRate);
+	RUN_TEST(testFileGetsTheStreamAcrossTheWrap);
+	return UNITY_END();
+}
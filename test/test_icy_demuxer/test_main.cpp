@@ -0,0 +1,268 @@
+/*
+	IcyDemuxer on the host: a made up ICY stream is pushed through in reads
+	of every size from 1 byte up, and straight into a small ring buffer the
+	way the ingest task does it (so metadata blocks are split where the free
+	space wraps). The audio must come out untouched and every title once.
+
+	pio test -e native -f test_icy_demuxer
+*/
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#include "audioRingBuffer.h"
+#include "icyDemuxer.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+namespace {
+const uint32_t kMetaInt = 100;
+
+struct testStream
+{
+	std::vector<uint8_t> bytes; // as the server sends it
+	std::vector<uint8_t> audio; // what should come out
+	std::vector<std::string> titles;
+};
+
+// blocks intervals of audio, a title after every fourth one and empty metadata after the rest
+testStream makeStream(size_t blocks)
+{
+	testStream stream;
+	for (size_t block = 0; block < blocks; block++)
+	{
+		for (size_t i = 0; i < kMetaInt; i++)
+		{
+			uint8_t b = (uint8_t)(block * 13 + i * 7);
+			stream.bytes.push_back(b);
+			stream.audio.push_back(b);
+		}
+
+		if (block % 4 == 0)
+		{
+			char text[64];
+			int len = snprintf(text, sizeof(text), "StreamTitle='Track %u';", (unsigned)block);
+			size_t units = (len + 15) / 16;
+			stream.bytes.push_back((uint8_t)units);
+			stream.bytes.insert(stream.bytes.end(), text, text + len);
+			stream.bytes.insert(stream.bytes.end(), units * 16 - len, 0);
+			stream.titles.push_back(text);
+		}
+		else
+		{
+			stream.bytes.push_back(0);
+		}
+	}
+	return stream;
+}
+
+void collect(char *text, size_t len, void *context)
+{
+	(void)len;
+	static_cast<std::vector<std::string> *>(context)->push_back(text);
+}
+
+void countTitle(char *text, size_t len, void *context)
+{
+	(void)text;
+	(void)len;
+	(*static_cast<size_t *>(context))++;
+}
+} // namespace
+
+void testNoMetadataIsAllAudio()
+{
+	IcyDemuxer demuxer;
+	demuxer.reset(0);
+	uint8_t data[50];
+	memset(data, 7, sizeof(data));
+	TEST_ASSERT_EQUAL(50, demuxer.process(data, sizeof(data), 0, nullptr, nullptr));
+	TEST_ASSERT_EQUAL(0, demuxer.metadataBlocks());
+}
+
+void testEveryReadSize()
+{
+	testStream stream = makeStream(40);
+
+	for (size_t readSize = 1; readSize <= 300; readSize++)
+	{
+		IcyDemuxer demuxer;
+		demuxer.reset(kMetaInt);
+		std::vector<uint8_t> bytes = stream.bytes;
+		std::vector<uint8_t> audio;
+		std::vector<std::string> titles;
+
+		for (size_t pos = 0; pos < bytes.size(); pos += readSize)
+		{
+			size_t len = bytes.size() - pos < readSize ? bytes.size() - pos : readSize;
+			size_t audioLen = demuxer.process(&bytes[pos], len, 0, collect, &titles);
+			audio.insert(audio.end(), &bytes[pos], &bytes[pos] + audioLen);
+		}
+
+		char message[40];
+		snprintf(message, sizeof(message), "read size %u", (unsigned)readSize);
+		TEST_ASSERT_TRUE_MESSAGE(audio == stream.audio, message);
+		TEST_ASSERT_TRUE_MESSAGE(titles == stream.titles, message);
+		TEST_ASSERT_EQUAL_MESSAGE(40, demuxer.metadataBlocks(), message);
+		TEST_ASSERT_FALSE_MESSAGE(demuxer.inMetadata(), message);
+	}
+}
+
+// As the ingest task does it: read into the ring's free space (which stops at the end of the
+// storage), demux in place, commit the audio, let the player take some out
+void testBlocksSplitAcrossReserveSpans()
+{
+	testStream stream = makeStream(60);
+	uint32_t splitBlocks = 0;
+
+	for (size_t capacity = 150; capacity < 200; capacity += 7)
+	{
+		AudioRingBuffer ring;
+		ring.begin(capacity);
+		IcyDemuxer demuxer;
+		demuxer.reset(kMetaInt);
+		std::vector<uint8_t> audio;
+		std::vector<std::string> titles;
+		uint32_t now = 0;
+
+		size_t pos = 0;
+		while (pos < stream.bytes.size() || ring.available())
+		{
+			AudioRingBuffer::Span span = ring.reserve(stream.bytes.size() - pos < 90 ? stream.bytes.size() - pos : 90);
+			memcpy(span.data, &stream.bytes[pos], span.len);
+			pos += span.len;
+			ring.commit(demuxer.process(span.data, span.len, now++, collect, &titles));
+
+			uint8_t out[64];
+			size_t n = ring.read(out, sizeof(out));
+			audio.insert(audio.end(), out, out + n);
+		}
+
+		TEST_ASSERT_TRUE(audio == stream.audio);
+		TEST_ASSERT_TRUE(titles == stream.titles);
+		splitBlocks += demuxer.splitBlocks();
+	}
+
+	// Or it didn't test anything
+	TEST_ASSERT_GREATER_THAN(0, splitBlocks);
+}
+
+void testSplitBlocksAreCountedAndTimed()
+{
+	testStream stream = makeStream(1);
+	IcyDemuxer demuxer;
+	demuxer.reset(kMetaInt);
+	std::vector<std::string> titles;
+
+	// Audio and the length byte, then the text 250ms later in two goes
+	std::vector<uint8_t> bytes = stream.bytes;
+	demuxer.process(&bytes[0], kMetaInt + 1, 1000, collect, &titles);
+	TEST_ASSERT_TRUE(demuxer.inMetadata());
+	demuxer.process(&bytes[kMetaInt + 1], 5, 1100, collect, &titles);
+	TEST_ASSERT_EQUAL(0, titles.size());
+	demuxer.process(&bytes[kMetaInt + 6], bytes.size() - kMetaInt - 6, 1250, collect, &titles);
+
+	TEST_ASSERT_EQUAL(1, titles.size());
+	TEST_ASSERT_EQUAL(1, demuxer.splitBlocks());
+	TEST_ASSERT_EQUAL(250, demuxer.longestMetadataMs());
+	TEST_ASSERT_EQUAL(kMetaInt, demuxer.bytesUntilMetadata());
+}
+
+void testUnfinishedBlockIsOverdue()
+{
+	IcyDemuxer demuxer;
+	demuxer.reset(10);
+	uint8_t bytes[12];
+	memset(bytes, 0, sizeof(bytes));
+	bytes[10] = 2; // 32 bytes of metadata coming
+	bytes[11] = 'S';
+	demuxer.process(bytes, sizeof(bytes), 5000, nullptr, nullptr);
+
+	TEST_ASSERT_FALSE(demuxer.metadataOverdue(5000 + IcyDemuxer::metadataDeadlineMs));
+	TEST_ASSERT_TRUE(demuxer.metadataOverdue(5001 + IcyDemuxer::metadataDeadlineMs));
+}
+
+// Reported, not judged: how fast a stream goes through in 4K reads at the metadata intervals
+// stations use, with a title and its URL every eighth block as Global and Bauer stations send them
+void testThroughput()
+{
+	const size_t streamBytes = 1024 * 1024;
+	const char *const titles[] = {
+		"StreamTitle='Love Is The Drug - Roxy Music';"
+		"StreamUrl='https://listenapi.planetradio.co.uk/api9/eventdata/62247302';",
+		"StreamTitle='Fleetwood Mac - Go Your Own Way (2004 Remaster)';"
+		"StreamUrl='https://listenapi.planetradio.co.uk/api9/eventdata/62247303';",
+	};
+
+	for (uint32_t metaInt : {8192u, 16000u, 32768u})
+	{
+		std::vector<uint8_t> bytes;
+		size_t blocks = streamBytes / metaInt;
+		size_t titleBlocks = 0;
+		for (size_t block = 0; block < blocks; block++)
+		{
+			for (size_t i = 0; i < metaInt; i++)
+			{
+				bytes.push_back((uint8_t)(block * 13 + i * 7));
+			}
+			if (block % 8)
+			{
+				bytes.push_back(0);
+				continue;
+			}
+			const char *text = titles[(block / 8) % 2];
+			size_t len = strlen(text);
+			size_t units = (len + 15) / 16;
+			bytes.push_back((uint8_t)units);
+			bytes.insert(bytes.end(), text, text + len);
+			bytes.insert(bytes.end(), units * 16 - len, 0);
+			titleBlocks++;
+		}
+
+		IcyDemuxer demuxer;
+		std::vector<uint8_t> work(bytes.size());
+		const int passes = 200;
+		size_t audioBytes = 0;
+		size_t titlesSeen = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+		{
+			demuxer.reset(metaInt);
+			memcpy(work.data(), bytes.data(), bytes.size());
+			for (size_t pos = 0; pos < work.size(); pos += 4096)
+			{
+				size_t len = work.size() - pos < 4096 ? work.size() - pos : 4096;
+				audioBytes += demuxer.process(&work[pos], len, 0, countTitle, &titlesSeen);
+			}
+		}
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		TEST_ASSERT_EQUAL((size_t)passes * blocks * metaInt, audioBytes);
+		TEST_ASSERT_EQUAL((size_t)passes * titleBlocks, titlesSeen);
+		char message[60];
+		snprintf(message, sizeof(message), "metaint %u: demuxed %.0f MB/s", (unsigned)metaInt,
+				 (double)passes * bytes.size() / secs / 1e6);
+		TEST_MESSAGE(message);
+	}
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testNoMetadataIsAllAudio);
+	RUN_TEST(testEveryReadSize);
+	RUN_TEST(testBlocksSplitAcrossReserveSpans);
+	RUN_TEST(testSplitBlocksAreCountedAndTimed);
+	RUN_TEST(testUnfinishedBlockIsOverdue);
+	RUN_TEST(testThroughput);
+	return UNITY_END();
+}
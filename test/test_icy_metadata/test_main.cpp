@@ -0,0 +1,186 @@
+/*
+	IcyMetadata on the host, against the kind of blocks stations really
+	send: quotes and semicolons inside titles, escaped quotes, extra keys,
+	unquoted values, padding, UTF-8 and blocks that were cut off. Then the
+	whole corpus over and over, timed, with every allocation counted.
+
+	pio test -e native -f test_icy_metadata
+*/
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "../allocationCounter.h"
+#include "icyDemuxer.h"
+#include "icyMetadata.h"
+
+namespace {
+const char *const corpus[] = {
+	"StreamTitle='Love Is The Drug - Roxy Music';"
+	"StreamUrl='https://listenapi.planetradio.co.uk/api9/eventdata/62247302';",
+	"StreamTitle='Guns N' Roses - Sweet Child O' Mine';StreamUrl='';",
+	"StreamTitle='Artist; feat. Other - Song';",
+	"StreamTitle='It\\'s Escaped - Band';StreamUrl='http://x/y';adw_ad='true';durationMilliseconds='30000';",
+	"StreamTitle='';",
+	"StreamTitle=Unquoted Title;StreamUrl='u';",
+	"StreamTitle='Кино - Группа крови';StreamUrl='';",
+	"StreamTitle='Cut off part way",
+};
+
+// Big enough for the largest block the demuxer can hand over, plus its null
+char block[IcyDemuxer::maxMetadataLength + 1];
+IcyMetadata metadata;
+
+size_t parse(const char *text)
+{
+	size_t len = strlen(text);
+	memcpy(block, text, len + 1);
+	return metadata.parse(block, len);
+}
+
+void assertTitle(const char *expected)
+{
+	const IcyMetadata::Span *title = metadata.streamTitle();
+	TEST_ASSERT_NOT_NULL(title);
+	TEST_ASSERT_EQUAL_STRING(expected, title->text);
+	TEST_ASSERT_EQUAL(strlen(expected), title->len);
+}
+} // namespace
+
+void setUp()
+{
+	memset(block, 0, sizeof(block));
+}
+
+void tearDown()
+{
+}
+
+void testTitleAndUrl()
+{
+	TEST_ASSERT_EQUAL(2, parse("StreamTitle='Love Is The Drug - Roxy Music';"
+							   "StreamUrl='https://listenapi.planetradio.co.uk/api9/eventdata/62247302';"));
+	assertTitle("Love Is The Drug - Roxy Music");
+	TEST_ASSERT_EQUAL_STRING("https://listenapi.planetradio.co.uk/api9/eventdata/62247302", metadata.streamUrl()->text);
+	TEST_ASSERT_FALSE(metadata.malformed());
+}
+
+void testQuotesInsideTheTitle()
+{
+	TEST_ASSERT_EQUAL(2, parse("StreamTitle='Guns N' Roses - Sweet Child O' Mine';StreamUrl='';"));
+	assertTitle("Guns N' Roses - Sweet Child O' Mine");
+	TEST_ASSERT_TRUE(metadata.streamUrl()->empty());
+}
+
+void testSemicolonsInsideTheTitle()
+{
+	TEST_ASSERT_EQUAL(1, parse("StreamTitle='Artist; feat. Other - Song';"));
+	assertTitle("Artist; feat. Other - Song");
+
+	// Even "';" followed by something that isn't a key
+	parse("StreamTitle='Rock';n'Roll - Band';StreamUrl='';");
+	assertTitle("Rock';n'Roll - Band");
+}
+
+void testEscapedQuoteAndExtraKeys()
+{
+	TEST_ASSERT_EQUAL(4, parse("StreamTitle='It\\'s Escaped - Band';StreamUrl='http://x/y';"
+							   "adw_ad='true';durationMilliseconds='30000';"));
+	assertTitle("It's Escaped - Band");
+	TEST_ASSERT_EQUAL_STRING("adw_ad", metadata.field(2).key.text);
+	TEST_ASSERT_EQUAL_STRING("30000", metadata.field(3).value.text);
+}
+
+void testKeysIgnoreCase()
+{
+	parse("streamtitle='lower case key';");
+	assertTitle("lower case key");
+	TEST_ASSERT_NULL(metadata.streamUrl());
+}
+
+void testEmptyAndUnquotedValues()
+{
+	TEST_ASSERT_EQUAL(1, parse("StreamTitle='';"));
+	assertTitle("");
+
+	TEST_ASSERT_EQUAL(2, parse("StreamTitle=Unquoted Title;StreamUrl='u';"));
+	assertTitle("Unquoted Title");
+	TEST_ASSERT_EQUAL_STRING("u", metadata.streamUrl()->text);
+}
+
+void testPaddedBlock()
+{
+	// The demuxer hands over the whole block, nulls and all
+	const char text[] = "StreamTitle='Padded';";
+	memcpy(block, text, sizeof(text));
+	TEST_ASSERT_EQUAL(1, metadata.parse(block, 32));
+	assertTitle("Padded");
+}
+
+void testUtf8IsLeftAlone()
+{
+	parse("StreamTitle='Кино - Группа крови';StreamUrl='';");
+	assertTitle("Кино - Группа крови");
+}
+
+void testCutOffBlock()
+{
+	TEST_ASSERT_EQUAL(1, parse("StreamTitle='Cut off part way"));
+	assertTitle("Cut off part way");
+	TEST_ASSERT_TRUE(metadata.malformed());
+
+	parse("not metadata at all");
+	TEST_ASSERT_EQUAL(0, metadata.count());
+	TEST_ASSERT_TRUE(metadata.malformed());
+}
+
+void testTooManyFieldsAreCounted()
+{
+	parse("a='1';b='2';c='3';d='4';e='5';f='6';g='7';h='8';i='9';j='10';");
+	TEST_ASSERT_EQUAL(IcyMetadata::maxFields, metadata.count());
+	TEST_ASSERT_EQUAL(2, metadata.dropped());
+}
+
+// Reported, not judged: the corpus parsed a hundred thousand times, and nothing allocated
+void testCorpusBenchmark()
+{
+	const int passes = 100000;
+	size_t titles = 0;
+
+	allocations = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (const char *text : corpus)
+		{
+			parse(text);
+			titles += metadata.streamTitle() != nullptr;
+		}
+	}
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	TEST_ASSERT_EQUAL(0, allocations);
+	TEST_ASSERT_EQUAL((size_t)passes * (sizeof(corpus) / sizeof(corpus[0])), titles);
+	char message[80];
+	snprintf(message, sizeof(message), "%.0f blocks/s, %lu allocations",
+			 passes * (sizeof(corpus) / sizeof(corpus[0])) / secs, (unsigned long)allocations);
+	TEST_MESSAGE(message);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testTitleAndUrl);
+	RUN_TEST(testQuotesInsideTheTitle);
+	RUN_TEST(testSemicolonsInsideTheTitle);
+	RUN_TEST(testEscapedQuoteAndExtraKeys);
+	RUN_TEST(testKeysIgnoreCase);
+	RUN_TEST(testEmptyAndUnquotedValues);
+	RUN_TEST(testPaddedBlock);
+	RUN_TEST(testUtf8IsLeftAlone);
+	RUN_TEST(testCutOffBlock);
+	RUN_TEST(testTooManyFieldsAreCounted);
+	RUN_TEST(testCorpusBenchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,476 @@
+/*
+	IngestLoop on the host, fed by a CannedStream and timed by a
+	ManualClock: a made up ICY stream must come out of the ring buffer
+	exactly, titles and all, whatever size pieces it arrives in, and each
+	way of losing a stream (hung up, gone quiet, metadata out of sync or
+	never finished) must be noticed and named.
+
+	Then the way the firmware runs it, on the host task port (taskPort.h):
+	a station task sending packets through a MessageQueue, an ingest task
+	stepping the loop in real time and a player task taking the audio out
+	of the ring buffer as it arrives.
+
+	pio test -e native -f test_ingest_loop
+*/
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#include "../ingestHarness.h"
+#include "ingestLoop.h"
+#include "taskPort.h"
+
+namespace {
+const uint32_t kMetaInt = 100;
+const uint32_t kDrainRate = 16000;
+
+// Everything the loop works with, reset for a new station
+struct testStation
+{
+	AudioRingBuffer ring;
+	IcyDemuxer demuxer;
+	PrebufferController prebuffer;
+	StallWatchdog stallWatchdog;
+	ManualClock clock;
+
+	testStation(size_t capacity, uint32_t metaInt)
+	{
+		ring.begin(capacity);
+		prebuffer.begin(capacity);
+		demuxer.reset(metaInt);
+		prebuffer.reset(0);
+		stallWatchdog.reset(0);
+	}
+};
+
+IngestLoop *current;
+std::vector<std::string> titles;
+
+// As handleMetaData() does it: anything that isn't text means we've lost our place
+void collect(char *text, size_t len, void *context)
+{
+	(void)context;
+	for (size_t i = 0; i < len; i++)
+	{
+		if (text[i] && (uint8_t)text[i] < ' ')
+		{
+			current->outOfSync();
+			return;
+		}
+	}
+	titles.push_back(text);
+}
+
+// Step (moving the clock on each time) until the stream is lost or time is up
+IngestLoop::stepResult run(IngestLoop &loop, ManualClock &clock, uint32_t stepMicros, uint32_t forMs)
+{
+	IngestLoop::stepResult result = IngestLoop::kWaiting;
+	for (uint64_t us = 0; us < (uint64_t)forMs * 1000 && result != IngestLoop::kLost; us += stepMicros)
+	{
+		result = loop.step(kDrainRate);
+		clock.advanceMicros(stepMicros);
+	}
+	return result;
+}
+} // namespace
+
+void setUp()
+{
+	titles.clear();
+}
+
+void tearDown()
+{
+}
+
+void testStreamComesThroughWhole()
+{
+	std::vector<uint8_t> bytes, audio;
+	std::vector<std::string> sent;
+	for (uint32_t block = 0; block < 50; block++)
+	{
+		for (uint32_t i = 0; i < kMetaInt; i++)
+		{
+			uint8_t b = (uint8_t)(block * 7 + i);
+			bytes.push_back(b);
+			audio.push_back(b);
+		}
+		if (block % 10 == 0)
+		{
+			char text[32] = {0};
+			snprintf(text, sizeof(text), "StreamTitle='Track %u';", (unsigned)block);
+			bytes.push_back(2);
+			bytes.insert(bytes.end(), text, text + sizeof(text));
+			sent.push_back(text);
+		}
+		else
+		{
+			bytes.push_back(0);
+		}
+	}
+
+	for (size_t piece : {1, 7, 37, 1000, 4096})
+	{
+		titles.clear();
+		testStation station(8192, kMetaInt);
+		CannedStream stream(bytes.data(), bytes.size(), piece);
+		IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+		current = &loop;
+		loop.setMetadataHandler(collect, nullptr);
+
+		char message[40];
+		snprintf(message, sizeof(message), "%u byte pieces", (unsigned)piece);
+		TEST_ASSERT_EQUAL_MESSAGE(IngestLoop::kLost, run(loop, station.clock, 10, 100000), message);
+		TEST_ASSERT_EQUAL_MESSAGE(IngestLoop::kLostClosed, loop.lostReason(), message);
+		TEST_ASSERT_EQUAL_MESSAGE(0, stream.bytesLeft(), message);
+		TEST_ASSERT_EQUAL_MESSAGE(bytes.size(), loop.stats().bytesRead, message);
+
+		std::vector<uint8_t> out(station.ring.available());
+		station.ring.read(out.data(), out.size());
+		TEST_ASSERT_TRUE_MESSAGE(out == audio, message);
+		TEST_ASSERT_TRUE_MESSAGE(titles == sent, message);
+	}
+}
+
+// Reads are as large as the stream and the ring buffer allow, up to maxRead
+void testReadsAreBatched()
+{
+	std::vector<uint8_t> bytes(3 * IngestLoop::maxRead, 0x55);
+	testStation station(4 * IngestLoop::maxRead, 0);
+	CannedStream stream(bytes.data(), bytes.size(), bytes.size());
+	IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+
+	TEST_ASSERT_EQUAL(IngestLoop::kRead, loop.step(kDrainRate));
+	TEST_ASSERT_EQUAL(IngestLoop::maxRead, loop.lastAudioBytes());
+	TEST_ASSERT_EQUAL(1, loop.stats().readCalls);
+}
+
+void testFullBufferWaitsForThePlayer()
+{
+	std::vector<uint8_t> bytes(1000, 0x55);
+	testStation station(500, 0);
+	CannedStream stream(bytes.data(), bytes.size(), 1000);
+	IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+
+	// Said as soon as the read that filled it, and nothing more is read until there's room
+	TEST_ASSERT_EQUAL(IngestLoop::kBufferFull, loop.step(kDrainRate));
+	TEST_ASSERT_EQUAL(IngestLoop::kBufferFull, loop.step(kDrainRate));
+	TEST_ASSERT_EQUAL(500, stream.bytesLeft());
+	TEST_ASSERT_EQUAL(1, loop.stats().readCalls);
+
+	// The player takes some, the free space wraps so it takes two reads to fill it again
+	uint8_t out[100];
+	station.ring.read(out, sizeof(out));
+	TEST_ASSERT_EQUAL(IngestLoop::kRead, loop.step(kDrainRate));
+	TEST_ASSERT_EQUAL(IngestLoop::kBufferFull, loop.step(kDrainRate));
+	TEST_ASSERT_EQUAL(400, stream.bytesLeft());
+	TEST_ASSERT_EQUAL(3, loop.stats().readCalls);
+}
+
+// Still connected but nothing arriving: given up on once the buffered audio runs low
+void testSilentStationIsStalled()
+{
+	std::vector<uint8_t> bytes(64000, 0xAA);
+	testStation station(200000, 0);
+	station.stallWatchdog.setReconnectCostMs(500);
+	CannedStream stream(bytes.data(), bytes.size(), 160, false);
+	IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+
+	TEST_ASSERT_EQUAL(IngestLoop::kLost, run(loop, station.clock, 10000, 200000));
+	TEST_ASSERT_EQUAL(IngestLoop::kLostStalled, loop.lostReason());
+	TEST_ASSERT_TRUE(stream.connected());
+
+	// Not before the audio we had was close to running out (64000 bytes is 4 seconds)
+	TEST_ASSERT_GREATER_THAN(4000, station.clock.nowMs());
+	TEST_ASSERT_EQUAL(bytes.size(), loop.stats().bytesRead);
+}
+
+// Dribbling in far slower than it plays is a stall too
+void testTrickleIsStalled()
+{
+	std::vector<uint8_t> bytes(20000, 0xAA);
+	testStation station(8192, 0);
+	CannedStream stream(bytes.data(), bytes.size(), 1, false);
+	IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+
+	TEST_ASSERT_EQUAL(IngestLoop::kLost, run(loop, station.clock, 1000, 100000));
+	TEST_ASSERT_EQUAL(IngestLoop::kLostStalled, loop.lostReason());
+	TEST_ASSERT_GREATER_THAN(0, stream.bytesLeft());
+}
+
+void testRubbishMetadataIsOutOfSync()
+{
+	std::vector<uint8_t> bytes(10, 0);
+	const char text[16] = "StreamTitle=\x01x";
+	bytes.push_back(1);
+	bytes.insert(bytes.end(), text, text + sizeof(text));
+	bytes.resize(200, 0);
+
+	testStation station(4096, 10);
+	CannedStream stream(bytes.data(), bytes.size(), 50);
+	IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+	current = &loop;
+	loop.setMetadataHandler(collect, nullptr);
+
+	TEST_ASSERT_EQUAL(IngestLoop::kLost, run(loop, station.clock, 1000, 1000));
+	TEST_ASSERT_EQUAL(IngestLoop::kLostOutOfSync, loop.lostReason());
+	TEST_ASSERT_EQUAL(0, titles.size());
+}
+
+void testUnfinishedMetadataIsOverdue()
+{
+	std::vector<uint8_t> bytes(10, 0);
+	bytes.push_back(4); // 64 bytes of metadata coming, one ever arrives
+	bytes.push_back('S');
+
+	testStation station(4096, 10);
+	CannedStream stream(bytes.data(), bytes.size(), 50, false);
+	IngestLoop loop(stream, station.clock, station.ring, station.demuxer, station.prebuffer, station.stallWatchdog);
+
+	TEST_ASSERT_EQUAL(IngestLoop::kLost, run(loop, station.clock, 100000, 100000));
+	TEST_ASSERT_EQUAL(IngestLoop::kLostMetadataOverdue, loop.lostReason());
+	TEST_ASSERT_GREATER_THAN(IcyDemuxer::metadataDeadlineMs, station.clock.nowMs());
+	TEST_ASSERT_EQUAL_STRING("metadata block overdue", IngestLoop::lostName(loop.lostReason()));
+}
+
+namespace {
+// What a station task sends the ingest task, as a socket would. len 0 means it hung up.
+struct stationPacket
+{
+	uint16_t len;
+	uint8_t data[512];
+};
+
+// The ingest task's end of the "connection"
+class QueueStream : public StreamSource
+{
+public:
+	QueueStream(MessageQueue &packets) : packets(packets), position(0), closed(false)
+	{
+		packet.len = 0;
+	}
+
+	int available() override
+	{
+		if (position == packet.len && !closed && packets.receive(&packet))
+		{
+			position = 0;
+			closed = packet.len == 0;
+		}
+		return packet.len - position;
+	}
+
+	int read(uint8_t *data, size_t len) override
+	{
+		size_t n = (size_t)available();
+		if (n > len)
+		{
+			n = len;
+		}
+		memcpy(data, packet.data + position, n);
+		position += n;
+		return (int)n;
+	}
+
+	bool connected() override { return !closed; }
+
+private:
+	MessageQueue &packets;
+	stationPacket packet;
+	uint16_t position;
+	bool closed;
+};
+
+// The audio byte at position i of the threaded stream
+uint8_t audioByte(size_t i)
+{
+	return (uint8_t)(i * 7 + i / 1000);
+}
+
+// Everything the three tasks share. Left in place (the tasks are detached) even if a test gives up.
+struct threadedRun
+{
+	std::vector<uint8_t> bytes; // as the station sends it
+	size_t audioBytes;
+	std::vector<std::string> sent;
+
+	MessageQueue packets;
+	MessageQueue titlesOut;
+	AudioRingBuffer ring;
+	IcyDemuxer demuxer;
+	PrebufferController prebuffer;
+	StallWatchdog stallWatchdog;
+	PortClock clock;
+
+	std::atomic<bool> ingestDone;
+	std::atomic<int> lost;
+	std::atomic<size_t> played;
+	std::atomic<size_t> wrongBytes;
+	std::atomic<bool> playerDone;
+} threaded;
+
+const uint32_t kThreadedMetaInt = 1000;
+const size_t kThreadedBlocks = 300;
+
+// Sends the stream as fast as the queue (the "TCP window") lets it, with a breather now and
+// again so the ingest task sometimes finds nothing waiting, then hangs up
+void stationTask(void *parameter)
+{
+	threadedRun &run = *static_cast<threadedRun *>(parameter);
+	stationPacket packet;
+	size_t sent = 0;
+
+	for (size_t pos = 0; pos < run.bytes.size(); pos += packet.len)
+	{
+		size_t left = run.bytes.size() - pos;
+		packet.len = (uint16_t)(left < sizeof(packet.data) ? left : sizeof(packet.data));
+		memcpy(packet.data, &run.bytes[pos], packet.len);
+		run.packets.send(&packet, 5000);
+		if (++sent % 16 == 0)
+		{
+			taskSleepMs(1);
+		}
+	}
+
+	packet.len = 0;
+	run.packets.send(&packet, 5000);
+}
+
+// Titles go out on a queue, as handleMetaData() posts them to the UI
+void postTitle(char *text, size_t len, void *context)
+{
+	(void)len;
+	char title[64] = {0};
+	strncpy(title, text, sizeof(title) - 1);
+	static_cast<threadedRun *>(context)->titlesOut.send(title, 1000);
+}
+
+// As ingestTask() in taskHelper.h does it
+void ingestTask(void *parameter)
+{
+	threadedRun &run = *static_cast<threadedRun *>(parameter);
+	QueueStream stream(run.packets);
+	IngestLoop loop(stream, run.clock, run.ring, run.demuxer, run.prebuffer, run.stallWatchdog);
+	loop.setMetadataHandler(postTitle, &run);
+
+	IngestLoop::stepResult result;
+	while ((result = loop.step(kDrainRate)) != IngestLoop::kLost)
+	{
+		if (result != IngestLoop::kRead)
+		{
+			taskSleepMs(1);
+		}
+	}
+
+	run.lost = loop.lostReason();
+	run.ingestDone = true;
+}
+
+// Takes the audio out as it arrives, checking every byte, until the stream has gone and the
+// ring buffer is empty
+void playerTask(void *parameter)
+{
+	threadedRun &run = *static_cast<threadedRun *>(parameter);
+	uint8_t chunk[700];
+
+	while (true)
+	{
+		bool finished = run.ingestDone;
+		size_t n = run.ring.read(chunk, sizeof(chunk));
+		for (size_t i = 0; i < n; i++)
+		{
+			if (chunk[i] != audioByte(run.played + i))
+			{
+				run.wrongBytes++;
+			}
+		}
+		run.played += n;
+
+		if (!n)
+		{
+			if (finished)
+			{
+				break;
+			}
+			taskSleepMs(1);
+		}
+	}
+
+	run.playerDone = true;
+}
+} // namespace
+
+// The station, ingest and player each on their own task, talking through the task port's
+// queues and the ring buffer: every audio byte and title must arrive, in order
+void testTasksOnTheHostTaskPort()
+{
+	threadedRun &run = threaded;
+	run.audioBytes = 0;
+	for (size_t block = 0; block < kThreadedBlocks; block++)
+	{
+		for (uint32_t i = 0; i < kThreadedMetaInt; i++)
+		{
+			run.bytes.push_back(audioByte(run.audioBytes++));
+		}
+		if (block % 10 == 0)
+		{
+			char text[48] = {0};
+			snprintf(text, sizeof(text), "StreamTitle='Artist %u - Track';", (unsigned)block);
+			run.bytes.push_back(3);
+			run.bytes.insert(run.bytes.end(), text, text + sizeof(text));
+			run.sent.push_back(text);
+		}
+		else
+		{
+			run.bytes.push_back(0);
+		}
+	}
+
+	TEST_ASSERT_TRUE(run.packets.begin(sizeof(stationPacket), 8));
+	TEST_ASSERT_TRUE(run.titlesOut.begin(64, 64));
+	TEST_ASSERT_TRUE(run.ring.begin(16 * 1024));
+	run.prebuffer.begin(16 * 1024);
+	run.demuxer.reset(kThreadedMetaInt);
+	run.prebuffer.reset(run.clock.nowMs());
+	run.stallWatchdog.reset(run.clock.nowMs());
+
+	TEST_ASSERT_TRUE(startTask(playerTask, "player", 8192, &run, 2, 1));
+	TEST_ASSERT_TRUE(startTask(ingestTask, "ingest", 8192, &run, 1, 0));
+	TEST_ASSERT_TRUE(startTask(stationTask, "station", 8192, &run, 1, 0));
+
+	uint64_t start = monotonicMicros();
+	while (!run.playerDone && monotonicMicros() - start < 20000000)
+	{
+		taskSleepMs(10);
+	}
+	TEST_ASSERT_TRUE_MESSAGE(run.playerDone, "the tasks didn't finish within 20 seconds");
+
+	std::vector<std::string> titles;
+	char title[64];
+	while (run.titlesOut.receive(title))
+	{
+		titles.push_back(title);
+	}
+
+	TEST_ASSERT_EQUAL(IngestLoop::kLostClosed, run.lost);
+	TEST_ASSERT_EQUAL(run.audioBytes, run.played);
+	TEST_ASSERT_EQUAL(0, run.wrongBytes);
+	TEST_ASSERT_TRUE(titles == run.sent);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testStreamComesThroughWhole);
+	RUN_TEST(testReadsAreBatched);
+	RUN_TEST(testFullBufferWaitsForThePlayer);
+	RUN_TEST(testSilentStationIsStalled);
+	RUN_TEST(testTrickleIsStalled);
+	RUN_TEST(testRubbishMetadataIsOutOfSync);
+	RUN_TEST(testUnfinishedMetadataIsOverdue);
+	RUN_TEST(testTasksOnTheHostTaskPort);
+	return UNITY_END();
+}
@@ -0,0 +1,235 @@
+/*
+	ResponseHeaderParser on the host: ICY and HTTP responses as real
+	stations send them, line ends split across reads, bare CR servers,
+	folding, replies that aren't HTTP at all, no heap use, and how fast
+	it gets through the headers.
+
+	pio test -e native -f test_response_header_parser
+*/
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "../allocationCounter.h"
+#include "responseHeaderParser.h"
+
+namespace {
+ResponseHeaderParser parser;
+
+// What stations answer with: Shoutcast, Icecast and a redirect to another server
+const char *const responses[] = {
+	"ICY 200 OK\r\nicy-notice1:<BR>This stream requires <a href=\"http://www.winamp.com\">Winamp</a><BR>\r\n"
+	"icy-notice2:SHOUTcast DNAS/posix(linux x64) v2.6.1.777<BR>\r\nicy-name:Radio X\r\n"
+	"icy-genre:Rock\r\nicy-url:https://www.globalplayer.com\r\ncontent-type:audio/mpeg\r\n"
+	"icy-pub:1\r\nicy-metaint:16000\r\nicy-br:128\r\n\r\n",
+	"HTTP/1.0 200 OK\r\nServer: Icecast 2.4.0-kh15\r\nDate: Sat, 17 Oct 2026 10:00:00 GMT\r\n"
+	"Content-Type: audio/aacp\r\nCache-Control: no-cache, no-store\r\nExpires: Mon, 26 Jul 1997 05:00:00 GMT\r\n"
+	"Pragma: no-cache\r\nAccess-Control-Allow-Origin: *\r\nicy-br:64\r\nicy-description:Antenne 1\r\n"
+	"icy-genre:Pop\r\nicy-name:Antenne 1 Stuttgart\r\nicy-pub:0\r\nicy-url:https://www.antenne1.de\r\n"
+	"icy-metaint:8192\r\n\r\n",
+	"HTTP/1.1 302 Found\r\nServer: nginx\r\nDate: Sat, 17 Oct 2026 10:00:00 GMT\r\n"
+	"Content-Type: text/html\r\nContent-Length: 138\r\nConnection: close\r\n"
+	"Location: http://edge-bauermz-03-gos2.sharp-stream.com/net2national.mp3?aw_0_1st.skey=1697536800\r\n\r\n",
+};
+
+// Feed text until the parser is done with it, returns what's left (the body)
+const char *feedAll(const char *text, ResponseHeaderParser::parseResult &result)
+{
+	result = ResponseHeaderParser::kNeedMore;
+	while (*text && result == ResponseHeaderParser::kNeedMore)
+	{
+		result = parser.feed(*text++);
+	}
+	return text;
+}
+} // namespace
+
+void setUp()
+{
+	parser.reset();
+}
+
+void tearDown()
+{
+}
+
+void testIcyResponse()
+{
+	ResponseHeaderParser::parseResult result;
+	const char *body = feedAll("ICY 200 OK\r\nicy-notice1:<BR>This stream requires Winamp<BR>\r\n"
+							   "icy-name:Radio X\r\nicy-genre:Rock\r\nicy-br:128\r\n"
+							   "icy-metaint:16000\r\nContent-Type: audio/mpeg\r\n\r\nBODY",
+							   result);
+
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL_STRING("BODY", body);
+	const ResponseHeaderParser::Headers &headers = parser.headers();
+	TEST_ASSERT_EQUAL(200, headers.status);
+	TEST_ASSERT_TRUE(headers.icy);
+	TEST_ASSERT_EQUAL(16000, headers.metaInt);
+	TEST_ASSERT_EQUAL(128, headers.bitRate);
+	TEST_ASSERT_EQUAL_STRING("audio/mpeg", headers.contentType);
+	TEST_ASSERT_EQUAL_STRING("Radio X", headers.name);
+	TEST_ASSERT_EQUAL_STRING("Rock", headers.genre);
+	TEST_ASSERT_EQUAL_STRING("ICY 200 OK", parser.statusLine());
+}
+
+void testRedirectWhateverTheCase()
+{
+	ResponseHeaderParser::parseResult result;
+	const char *body = feedAll("HTTP/1.1 302 Found\r\nLOCATION: http://stream.example.com/live.aac\r\n\r\n", result);
+
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL_STRING("", body);
+	TEST_ASSERT_EQUAL(302, parser.headers().status);
+	TEST_ASSERT_FALSE(parser.headers().icy);
+	TEST_ASSERT_EQUAL_STRING("http://stream.example.com/live.aac", parser.headers().location);
+	TEST_ASSERT_EQUAL(0, parser.headers().metaInt);
+}
+
+// The blank line's CR at the end of one read, its LF at the start of the next: the LF is still
+// the parser's, the body mustn't start with it
+void testCrlfSplitAcrossReads()
+{
+	ResponseHeaderParser::parseResult result;
+	const char *rest = feedAll("HTTP/1.0 200 OK\r\nicy-metaint:8192\r\n\r", result);
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kNeedMore, result);
+	TEST_ASSERT_EQUAL_STRING("", rest);
+
+	const char *body = feedAll("\n\xFF\xFB", result);
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL_STRING("\xFF\xFB", body);
+	TEST_ASSERT_EQUAL(8192, parser.headers().metaInt);
+
+	// And a header line's CRLF split the same way isn't two line ends
+	parser.reset();
+	feedAll("ICY 200 OK\r", result);
+	feedAll("\nicy-br:64\r", result);
+	body = feedAll("\n\r\nX", result);
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL_STRING("X", body);
+	TEST_ASSERT_EQUAL(64, parser.headers().bitRate);
+}
+
+// Some old Shoutcast servers end every line with just a CR, the audio follows the blank line's
+void testBareCrStatusLine()
+{
+	ResponseHeaderParser::parseResult result;
+	const char *body = feedAll("ICY 200 OK\ricy-br:64\ricy-metaint:8192\r\r\xFF\xFB", result);
+
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL_STRING("\xFF\xFB", body);
+	TEST_ASSERT_EQUAL(200, parser.headers().status);
+	TEST_ASSERT_EQUAL(64, parser.headers().bitRate);
+	TEST_ASSERT_EQUAL(8192, parser.headers().metaInt);
+}
+
+void testFoldedHeader()
+{
+	ResponseHeaderParser::parseResult result;
+	const char *body = feedAll("HTTP/1.0 200 OK\nIcy-MetaInt: 32000\nicy-name: Folded\n  name here\n\nBODY", result);
+
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL_STRING("BODY", body);
+	TEST_ASSERT_EQUAL(32000, parser.headers().metaInt);
+	TEST_ASSERT_EQUAL_STRING("Folded name here", parser.headers().name);
+}
+
+void testNotHttpFailsStraightAway()
+{
+	// An HTML error page: wrong from the very first byte
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kBadStatus, parser.feed('<'));
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kBadStatus, parser.feed('h'));
+
+	// Looks like HTTP for four bytes
+	parser.reset();
+	ResponseHeaderParser::parseResult result;
+	const char *rest = feedAll("HTTPX/1.1 200 OK\r\n", result);
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kBadStatus, result);
+	TEST_ASSERT_EQUAL_STRING("/1.1 200 OK\r\n", rest);
+
+	// The right start but no status code: found out at the end of the line, not a timeout later
+	parser.reset();
+	rest = feedAll("ICY OK\r\nicy-br:64\r\n\r\n", result);
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kBadStatus, result);
+	TEST_ASSERT_EQUAL_STRING("\nicy-br:64\r\n\r\n", rest);
+}
+
+void testLongLinesAreCutShort()
+{
+	char response[1024];
+	char value[600];
+	memset(value, 'x', sizeof(value) - 1);
+	value[sizeof(value) - 1] = '\0';
+	snprintf(response, sizeof(response), "ICY 200 OK\r\nicy-notice2:%s\r\nicy-metaint:16000\r\n\r\n", value);
+
+	ResponseHeaderParser::parseResult result;
+	feedAll(response, result);
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL(1, parser.truncatedLines());
+	TEST_ASSERT_EQUAL(16000, parser.headers().metaInt);
+}
+
+void testNoHeapUse()
+{
+	const char *response = "ICY 200 OK\r\nicy-name:Radio X\r\nicy-genre:Rock\r\nicy-br:128\r\n"
+						   "icy-metaint:16000\r\nContent-Type: audio/mpeg\r\n\r\n";
+	ResponseHeaderParser::parseResult result;
+
+	allocations = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		parser.reset();
+		feedAll(response, result);
+	}
+	TEST_ASSERT_EQUAL(ResponseHeaderParser::kComplete, result);
+	TEST_ASSERT_EQUAL(0, allocations);
+}
+
+// Reported, not judged: the responses parsed a hundred thousand times each
+void testParseRate()
+{
+	const int passes = 100000;
+	const size_t count = sizeof(responses) / sizeof(responses[0]);
+	size_t bytes = 0;
+	for (const char *response : responses)
+	{
+		bytes += strlen(response);
+	}
+
+	size_t complete = 0;
+	ResponseHeaderParser::parseResult result;
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (const char *response : responses)
+		{
+			parser.reset();
+			feedAll(response, result);
+			complete += result == ResponseHeaderParser::kComplete;
+		}
+	}
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	TEST_ASSERT_EQUAL((size_t)passes * count, complete);
+	char message[80];
+	snprintf(message, sizeof(message), "%.0f responses/s, %.1f MB/s", passes * count / secs,
+			 passes * bytes / secs / 1e6);
+	TEST_MESSAGE(message);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testIcyResponse);
+	RUN_TEST(testRedirectWhateverTheCase);
+	RUN_TEST(testCrlfSplitAcrossReads);
+	RUN_TEST(testBareCrStatusLine);
+	RUN_TEST(testFoldedHeader);
+	RUN_TEST(testNotHttpFailsStraightAway);
+	RUN_TEST(testLongLinesAreCutShort);
+	RUN_TEST(testNoHeapUse);
+	RUN_TEST(testParseRate);
+	return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/*
+	TitleCase on the host: English, Slovak and Russian/Ukrainian titles in
+	UTF-8 and Windows-1252, Latin-1 growing into a buffer that's too small,
+	UTF-8 cut part way through a character, no heap use, and how long it
+	takes against the std::locale toTitle() it replaced.
+
+	pio test -e native -f test_title_case
+*/
+#include <chrono>
+#include <locale>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+
+#include "../allocationCounter.h"
+#include "titleCase.h"
+
+namespace {
+const char *const corpus[] = {
+	"LOVE IS THE DRUG - ROXY MUSIC",
+	"ДДТ - ЧТО ТАКОЕ ОСЕНЬ",
+	"ELÁN - ČO SA STALO, STALO SA",
+	"\xC9LAN - \xC8O DE LA VIE",
+	"guns n' roses - sweet child o' mine",
+};
+
+// The old way, per byte through std::locale, as tftHelpers.h had it
+std::string toTitle(std::string s, const std::locale &loc = std::locale())
+{
+	bool last = true;
+	for (char &c : s)
+	{
+		c = last ? std::toupper(c, loc) : std::tolower(c, loc);
+		last = std::isspace(c, loc);
+	}
+	return s;
+}
+
+void assertNormalised(const char *expected, const char *text, size_t capacity = 256)
+{
+	char buffer[256];
+	size_t len = strlen(text);
+	memcpy(buffer, text, len + 1);
+	TEST_ASSERT_EQUAL(strlen(expected), TitleCase::normalise(buffer, len, capacity));
+	TEST_ASSERT_EQUAL_STRING(expected, buffer);
+}
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void testLatin()
+{
+	assertNormalised("Love Is The Drug - Roxy Music", "LOVE IS THE DRUG - ROXY MUSIC");
+	assertNormalised("Mötley Crüe (Live)", "MÖTLEY CRÜE (LIVE)");
+	assertNormalised("Elán - Čo Sa Stalo, Stalo Sa", "ELÁN - ČO SA STALO, STALO SA");
+	assertNormalised("Ľudo Ďurovčík - Ťažká Ňufka Ŕíba Ĺ", "ľudo ďurovčík - ŤAŽKÁ ŇUFKA ŔÍBA Ĺ");
+	assertNormalised("Žiadna Šanca", "ŽIADNA ŠANCA");
+}
+
+void testCyrillic()
+{
+	assertNormalised("Ддт - Что Такое Осень", "ДДТ - ЧТО ТАКОЕ ОСЕНЬ");
+	assertNormalised("Кино - Группа Крови", "кино - группа крови");
+	assertNormalised("Ёлка - Прованс", "ЁЛКА - ПРОВАНС");
+	assertNormalised("Ірина Білик - Її", "ІРИНА БІЛИК - ЇЇ");
+}
+
+void testOutsideTheTableIsLeftAlone()
+{
+	assertNormalised("日本 Rock", "日本 ROCK");
+}
+
+void testLatin1IsConverted()
+{
+	size_t validLen;
+	TEST_ASSERT_EQUAL(TitleCase::kLatin1, TitleCase::detect("CAF\xC9", 4, validLen));
+	assertNormalised("Élan - Èo", "\xC9LAN - \xC8O");
+
+	// Ends in what looks like the start of a UTF-8 character
+	assertNormalised("Café", "CAF\xC9");
+
+	// Windows-1252 in 0x80-0x9F
+	assertNormalised("Don’t Stop", "DON\x92T STOP");
+	assertNormalised("Ÿß", "\xFF\xDF");
+}
+
+// Each Latin-1 É becomes two bytes, only the whole ones that fit are kept
+void testLatin1GrowsOnlyAsFarAsItFits()
+{
+	char buffer[8] = "\xC9\xC9\xC9\xC9";
+	TEST_ASSERT_EQUAL(4, TitleCase::normalise(buffer, 4, 6));
+	TEST_ASSERT_EQUAL_STRING("Éé", buffer);
+}
+
+// A UTF-8 title longer than the buffer, with the cut falling inside a two byte character: still
+// UTF-8 (not taken for Latin-1 and converted again), and cut before that character
+void testUtf8CutBetweenCharacters()
+{
+	char text[300] = "ДДТ ";
+	size_t len = strlen(text);
+	while (len < 260)
+	{
+		memcpy(text + len, "Ж", 2);
+		len += 2;
+	}
+	text[len] = '\0';
+
+	for (size_t capacity = 255; capacity <= 256; capacity++)
+	{
+		char out[256];
+		size_t outLen = TitleCase::normaliseInto(out, capacity, text, len);
+		size_t validLen;
+
+		TEST_ASSERT_LESS_THAN(capacity, outLen);
+		TEST_ASSERT_EQUAL(0, (outLen - strlen("Ддт ")) % 2);
+		TEST_ASSERT_EQUAL(TitleCase::kUtf8, TitleCase::detect(out, outLen, validLen));
+		TEST_ASSERT_EQUAL(outLen, validLen);
+		TEST_ASSERT_EQUAL(0, memcmp(out, "Ддт Ж", strlen("Ддт Ж")));
+		TEST_ASSERT_EQUAL(0, memcmp(out + outLen - 2, "ж", 2));
+	}
+
+	// And in place, cut to fit an event's text buffer
+	char buffer[sizeof(text)];
+	memcpy(buffer, text, len + 1);
+	size_t outLen = TitleCase::normaliseInto(buffer, 9, buffer, len);
+	TEST_ASSERT_EQUAL_STRING("Ддт ", buffer);
+	TEST_ASSERT_EQUAL(7, outLen);
+}
+
+// Reported, not judged: per title against toTitle(), which also gets Cyrillic wrong
+void testThroughputAgainstToTitle()
+{
+	const size_t titles = sizeof(corpus) / sizeof(corpus[0]);
+	const int passes = 40000;
+	char buffer[256];
+	size_t total = 0;
+
+	allocations = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (const char *title : corpus)
+		{
+			size_t len = strlen(title);
+			memcpy(buffer, title, len + 1);
+			total += TitleCase::normalise(buffer, len, sizeof(buffer));
+		}
+	}
+	auto middle = std::chrono::steady_clock::now();
+	TEST_ASSERT_EQUAL(0, allocations);
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (const char *title : corpus)
+		{
+			total += toTitle(title).size();
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	TEST_ASSERT_GREATER_THAN(0, total);
+	TEST_ASSERT_EQUAL_STRING("ДДТ - ЧТО", toTitle("ДДТ - ЧТО").c_str());
+
+	char message[80];
+	snprintf(message, sizeof(message), "TitleCase %.0f ns, toTitle() %.0f ns per title",
+			 std::chrono::duration<double, std::nano>(middle - start).count() / (passes * titles),
+			 std::chrono::duration<double, std::nano>(end - middle).count() / (passes * titles));
+	TEST_MESSAGE(message);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testLatin);
+	RUN_TEST(testCyrillic);
+	RUN_TEST(testOutsideTheTableIsLeftAlone);
+	RUN_TEST(testLatin1IsConverted);
+	RUN_TEST(testLatin1GrowsOnlyAsFarAsItFits);
+	RUN_TEST(testUtf8CutBetweenCharacters);
+	RUN_TEST(testThroughputAgainstToTitle);
+	return UNITY_END();
+}
@@ -0,0 +1,138 @@
+/*
+	The VS1053 driver against VS1053Emulator: begin() within the chip's SPI
+	limits, DREQ keeping the FIFO from overflowing, cancelSong() getting rid
+	of a stream with SM_CANCEL (and only soft resetting when the decoder
+	won't let go), and the decoder status read back.
+
+	pio test -e native -f test_vs1053_emulator
+*/
+#include <string.h>
+#include <unity.h>
+
+#include <VS1053.h>
+#include <VS1053Emulator.h>
+
+namespace {
+const uint8_t kSciMode = 0x0;
+const uint8_t kSciDecodeTime = 0x4;
+const uint16_t kSmCancel = 1 << 3;
+const uint16_t kSmSdiNew = 1 << 11;
+
+VS1053Emulator *emulator;
+VS1053 *player;
+
+// Feed audio for this many (virtual) microseconds, only ever when DREQ says there's room
+uint32_t play(uint64_t micros)
+{
+	uint8_t chunk[32];
+	memset(chunk, 0x55, sizeof(chunk));
+	uint32_t sent = 0;
+	uint64_t until = emulator->micros() + micros;
+	while (emulator->micros() < until)
+	{
+		if (player->data_request())
+		{
+			player->startDataBurst();
+			player->sendDataChunk(chunk, sizeof(chunk));
+			player->endDataBurst();
+			sent += sizeof(chunk);
+		}
+		else
+		{
+			delay(1);
+		}
+	}
+	return sent;
+}
+} // namespace
+
+void setUp()
+{
+	Log.quiet = true;
+	emulator = new VS1053Emulator();
+	emulator->attachClock();
+	player = new VS1053(1, 2, 3);
+	player->setTransport(emulator);
+}
+
+void tearDown()
+{
+	delete player;
+	delete emulator;
+}
+
+void testBeginWithinTheSpiLimits()
+{
+	TEST_ASSERT_TRUE(player->begin(false));
+	TEST_ASSERT_EQUAL(0, emulator->speedViolations);
+	TEST_ASSERT_TRUE(emulator->reg(kSciMode) & kSmSdiNew);
+	TEST_ASSERT_TRUE(player->data_request());
+}
+
+void testDreqKeepsTheFifoFromOverflowing()
+{
+	player->begin(false);
+	emulator->bytesPerSecond = 16000;
+	uint32_t sent = play(5000000);
+
+	TEST_ASSERT_EQUAL(0, emulator->fifoOverflows);
+	TEST_ASSERT_EQUAL(sent, emulator->sdiBytes);
+
+	// Five seconds at 16000 bytes/sec, plus the FIFO it started by filling
+	TEST_ASSERT_UINT32_WITHIN(2048 + 32, 5 * 16000 + VS1053Emulator::fifo_size, sent);
+}
+
+void testCancelSongUsesSmCancel()
+{
+	player->begin(false);
+	play(2000000);
+	uint32_t softResets = emulator->softResets;
+	emulator->cancelAfterBytes = 256;
+
+	TEST_ASSERT_TRUE(player->cancelSong());
+	TEST_ASSERT_EQUAL(softResets, emulator->softResets);
+	TEST_ASSERT_FALSE(emulator->reg(kSciMode) & kSmCancel);
+	TEST_ASSERT_EQUAL(0, emulator->reg(kSciDecodeTime));
+	TEST_ASSERT_EQUAL(0, emulator->fifoOverflows);
+
+	// And the next stream plays
+	uint64_t played = emulator->playedBytes;
+	play(1000000);
+	TEST_ASSERT_GREATER_THAN(played, emulator->playedBytes);
+}
+
+void testCancelSongSoftResetsAStuckDecoder()
+{
+	player->begin(false);
+	play(1000000);
+	uint32_t softResets = emulator->softResets;
+
+	// SM_CANCEL never clears within the 2048 bytes the datasheet allows
+	emulator->cancelAfterBytes = 100000;
+	TEST_ASSERT_FALSE(player->cancelSong());
+	TEST_ASSERT_EQUAL(softResets + 1, emulator->softResets);
+	TEST_ASSERT_FALSE(emulator->reg(kSciMode) & kSmCancel);
+}
+
+void testDecoderStatus()
+{
+	player->begin(false);
+	play(3000000);
+
+	VS1053::DecoderStatus status;
+	player->readDecoderStatus(status);
+	TEST_ASSERT_EQUAL_HEX16(emulator->streamHdat1, status.hdat1);
+	TEST_ASSERT_EQUAL_HEX16(emulator->streamAudata, status.audata);
+	TEST_ASSERT_UINT32_WITHIN(1, 3, status.decodeTime);
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(testBeginWithinTheSpiLimits);
+	RUN_TEST(testDreqKeepsTheFifoFromOverflowing);
+	RUN_TEST(testCancelSongUsesSmCancel);
+	RUN_TEST(testCancelSongSoftResetsAStuckDecoder);
+	RUN_TEST(testDecoderStatus);
+	return UNITY_END();
+}